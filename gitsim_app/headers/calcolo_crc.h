@@ -0,0 +1,39 @@
+/**
+ ******************************************************************************
+ * @file    calcolo_crc.h
+ * @author  Saimon Collaku
+ ******************************************************************************
+ */
+
+#ifndef HEADERS_CALCOLO_CRC_H_
+#define HEADERS_CALCOLO_CRC_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "xil_types.h"
+
+
+/******************************************************************************
+ * MACROS AND DEFINES
+ *****************************************************************************/
+
+/** @brief Valore iniziale del CRC-16/CCITT-FALSE */
+#define CRC16_INIZIALE		0xFFFFU
+
+
+/******************************************************************************
+ * GLOBAL FUNCTION PROTOTYPES
+ *****************************************************************************/
+uint16_t aggiorna_crc16(uint16_t crc, uint8_t byte);
+uint16_t calcola_crc16(uint16_t crc, const uint8_t *dati, uint16_t lunghezza);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
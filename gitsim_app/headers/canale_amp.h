@@ -0,0 +1,154 @@
+/**
+ ******************************************************************************
+ * @file    canale_amp.h
+ * @author  Saimon Collaku
+ ******************************************************************************
+ */
+
+#ifndef HEADERS_CANALE_AMP_H_
+#define HEADERS_CANALE_AMP_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "xil_types.h"
+#include "math.h"
+#include <stdbool.h>
+
+
+/******************************************************************************
+ * MACROS AND DEFINES
+ *****************************************************************************/
+
+/** @brief Un solo core esegue protocollo ed encoder (build classica) */
+#define RUOLO_CORE_SINGOLO		0U
+
+/** @brief CPU0 in AMP: UART e protocollo, encoder tramite canale_amp */
+#define RUOLO_CORE_PROTOCOLLO	1U
+
+/** @brief CPU1 in AMP: solo il tick degli encoder */
+#define RUOLO_CORE_ENCODER		2U
+
+/**
+ * @brief Ruolo del core per cui si compila
+ *
+ * Lo stesso albero sorgente produce l'ELF classico (RUOLO_CORE_SINGOLO),
+ * l'ELF di CPU0 (RUOLO_CORE_PROTOCOLLO, BSP ps7_cortexa9_0, src/lscript.ld)
+ * e l'ELF di CPU1 (RUOLO_CORE_ENCODER, BSP ps7_cortexa9_1 con USE_AMP=1,
+ * src/lscript_cpu1.ld).
+ */
+#ifndef RUOLO_CORE
+#define RUOLO_CORE				RUOLO_CORE_SINGOLO
+#endif
+
+/**
+ * @brief Indirizzo di avvio di CPU1
+ *
+ * Deve coincidere con l'origine di ps7_ddr_0 in src/lscript_cpu1.ld.
+ */
+#define INDIRIZZO_AVVIO_CPU1	0x10000000U
+
+/** @brief Numero di messaggi di ogni anello, potenza di 2 */
+#define N_MESSAGGI_AMP			64U
+
+
+/******************************************************************************
+ * TYPEDEFS
+ *****************************************************************************/
+
+/** @brief Tipo di un messaggio tra i due core */
+typedef enum
+{
+	/** @brief CPU0 -> CPU1: assegna_velocita_encoder(indice, valore) */
+	MESSAGGIO_VELOCITA = 0,
+
+	/** @brief CPU0 -> CPU1: assegna_accelerazione_encoder(indice, valore) */
+	MESSAGGIO_ACCELERAZIONE,
+
+	/** @brief CPU0 -> CPU1: assegna_ppr_encoder(indice, intero) */
+	MESSAGGIO_PPR,
+
+	/** @brief CPU0 -> CPU1: assegna_diametro_ruota(valore) */
+	MESSAGGIO_DIAMETRO,
+
+	/** @brief CPU0 -> CPU1: aggiorna_passo_encoder(indice) */
+	MESSAGGIO_PASSO,
+
+	/** @brief CPU0 -> CPU1: apri_comandi_encoder() */
+	MESSAGGIO_APRI_COMANDI,
+
+	/** @brief CPU0 -> CPU1: chiudi_comandi_encoder() */
+	MESSAGGIO_CHIUDI_COMANDI,
+
+	/** @brief CPU0 -> CPU1: inizializza_variabili_encoder() */
+	MESSAGGIO_INIZIALIZZA,
+
+	/** @brief CPU0 -> CPU1: nuovo stato della connessione in intero */
+	MESSAGGIO_CONNESSIONE,
+
+	/** @brief CPU0 -> CPU1: assegna_periodo_side_loop(valore) */
+	MESSAGGIO_PERIODO_TICK,
+
+	/**
+	 * @brief CPU0 -> CPU1: apri_comandi_programmati() al tick di CPU1 più
+	 * vicino all'istante intero_lungo del timer globale
+	 */
+	MESSAGGIO_APRI_PROGRAMMATI,
+
+	/** @brief CPU0 -> CPU1: chiudi_comandi_programmati() */
+	MESSAGGIO_CHIUDI_PROGRAMMATI,
+
+	/**
+	 * @brief CPU1 -> CPU0: velocità (valore), conteggio dell'ultimo periodo
+	 * di telemetria (intero) e conteggio cumulativo (intero_lungo)
+	 * dell'encoder indice
+	 */
+	MESSAGGIO_TELEMETRIA
+
+} tipo_messaggio_amp;
+
+/** @brief Messaggio di lunghezza fissa scambiato tra i due core */
+typedef struct
+{
+	/** @brief Uno dei valori di tipo_messaggio_amp */
+	uint8_t tipo;
+
+	/** @brief Indice dell'encoder a cui si riferisce */
+	uint8_t indice;
+
+	/** @brief Argomento intero */
+	int16_t intero;
+
+	/** @brief Argomento in virgola mobile */
+	float_t valore;
+
+	/** @brief Argomento intero a 64 bit */
+	int64_t intero_lungo;
+
+} messaggio_amp;
+
+
+/******************************************************************************
+ * GLOBAL FUNCTION PROTOTYPES
+ *****************************************************************************/
+void inizializza_canale_amp(void);
+void avvia_cpu1(void);
+bool invia_comando_amp(uint8_t tipo, uint8_t indice, int16_t intero,
+					   float_t valore);
+bool invia_comando_lungo_amp(uint8_t tipo, int64_t intero_lungo);
+bool ricevi_comando_amp(messaggio_amp *messaggio);
+uint32_t ritorna_spazio_comandi_amp(void);
+bool invia_telemetria_amp(uint8_t indice, int16_t conteggio, int64_t totale,
+						  float_t velocita);
+bool ricevi_telemetria_amp(messaggio_amp *messaggio);
+uint32_t ritorna_messaggi_amp_persi(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
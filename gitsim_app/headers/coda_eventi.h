@@ -0,0 +1,70 @@
+/**
+ ******************************************************************************
+ * @file    coda_eventi.h
+ * @author  Saimon Collaku
+ ******************************************************************************
+ */
+
+#ifndef HEADERS_CODA_EVENTI_H_
+#define HEADERS_CODA_EVENTI_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "xil_types.h"
+
+
+/******************************************************************************
+ * MACROS AND DEFINES
+ *****************************************************************************/
+
+/** @brief Numero massimo di sorgenti di eventi in una coda */
+#define N_EVENTI_MAX		8U
+
+
+/******************************************************************************
+ * TYPEDEFS
+ *****************************************************************************/
+
+/**
+ * @brief Min-heap di eventi temporizzati, uno per ogni sorgente
+ *
+ * Ogni sorgente (identificata da 0 a n_eventi - 1) ha sempre esattamente un
+ * evento in coda: cambiarne il tempo riordina lo heap in O(log n) e il
+ * prossimo evento si legge in O(1).
+ */
+typedef struct
+{
+	/** @brief Tempo del prossimo evento di ogni sorgente, per identificativo */
+	uint64_t tempo[N_EVENTI_MAX];
+
+	/** @brief Identificativi ordinati come heap: heap[0] è il più vicino */
+	uint8_t heap[N_EVENTI_MAX];
+
+	/** @brief Posizione nello heap di ogni identificativo */
+	uint8_t posizione[N_EVENTI_MAX];
+
+	/** @brief Numero di sorgenti nella coda */
+	uint8_t n_eventi;
+
+} coda_eventi;
+
+
+/******************************************************************************
+ * GLOBAL FUNCTION PROTOTYPES
+ *****************************************************************************/
+void inizializza_coda_eventi(coda_eventi *coda, uint8_t n_eventi,
+							 uint64_t tempo);
+void aggiorna_evento(coda_eventi *coda, uint8_t id, uint64_t tempo);
+uint8_t ritorna_primo_evento(const coda_eventi *coda);
+uint64_t ritorna_tempo_primo_evento(const coda_eventi *coda);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -16,10 +16,99 @@ extern "C" {
  * INCLUDES
  *****************************************************************************/
 #include <math.h>
-#include "xgpio.h"
+#include "xil_types.h"
 #include <stdbool.h>
 
 
+/******************************************************************************
+ * MACROS AND DEFINES
+ *****************************************************************************/
+
+/**
+ * @brief Motore di emulazione in virgola mobile
+ *
+ * Velocità e posizione sono integrate in double_t, in metri, ad ogni tick.
+ * È il modello originale, mantenuto come riferimento.
+ */
+#define MOTORE_ENCODER_DOUBLE		0U
+
+/**
+ * @brief Motore di emulazione a punto fisso
+ *
+ * La posizione è un accumulatore di fase intero in Q16.48, espresso in
+ * periodi del canale; velocità e accelerazione sono convertite in incrementi
+ * per tick quando arriva il telegramma che le assegna.
+ */
+#define MOTORE_ENCODER_PUNTO_FISSO	1U
+
+/**
+ * @brief Motore di emulazione selezionato a tempo di compilazione
+ *
+ * Può essere ridefinito da riga di comando (-DMOTORE_ENCODER=0U) per
+ * ricompilare il firmware con il modello in virgola mobile.
+ */
+#ifndef MOTORE_ENCODER
+#define MOTORE_ENCODER				MOTORE_ENCODER_PUNTO_FISSO
+#endif
+
+
+/**
+ * @brief Schedulazione a polling
+ *
+ * Il side loop aggiorna ed emula tutti gli encoder ad ogni tick del timer
+ * SCU: i fronti sono quantizzati al periodo del tick.
+ */
+#define SCHEDULAZIONE_POLLING		0U
+
+/**
+ * @brief Schedulazione a eventi
+ *
+ * Il tempo del prossimo fronte di ogni encoder viene calcolato da velocità e
+ * accelerazione e programmato sul comparatore del timer globale: la CPU
+ * interviene solo quando un fronte è dovuto. Il timer SCU resta come tick
+ * di supervisione per comandi, telegrammi e ripianificazione.
+ */
+#define SCHEDULAZIONE_EVENTI		1U
+
+/**
+ * @brief Schedulazione selezionata a tempo di compilazione
+ *
+ * Può essere ridefinita da riga di comando (-DSCHEDULAZIONE_ENCODER=1U).
+ * La schedulazione a eventi richiede il motore a punto fisso.
+ */
+#ifndef SCHEDULAZIONE_ENCODER
+#define SCHEDULAZIONE_ENCODER		SCHEDULAZIONE_POLLING
+#endif
+
+#if (SCHEDULAZIONE_ENCODER == SCHEDULAZIONE_EVENTI) && \
+	(MOTORE_ENCODER != MOTORE_ENCODER_PUNTO_FISSO)
+#error "La schedulazione a eventi richiede MOTORE_ENCODER_PUNTO_FISSO"
+#endif
+
+
+/**
+ * @brief Numero di encoder emulati
+ *
+ * Dimensiona gli array di stato degli encoder. Gli encoder oltre quelli
+ * previsti dal design hardware vengono emulati e contati senza uscite GPIO.
+ */
+#ifndef N_ENCODER
+#define N_ENCODER					2U
+#endif
+
+/** @brief Numero massimo di encoder, limitato dall'immagine delle uscite GPIO */
+#define N_ENCODER_MAX				8U
+
+/** @brief Indice del primo encoder, quello del telegramma dell'applicazione */
+#define ENCODER_1					0U
+
+/** @brief Indice del secondo encoder, quello del telegramma dell'applicazione */
+#define ENCODER_2					1U
+
+/** @brief Gruppi di comandi programmati che possono attendere il loro tick */
+#define N_COMANDI_PROGRAMMATI		8U
+
+
 /******************************************************************************
  * GLOBAL FUNCTION PROTOTYPES
  *****************************************************************************/
@@ -30,40 +119,73 @@ extern "C" {
  * @details
  * Questa funzione esegue le seguenti operazioni:
  * 1. Imposta il tempo di aggiornamento (t_update)
- * 2. Inizializza le strutture degli encoder e_1 e e_2
- * 3. Inizializza i GPIO associati a ciascun encoder
- * 4. Resetta lo stato dei GPIO
+ * 2. Inizializza parametri e stato di tutti gli N_ENCODER encoder
+ * 3. Configura come uscite i GPIO presenti nel design e li porta a livello
+ *    basso
  *
  * @note
- * - Utilizza funzioni esterne come ritorna_tempo_del_polling()
- * - Utilizza costanti XPAR per l'identificazione dei dispositivi GPIO
+ * - Utilizza funzioni esterne come ritorna_conteggi_tick()
  *
- * @see inizializza_encoder, XGpio_Initialize, reset_gpio
+ * @see inizializza_encoder, inizializza_uscite_gpio
  */
 void inizializza_variabili_encoder(void);
 
+/**
+ * @brief Adegua il modello degli encoder a un nuovo periodo del tick
+ *
+ * @details Rilegge t_update da ritorna_conteggi_tick() e ricalcola le
+ * grandezze per tick: con il motore a punto fisso le scale Q16.48, con la
+ * velocità in corso conservata in m/s dal comando di riscalatura; con la
+ * schedulazione a eventi i conteggi del timer globale per tick.
+ *
+ * @note Va chiamata subito dopo imposta_periodo_tick(), nello stesso
+ * confine di tick.
+ *
+ * @see assegna_periodo_side_loop
+ */
+void aggiorna_tempo_encoder(void);
+
 
 /**
- * @brief Emula le uscite degli encoder e_1 ed e_2
+ * @brief Emula le uscite di tutti gli encoder
  *
- * @details Questa funzione gestisce l'emulazione dei sensori per gli encoder
- *  e_1 ed e_2.
+ * @details Questa funzione gestisce l'emulazione dei sensori per tutti gli
+ * encoder, con un unico ciclo sugli indici. Alla fine del ciclo scrive sui
+ * GPIO i soli canali che hanno cambiato livello.
  * L'emulazione viene eseguita solo se l'applicazione GITSIM è connessa,
  * altrimenti la funzione non esegue alcuna operazione.
  *
  * @note L'emulazione dei sensori è utile per test e debug, permettendo di
  * simulare il comportamento degli encoder senza hardware fisico.
  *
- * @see e_1, e_2, ritorna_stato_connessione_app, emula_encoder
+ * @see ritorna_stato_connessione_app, emula_encoder, scrivi_uscite_gpio
  */
 void emula_sensori_encoder(void);
 
+#if (SCHEDULAZIONE_ENCODER == SCHEDULAZIONE_EVENTI)
+/**
+ * @brief Handler dell'interrupt del comparatore del timer globale
+ *
+ * @param riferimento Non usato
+ *
+ * @details Emette i fronti dovuti, ripianifica gli encoder interessati e
+ * programma il comparatore sul prossimo fronte della coda.
+ *
+ * @see inizializza_comparatore_globale
+ */
+void gestore_eventi_encoder(void *riferimento);
+#endif
+
 /**
  * @brief Aggiorna le variabili degli encoder se l'applicazione è connessa
  *
  * @details
  * Verifica lo stato di connessione dell'applicazione e, se connessa,
- * aggiorna le variabili per entrambi gli encoder e_1 e e_2.
+ * aggiorna le variabili di tutti gli encoder. Con la schedulazione a eventi
+ * porta tutti gli encoder all'istante corrente del timer globale.
+ *
+ * @param n_tick Tick nominali trascorsi dall'aggiornamento precedente,
+ * dati da misura_tick_trascorsi(); ignorato con la schedulazione a eventi
  *
  * @note
  * - Dipende dalla funzione ritorna_stato_connessione_app()
@@ -71,217 +193,222 @@ void emula_sensori_encoder(void);
  *
  * @see aggiorna_encoder, ritorna_stato_connessione_app
  */
-void aggiorna_variabili_encoder(void);
+void aggiorna_variabili_encoder(uint32_t n_tick);
 
 /**
- * @brief Resetta i conteggi di entrambi gli encoder e_1 ed e_2
+ * @brief Resetta i conteggi di tutti gli encoder
  *
- * @details Questa funzione azzera i conteggi degli encoder e_1 ed e_2,
+ * @details Questa funzione azzera i conteggi degli encoder,
  * riportandoli a zero. È utile per inizializzare o reinizializzare
  * i dati per prevenire l'overflow delle variabili di conteggio.
  *
- * @see e_1, e_2
- * @see encoder.conteggio
+ * @see stato_tick_encoder.conteggio
  */
 void reset_conteggi_encoder(void);
 
 /**
- * @brief Restituisce la velocità corrente emulata dall'encoder e_1
+ * @brief Restituisce la velocità corrente emulata da un encoder
  *
- * @return double_t La velocità corrente dell'encoder e_1 (in m/s)
+ * @param indice Indice dell'encoder, da 0 a N_ENCODER - 1
+ * @return double_t La velocità corrente dell'encoder (in m/s), 0 se
+ * l'indice non è valido
  *
  * @details Questa funzione fornisce accesso al valore di velocità attuale
- * emulato per l'encoder e_1, in metri al secondo. Fare attenzione al fatto
+ * emulato per l'encoder, in metri al secondo. Fare attenzione al fatto
  * che il valore è un double_t.
- *
- * @see e_1
- * @see encoder.vel
  */
-double_t ritorna_velocita_encoder1(void);
+double_t ritorna_velocita_encoder(uint8_t indice);
 
 /**
- * @brief Restituisce la velocità corrente emulata dall'encoder e_2
+ * @brief Restituisce il valore di conteggio corrente di un encoder
  *
- * @return double_t La velocità corrente dell'encoder e_2 (in m/s)
+ * @param indice Indice dell'encoder, da 0 a N_ENCODER - 1
+ * @return int16_t Il valore di conteggio (con risoluzione x4) dell'encoder,
+ * 0 se l'indice non è valido
  *
- * @details Questa funzione fornisce accesso al valore di velocità attuale
- * emulato per l'encoder e_2, in metri al secondo. Fare attenzione al fatto
- * che il valore è un double_t.
+ * @details Questa funzione fornisce accesso al valore di conteggio attuale
+ * dell'encoder con risoluzione x4. Il conteggio rappresenta il numero
+ * di impulsi rilevati dall'encoder dall'ultimo reset o dall'inizio dell'
+ * emulazione, ed è negativo se l'encoder si è mosso all'indietro.
  *
- * @see e_2
- * @see encoder.vel
+ * @see reset_conteggi_encoder()
  */
-double_t ritorna_velocita_encoder2(void);
+int16_t ritorna_conteggio_encoder(uint8_t indice);
 
 /**
- * @brief Restituisce il valore di conteggio corrente dell'encoder e_1
+ * @brief Restituisce il conteggio cumulativo di un encoder
  *
- * @return uint16_t Il valore di conteggio (con risoluzione x4) dell'encoder
- * e_1
+ * @param indice Indice dell'encoder, da 0 a N_ENCODER - 1
+ * @return int64_t Passi con risoluzione x4 dall'inizializzazione
+ * dell'encoder, con segno, 0 se l'indice non è valido
  *
- * @details Questa funzione fornisce accesso al valore di conteggio attuale
- * dell'encoder e_1 con risoluzione x4. Il conteggio rappresenta il numero
- * di impulsi rilevati dall'encoder dall'ultimo reset o dall'inizio dell'
- * emulazione.
- *
- * @see e_1
- * @see encoder.conteggio
- * @see reset_conteggi_encoder()
+ * @details A differenza di ritorna_conteggio_encoder() non viene azzerato
+ * da reset_conteggi_encoder(): la differenza tra due letture è esatta anche
+ * se nel frattempo i conteggi sono stati azzerati. Nella CPU0 della build
+ * AMP è l'ultimo valore ricevuto con la telemetria di CPU1.
  */
-uint16_t ritorna_conteggio_encoder1(void);
+int64_t ritorna_conteggio_totale_encoder(uint8_t indice);
 
 /**
- * @brief Restituisce il valore di conteggio corrente dell'encoder e_2
+ * @brief Restituisce il numero di transizioni illegali di un encoder
  *
- * @return uint16_t Il valore di conteggio (con risoluzione x4) dell'encoder
- * e_2
- *
- * @details Questa funzione fornisce accesso al valore di conteggio attuale
- * dell'encoder e_2 con risoluzione x4. Il conteggio rappresenta il numero
- * di impulsi rilevati dall'encoder dall'ultimo reset o dall'inizio dell'
- * emulazione.
+ * @param indice Indice dell'encoder, da 0 a N_ENCODER - 1
+ * @return uint32_t Cambi contemporanei dei canali A e B dall'ultima
+ * inizializzazione, 0 se l'indice non è valido
  *
- * @see e_2
- * @see encoder.conteggio
- * @see reset_conteggi_encoder()
+ * @details Una transizione illegale è un passo che il ricevitore non può
+ * attribuire a un verso, quindi un passo perso dal conteggio.
  */
-uint16_t ritorna_conteggio_encoder2(void);
+uint32_t ritorna_transizioni_illegali_encoder(uint8_t indice);
 
 /**
- * @brief Assegna il valore di impulsi per rivoluzione (ppr) all'encoder e_1
+ * @brief Restituisce il numero di fronti compensati di un encoder
  *
- * @param ppr Il ppr da assegnare all'encoder e_1
+ * @param indice Indice dell'encoder, da 0 a N_ENCODER - 1
+ * @return uint32_t Fronti emessi in ritardo di uno o più tick dall'ultima
+ * inizializzazione, 0 se l'indice non è valido
  *
- * @details Questa funzione imposta il valore ppr (impulsi per rivoluzione)
- * per l'encoder e_1. Questo parametro è dato normalmente dal datasheet del
- * costruttore dell'encoder e per la misura dei passi corrisponderebbe
- * alla risoluzione x1 (cioè usare solo i fronti di salita di un canale).
- *
- * @see e_1
- * @see encoder.ppr
+ * @details Quando in un tick cadono più fronti, il motore a punto fisso ne
+ * emette uno e accoda gli altri. Un valore che cresce indica che velocità,
+ * duty o fase sono al limite della risoluzione del tick. Con il motore in
+ * virgola mobile vale sempre 0.
  */
-void assegna_ppr_encoder1(uint16_t ppr);
+uint32_t ritorna_fronti_compensati_encoder(uint8_t indice);
 
 /**
- * @brief Assegna il valore di impulsi per rivoluzione (ppr) all'encoder e_2
+ * @brief Assegna il valore di impulsi per rivoluzione (ppr) a un encoder
  *
- * @param ppr Il ppr da assegnare all'encoder e_2
+ * @param indice Indice dell'encoder, da 0 a N_ENCODER - 1
+ * @param ppr Il ppr da assegnare all'encoder
  *
  * @details Questa funzione imposta il valore ppr (impulsi per rivoluzione)
- * per l'encoder e_2. Questo parametro è dato normalmente dal datasheet del
+ * per l'encoder. Questo parametro è dato normalmente dal datasheet del
  * costruttore dell'encoder e per la misura dei passi corrisponderebbe
  * alla risoluzione x1 (cioè usare solo i fronti di salita di un canale).
  *
- * @see e_2
  * @see encoder.ppr
  */
-void assegna_ppr_encoder2(uint16_t ppr);
+void assegna_ppr_encoder(uint8_t indice, uint16_t ppr);
 
 /**
- * @brief Assegna il diametro della ruota a entrambi gli encoder e_1 ed e_2
+ * @brief Assegna il diametro della ruota a tutti gli encoder
  *
  * @param diametro Il diametro della ruota da assegnare (in metri)
  *
- * @details Questa funzione imposta il diametro della ruota per entrambi gli
- * encoder e_1 ed e_2. Il valore del diametro viene assegnato direttamente
+ * @details Questa funzione imposta il diametro della ruota per tutti gli
+ * encoder. Il valore del diametro viene assegnato direttamente
  * senza conversioni.
  *
- * @see e_1, e_2
  * @see encoder.diametro
  */
 void assegna_diametro_ruota(float_t diametro);
 
 /**
- * @brief Assegna un valore di velocità all'encoder e_1
+ * @brief Assegna un valore di velocità a un encoder
  *
+ * @param indice Indice dell'encoder, da 0 a N_ENCODER - 1
  * @param vel Valore di velocità da assegnare (in m/s)
  *
- * @details Questa funzione converte il valore di velocità fornito
- * da float_t a double_t e lo assegna al campo 'vel' dell'encoder e_1.
+ * @details Con il motore a punto fisso la velocità viene convertita subito
+ * nell'incremento di fase per tick, con il motore in virgola mobile viene
+ * convertita da float_t a double_t. Il valore passa dalla casella dei
+ * comandi e viene applicato dal side loop all'inizio del tick successivo.
  *
  * @note La conversione da float_t a double_t comporta un
  * cambiamento di precisione, dipendente dalla libreria math.h
- *
- * @see e_1
- * @see encoder.vel
  */
-void assegna_velocita_encoder1(float_t vel);
+void assegna_velocita_encoder(uint8_t indice, float_t vel);
 
 /**
- * @brief Assegna un valore di velocità all'encoder e_2
+ * @brief Assegna un valore di accelerazione a un encoder
  *
- * @param vel Valore di velocità da assegnare (in m/s)
+ * @param indice Indice dell'encoder, da 0 a N_ENCODER - 1
+ * @param acc Valore di accelerazione da assegnare (in m/s<sup>2</sup>)
  *
- * @details Questa funzione converte il valore di velocità fornito
- * da float_t a double_t e lo assegna al campo 'vel' dell'encoder e_2.
+ * @details Con il motore a punto fisso l'accelerazione viene convertita
+ * subito nell'incremento di velocità per tick, con il motore in virgola
+ * mobile viene convertita da float_t a double_t. Il valore passa dalla
+ * casella dei comandi e viene applicato dal side loop all'inizio del tick
+ * successivo.
  *
  * @note La conversione da float_t a double_t comporta un
  * cambiamento di precisione, dipendente dalla libreria math.h
  *
- * @see e_2
- * @see encoder.vel
+ * @see encoder.acc
  */
-void assegna_velocita_encoder2(float_t vel);
+void assegna_accelerazione_encoder(uint8_t indice, float_t acc);
 
 /**
- * @brief Assegna un valore di accelerazione all'encoder e_1
+ * @brief Apre una scrittura nella casella dei comandi degli encoder
  *
- * @param acc Valore di accelerazione da assegnare (in m/s<sup>2</sup>)
- *
- * @details Questa funzione converte il valore di accelerazione fornito
- * da float_t a double_t e lo assegna al campo 'acc' dell'encoder e_1.
- *
- * @note La conversione da float_t a double_t comporta un
- * cambiamento di precisione, dipendente dalla libreria math.h
+ * @details I comandi assegnati tra apri_comandi_encoder() e
+ * chiudi_comandi_encoder() vengono applicati dal side loop tutti insieme,
+ * allo stesso tick. Le chiamate si possono annidare: la casella viene
+ * pubblicata alla chiusura più esterna. Le funzioni assegna_* aprono e
+ * chiudono da sole, quindi raggrupparle è necessario solo per applicarne
+ * più di una nello stesso tick.
  *
- * @see e_1
- * @see encoder.acc
+ * @note Da chiamare solo dal main loop. Non disabilita gli interrupt: se il
+ * side loop arriva durante la scrittura, applica i comandi al tick dopo.
  */
-void assegna_accelerazione_encoder1(float_t acc);
+void apri_comandi_encoder(void);
 
 /**
- * @brief Assegna un valore di accelerazione all'encoder e_2
- *
- * @param acc Valore di accelerazione da assegnare (in m/s<sup>2</sup>)
- *
- * @details Questa funzione converte il valore di accelerazione fornito
- * da float_t a double_t e lo assegna al campo 'acc' dell'encoder e_2.
- *
- * @note La conversione da float_t a double_t può comportare un
- * cambiamento di precisione, dipendente dalla libreria math.h
+ * @brief Chiude una scrittura aperta con apri_comandi_encoder()
  *
- * @see e_2
- * @see encoder.acc
+ * @see apri_comandi_encoder
+ */
+void chiudi_comandi_encoder(void);
+
+/**
+ * @brief Apre un gruppo di comandi da applicare a un tick preciso
+ *
+ * @param tick Tick del side loop, nella numerazione di ritorna_tick_corrente(),
+ * in cui applicare i comandi
+ * @return bool true se il gruppo è aperto, false se la coda dei comandi
+ * programmati è piena o una scrittura è già aperta
+ *
+ * @details Le funzioni assegna_* chiamate fino a chiudi_comandi_programmati()
+ * vengono convertite subito ma non toccano la casella dei comandi: il gruppo
+ * entra in una coda ordinata per tick e il side loop lo applica all'inizio
+ * del tick richiesto, senza il ritardo variabile della UART e del main loop.
+ * Un tick già passato viene applicato al primo tick utile. Gruppi per lo
+ * stesso tick vengono applicati nell'ordine di arrivo, dopo i comandi
+ * immediati. inizializza_variabili_encoder() svuota la coda.
+ *
+ * Nella CPU0 della build AMP il gruppo parte per CPU1 con il numero di tick
+ * mancanti: il tick di CPU1 è sfasato da quello di CPU0, quindi il gruppo
+ * può essere applicato un tick prima o dopo; la coda piena si vede solo
+ * nel contatore di CPU1.
+ *
+ * @note Da chiamare solo dal main loop; se ritorna false le funzioni
+ * assegna_* non vanno chiamate.
  */
-void assegna_accelerazione_encoder2(float_t acc);
+bool apri_comandi_programmati(uint32_t tick);
 
 /**
- * @brief Aggiorna il passo dell'encoder e_1
+ * @brief Chiude il gruppo aperto con apri_comandi_programmati() e lo accoda
  *
- * Questa funzione calcola e aggiorna la  lunghezza del passo dell'encoder e_1
- * basandosi sul suo diametro e sul numero di impulsi per rivoluzione (ppr).
+ * @details L'inserimento nella coda ordinata avviene con l'interrupt del
+ * tick mascherato.
  *
- * La formula utilizzata è:
- * @f[
- *    l_{passo} = \frac{diametro \cdot \pi}{ppr \cdot 2}
- * @f]
- * dove:
- * - @f$l_{passo}@f$ è il passo dell'encoder
- * - @f$diametro@f$ è il diametro della ruota dell'encoder
- * - @f$\pi@f$ è il valore di PI greco
- * - @f$ppr@f$ è il numero di impulsi per rivoluzione dell'encoder
- * - Il fattore 2 nel denominatore è usato per ottenere la risoluzione x2 del
- * 	 passo
+ * @see apri_comandi_programmati
+ */
+void chiudi_comandi_programmati(void);
+
+/**
+ * @brief Restituisce i gruppi di comandi programmati scartati
  *
- * @see e_1
- * @see encoder.l_passo
+ * @return uint32_t Gruppi rifiutati per coda piena dall'accensione
  */
-void aggiorna_passo_encoder1(void);
+uint32_t ritorna_comandi_programmati_scartati(void);
 
 /**
- * @brief Aggiorna il passo dell'encoder e_2
+ * @brief Aggiorna il passo di un encoder
+ *
+ * @param indice Indice dell'encoder, da 0 a N_ENCODER - 1
  *
- * Questa funzione calcola e aggiorna la  lunghezza del passo dell'encoder e_2
+ * Questa funzione calcola e aggiorna la  lunghezza del passo dell'encoder
  * basandosi sul suo diametro e sul numero di impulsi per rivoluzione (ppr).
  *
  * La formula utilizzata è:
@@ -296,10 +423,9 @@ void aggiorna_passo_encoder1(void);
  * - Il fattore 2 nel denominatore è usato per ottenere la risoluzione x2 del
  * 	 passo
  *
- * @see e_2
  * @see encoder.l_passo
  */
-void aggiorna_passo_encoder2(void);
+void aggiorna_passo_encoder(uint8_t indice);
 
 #ifdef __cplusplus
 }
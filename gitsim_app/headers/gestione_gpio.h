@@ -0,0 +1,62 @@
+/**
+ ******************************************************************************
+ * @file    gestione_gpio.h
+ * @author  Saimon Collaku
+ ******************************************************************************
+ */
+
+#ifndef HEADERS_GESTIONE_GPIO_H_
+#define HEADERS_GESTIONE_GPIO_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "xil_types.h"
+#include <stdbool.h>
+#include "emulazione_encoder.h"
+
+
+/******************************************************************************
+ * MACROS AND DEFINES
+ *****************************************************************************/
+
+/**
+ * @brief Uscite su un'unica porta GPIO
+ *
+ * Con valore 0U ogni canale ha il suo AXI GPIO a 1 bit, come nel design
+ * attuale. Con valore 1U tutti i canali sono bit di un solo AXI GPIO largo
+ * 2 * N_ENCODER bit (bit 2i = canale A, bit 2i+1 = canale B dell'encoder i),
+ * aggiornati con una sola scrittura sul bus e senza skew tra i canali.
+ */
+#ifndef USCITE_GPIO_PORTA_UNICA
+#define USCITE_GPIO_PORTA_UNICA		0U
+#endif
+
+#if (USCITE_GPIO_PORTA_UNICA == 1U)
+/**
+ * @brief Indirizzo base dell'AXI GPIO unico
+ *
+ * Va definito dal design hardware (xparameters.h) o da riga di comando.
+ */
+#ifndef GPIO_PORTA_UNICA_BASEADDR
+#error "Definire GPIO_PORTA_UNICA_BASEADDR per USCITE_GPIO_PORTA_UNICA = 1U"
+#endif
+#endif
+
+
+/******************************************************************************
+ * GLOBAL FUNCTION PROTOTYPES
+ *****************************************************************************/
+void inizializza_uscite_gpio(void);
+void imposta_uscite_encoder_gpio(uint8_t indice, bool statoA, bool statoB);
+void scrivi_uscite_gpio(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -17,24 +17,123 @@ extern "C" {
  ************************************/
 
 #include "xscutimer.h"
+#include "xil_exception.h"
+#include "xtime_l.h"
 #include "math.h"
+#include "emulazione_encoder.h"
+#include "canale_amp.h"
 
 /************************************
  * MACROS AND DEFINES
  ************************************/
 
+/**
+ * @brief Abilita il percorso veloce dell'interrupt del tick
+ *
+ * Con valore 1U l'eccezione IRQ va a un gestore che riconosce il GIC e il
+ * timer SCU con scritture dirette ai registri e chiama side_loop() senza
+ * passare da XScuGic_InterruptHandler. Gli altri interrupt restano
+ * collegati con XScuGic_Connect() e vengono smistati dalla stessa tabella.
+ * Con valore 0U tutti gli interrupt passano dal driver del GIC.
+ */
+#ifndef IRQ_VELOCE_TICK
+#define IRQ_VELOCE_TICK		1U
+#endif
+
 /** @brief Prescaler del timer SCU */
 #define TIMER_PSC		(19U + 1U)
 
+#if ((SCHEDULAZIONE_ENCODER == SCHEDULAZIONE_EVENTI) || \
+	 (RUOLO_CORE == RUOLO_CORE_PROTOCOLLO))
+/**
+ * @brief Valore di ricarica (load value) del timer SCU
+ *
+ * Con la schedulazione a eventi il timer SCU dà solo il tick di
+ * supervisione, a 1 ms: i fronti sono temporizzati dal comparatore del
+ * timer globale. Anche la CPU0 di una build AMP usa 1 ms: il suo side loop
+ * serve solo telemetria e task.
+ */
+#define TIMER_LV 		(16249U + 1U)
+#else
 /** @brief Valore di ricarica (load value) del timer SCU */
 #define TIMER_LV 		(64U + 1U)
+#endif
+
+/**
+ * @brief Minimo valore di ricarica accettato a runtime
+ *
+ * 33 conteggi danno circa 2 us, cioè un tick a circa 490 kHz.
+ */
+#define RICARICA_TICK_MIN		33U
+
+/** @brief Massimo valore di ricarica accettato a runtime: 1 ms */
+#define RICARICA_TICK_MAX		16250U
+
+/**
+ * @brief Rapporto minimo tra periodo e costo peggiore misurato del tick
+ *
+ * Lascia al main loop almeno metà della CPU.
+ */
+#define MARGINE_COSTO_TICK		2U
+
+/**
+ * @brief Abilita il degrado del tick quando gli overrun persistono
+ *
+ * Con valore 1U, se in FINESTRA_OVERRUN interrupt del tick almeno
+ * SOGLIA_OVERRUN_DEGRADO finiscono oltre la scadenza successiva, il timer
+ * SCU passa a un periodo FATTORE_DEGRADO_TICK volte più lungo. Il modello
+ * degli encoder continua a integrare sul tick nominale, recuperando i tick
+ * base trascorsi. Con valore 0U gli overrun vengono solo contati.
+ */
+#ifndef DEGRADO_TICK
+#define DEGRADO_TICK			1U
+#endif
+
+/** @brief Periodo del tick degradato, in multipli del tick nominale */
+#define FATTORE_DEGRADO_TICK	2U
+
+/** @brief Interrupt del tick su cui si contano gli overrun per il degrado */
+#define FINESTRA_OVERRUN		1024U
+
+/** @brief Overrun nella finestra oltre i quali il tick viene degradato */
+#define SOGLIA_OVERRUN_DEGRADO	16U
+
+/**
+ * @brief Massimo numero di tick nominali recuperati in un interrupt
+ *
+ * Limita l'integrazione dopo un ritardo molto lungo (debugger, flash); i
+ * tick oltre questo limite vengono contati e non recuperati.
+ */
+#define N_TICK_RECUPERO_MAX		4096U
 
 /************************************
  * GLOBAL FUNCTION PROTOTYPES
  ************************************/
 void inizializza_polling_timer(void);
+void connetti_interrupt_periferica(uint16_t n_interrupt,
+								   Xil_InterruptHandler handler,
+								   void *riferimento);
 XScuTimer ritorna_istanza_timer(void);
+void pulisci_interrupt_timer(void);
 float_t ritorna_tempo_del_polling(void);
+u32 ritorna_conteggi_tick(void);
+XTime ritorna_tempo_del_tick(uint32_t tick);
+int64_t ritorna_tick_del_tempo(XTime tempo);
+bool imposta_periodo_tick(float_t periodo);
+uint32_t misura_tick_trascorsi(void);
+void controlla_overrun_tick(void);
+void richiedi_tick_nominale(void);
+u32 ritorna_ricarica_timer(void);
+uint32_t ritorna_overrun_tick(void);
+uint32_t ritorna_tick_recuperati(void);
+uint32_t ritorna_tick_non_recuperati(void);
+u32 ritorna_margine_minimo_tick(void);
+u32 ritorna_costo_massimo_tick(void);
+bool ritorna_tick_degradato(void);
+void inizializza_comparatore_globale(Xil_InterruptHandler handler);
+void programma_comparatore_globale(uint64_t tempo);
+void ferma_comparatore_globale(void);
+void pulisci_comparatore_globale(void);
 
 
 #ifdef __cplusplus
@@ -0,0 +1,65 @@
+/**
+ ******************************************************************************
+ * @file    gestione_task.h
+ * @author  Saimon Collaku
+ ******************************************************************************
+ */
+
+#ifndef HEADERS_GESTIONE_TASK_H_
+#define HEADERS_GESTIONE_TASK_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "xil_types.h"
+#include "math.h"
+#include <stdbool.h>
+
+
+/******************************************************************************
+ * MACROS AND DEFINES
+ *****************************************************************************/
+
+/** @brief Numero massimo di task periodici registrabili */
+#define N_TASK_MAX			8U
+
+/**
+ * @brief Budget massimo, in microsecondi, di un task eseguito nel side loop
+ *
+ * I task con un budget dichiarato più alto vengono solo segnalati dal side
+ * loop ed eseguiti dal main loop, fuori dall'interrupt.
+ */
+#define BUDGET_TASK_ISR_US	2U
+
+
+/******************************************************************************
+ * TYPEDEFS
+ *****************************************************************************/
+
+/** @brief Funzione eseguita da un task periodico */
+typedef void (*funzione_task)(void);
+
+
+/******************************************************************************
+ * GLOBAL FUNCTION PROTOTYPES
+ *****************************************************************************/
+void inizializza_task(void);
+bool registra_task(float_t periodo, float_t sfasamento,
+				   funzione_task funzione, uint32_t budget_us);
+void ricalcola_task(void);
+bool assegna_periodo_task(funzione_task funzione, float_t periodo);
+void esegui_task_tick(uint32_t n_tick);
+void esegui_task_differiti(void);
+bool ritorna_task_differiti_in_attesa(void);
+uint32_t ritorna_tick_corrente(void);
+uint32_t ritorna_task_saltati(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -24,12 +24,31 @@ extern "C" {
  ************************************/
 void inizializza_uart(void);
 
+/**
+ * @brief Ripristina l'ultima configurazione dopo un reset del watchdog
+ *
+ * Se il sistema è ripartito per la scadenza del watchdog e la configurazione
+ * salvata è valida, ripassa il telegramma di connessione con gli stessi
+ * controlli e riassegna velocità e accelerazioni: l'emulazione riprende
+ * senza attendere l'applicazione. Dopo un power-on non fa niente.
+ *
+ * Va chiamata dopo inizializza_variabili_encoder().
+ */
+void ripristina_connessione_app(void);
+
 /**
  * @brief Invia un telegramma di risposta all'applicazione via uart
  *
  * Se la connessione con l'applicazione è stata stabilita e l'handshake è
  * avvenuto, questa funzione invia un telegramma di 12 byte contenente
- * le velocità e i conteggi attuali degli encoder e_1 ed e_2.
+ * le velocità e i conteggi attuali degli encoder e_1 ed e_2. Con il formato
+ * esteso, scelto dall'applicazione con il telegramma 0x0B, il telegramma
+ * contiene anche numero di sequenza, tick del campionamento e conteggi
+ * cumulativi a 64 bit.
+ *
+ * Non attende la trasmissione: il telegramma viene copiato nella coda di
+ * trasmissione e inviato dall'interrupt di FIFO TX vuota dell'UART, quindi
+ * può essere chiamata dal side loop.
  *
  * @see e_1, e_2
  * @see encoder.vel
@@ -42,9 +61,27 @@ void manda_telegramma_di_risposta(void);
  *
  * Questa funzione determina se deve leggere un telegramma di connessione
  * o di funzionamento, basandosi sullo stato attuale della connessione.
+ *
+ * Non attende: i byte sono raccolti dall'interrupt UART nella coda di
+ * ricezione e il telegramma viene processato solo quando è completo,
+ * altrimenti la funzione ritorna subito.
+ *
+ * Porta avanti anche la negoziazione del baud rate (telegrammi 0x0C e
+ * 0x0D), quindi va chiamata a ogni giro del main loop.
  */
 void leggi_telegramma(void);
 
+/**
+ * @brief Indica se in coda di ricezione c'è un telegramma completo
+ *
+ * Il main loop la chiama con gli interrupt mascherati prima di dormire: un
+ * telegramma incompleto viene completato solo da un nuovo interrupt UART,
+ * che sveglia comunque il core.
+ *
+ * @return bool True se leggi_telegramma() ha un telegramma da processare
+ */
+bool ritorna_telegramma_in_attesa(void);
+
 /**
  * @brief Restituisce lo stato della connessione con l'applicazione
  *
@@ -52,6 +89,30 @@ void leggi_telegramma(void);
  */
 bool ritorna_stato_connessione_app(void);
 
+/**
+ * @brief Restituisce il numero di telegrammi di risposta scartati
+ *
+ * @return uint32_t Telegrammi non accodati per coda di trasmissione piena,
+ * dall'accensione
+ */
+uint32_t ritorna_telegrammi_tx_scartati(void);
+
+/**
+ * @brief Restituisce il numero di byte ricevuti e persi
+ *
+ * @return uint32_t Byte scartati per coda di ricezione piena più overrun
+ * della FIFO hardware, dall'accensione
+ */
+uint32_t ritorna_byte_rx_persi(void);
+
+/**
+ * @brief Restituisce il numero di trame scartate
+ *
+ * @return uint32_t Trame con CRC o lunghezza non validi, e trame integre
+ * di un tipo non atteso, dall'accensione
+ */
+uint32_t ritorna_trame_errate(void);
+
 #ifdef __cplusplus
 }
 #endif
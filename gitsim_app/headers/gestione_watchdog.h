@@ -0,0 +1,57 @@
+/**
+ ******************************************************************************
+ * @file    gestione_watchdog.h
+ * @author  Saimon Collaku
+ ******************************************************************************
+ */
+
+#ifndef HEADERS_GESTIONE_WATCHDOG_H_
+#define HEADERS_GESTIONE_WATCHDOG_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "xil_types.h"
+#include <stdbool.h>
+
+
+/******************************************************************************
+ * MACROS AND DEFINES
+ *****************************************************************************/
+
+/**
+ * @brief Abilita il watchdog privato del core sul motore del tick
+ *
+ * Con valore 1U il watchdog SCU resetta il sistema se il tick si ferma o il
+ * main loop smette di girare per TIMEOUT_WATCHDOG_MS. Con valore 0U il
+ * watchdog resta spento e l'ultima configurazione non viene salvata.
+ */
+#ifndef WATCHDOG_TICK
+#define WATCHDOG_TICK			1U
+#endif
+
+/** @brief Tempo senza rinfresco dopo cui il watchdog resetta, in ms */
+#define TIMEOUT_WATCHDOG_MS		100U
+
+/** @brief Byte massimi della configurazione conservata attraverso il reset */
+#define DIM_DATI_RIPRISTINO		64U
+
+
+/******************************************************************************
+ * GLOBAL FUNCTION PROTOTYPES
+ *****************************************************************************/
+void inizializza_watchdog(void);
+void controlla_salute_watchdog(void);
+bool ritorna_riavvio_da_watchdog(void);
+void salva_dati_ripristino(const void *dati, uint16_t lunghezza);
+uint16_t leggi_dati_ripristino(void *dati, uint16_t dimensione);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
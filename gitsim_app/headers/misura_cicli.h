@@ -0,0 +1,103 @@
+/**
+ ******************************************************************************
+ * @file    misura_cicli.h
+ * @author  Saimon Collaku
+ ******************************************************************************
+ */
+
+#ifndef HEADERS_MISURA_CICLI_H_
+#define HEADERS_MISURA_CICLI_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "xil_types.h"
+
+
+/******************************************************************************
+ * MACROS AND DEFINES
+ *****************************************************************************/
+
+/**
+ * @brief Abilita la misura dei cicli CPU spesi nel side loop principale
+ *
+ * Con valore 1U il side loop legge il contatore di cicli della PMU prima e
+ * dopo l'aggiornamento e l'emulazione degli encoder. Con valore 0U la misura
+ * non viene compilata e non ha alcun costo.
+ */
+#ifndef MISURA_CICLI_ENCODER
+#define MISURA_CICLI_ENCODER	0U
+#endif
+
+
+/******************************************************************************
+ * TYPEDEFS
+ *****************************************************************************/
+
+/** @brief Statistica di una misura ripetuta di cicli CPU */
+typedef struct
+{
+	/** @brief Ultimo valore misurato, in cicli CPU */
+	u32 ultimo;
+
+	/** @brief Valore minimo misurato dall'ultimo reset, in cicli CPU */
+	u32 minimo;
+
+	/** @brief Valore massimo misurato dall'ultimo reset, in cicli CPU */
+	u32 massimo;
+
+	/** @brief Somma di tutti i valori misurati, per il calcolo della media */
+	u64 somma;
+
+	/** @brief Numero di misure accumulate dall'ultimo reset */
+	u32 n_campioni;
+
+} statistica_cicli;
+
+
+/******************************************************************************
+ * GLOBAL FUNCTION PROTOTYPES
+ *****************************************************************************/
+
+/**
+ * @brief Abilita e azzera il contatore di cicli della PMU del Cortex-A9
+ *
+ * @details Il contatore (PMCCNTR) conta i cicli del core senza divisore.
+ * Va chiamata una volta sola, prima di qualunque leggi_contatore_cicli().
+ */
+void inizializza_contatore_cicli(void);
+
+/**
+ * @brief Legge il contatore di cicli della PMU
+ *
+ * @return u32 Valore corrente del contatore, in cicli CPU
+ *
+ * @note Il contatore è a 32 bit: la differenza tra due letture è corretta
+ * anche a cavallo dell'overflow, purché l'intervallo sia minore di 2^32 cicli.
+ */
+u32 leggi_contatore_cicli(void);
+
+/**
+ * @brief Azzera una statistica di cicli
+ *
+ * @param statistica Puntatore alla statistica da azzerare
+ */
+void reset_statistica_cicli(statistica_cicli *statistica);
+
+/**
+ * @brief Accumula una nuova misura in una statistica di cicli
+ *
+ * @param statistica Puntatore alla statistica da aggiornare
+ * @param cicli Numero di cicli misurati
+ */
+void aggiorna_statistica_cicli(statistica_cicli *statistica, u32 cicli);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,132 @@
+/**
+ ******************************************************************************
+ * @file    misura_isr.h
+ * @author  Saimon Collaku
+ ******************************************************************************
+ */
+
+#ifndef HEADERS_MISURA_ISR_H_
+#define HEADERS_MISURA_ISR_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "xil_types.h"
+
+
+/******************************************************************************
+ * MACROS AND DEFINES
+ *****************************************************************************/
+
+/**
+ * @brief Abilita la misura di latenza, durata e periodo del side loop
+ *
+ * Con valore 1U il side loop marca ingresso e uscita e aggiorna tre
+ * istogrammi, scaricabili con il telegramma di funzionamento 0x09. Con
+ * valore 0U nessuna misura viene compilata e il side loop non ha alcun
+ * costo aggiuntivo.
+ */
+#ifndef MISURA_LATENZA_ISR
+#define MISURA_LATENZA_ISR		0U
+#endif
+
+/** @brief Numero di classi di ogni istogramma; l'ultima raccoglie i fuori scala */
+#define N_CLASSI_ISTOGRAMMA		16U
+
+/** @brief Istogramma del ritardo tra scadenza del timer SCU e ingresso */
+#define ISTOGRAMMA_LATENZA		0U
+
+/** @brief Istogramma della durata del side loop */
+#define ISTOGRAMMA_DURATA		1U
+
+/** @brief Istogramma del periodo tra due ingressi consecutivi */
+#define ISTOGRAMMA_PERIODO		2U
+
+/** @brief Numero di istogrammi misurati */
+#define N_ISTOGRAMMI			3U
+
+/**
+ * @brief Lunghezza di un istogramma serializzato, in byte
+ *
+ * Tipo (1 byte), larghezza di classe, origine, minimo, massimo, numero di
+ * campioni (4 byte ciascuno) e le classi (4 byte ciascuna).
+ */
+#define L_ISTOGRAMMA_SERIALIZZATO	(1U + (5U * 4U) + (N_CLASSI_ISTOGRAMMA * 4U))
+
+
+/******************************************************************************
+ * TYPEDEFS
+ *****************************************************************************/
+
+/** @brief Istogramma a classi fisse di una misura del side loop */
+typedef struct
+{
+	/** @brief Conteggi per classe */
+	u32 classi[N_CLASSI_ISTOGRAMMA];
+
+	/** @brief Valore minimo misurato dall'ultimo reset */
+	u32 minimo;
+
+	/** @brief Valore massimo misurato dall'ultimo reset */
+	u32 massimo;
+
+	/** @brief Numero di misure accumulate dall'ultimo reset */
+	u32 n_campioni;
+
+} istogramma_isr;
+
+
+/******************************************************************************
+ * GLOBAL FUNCTION PROTOTYPES
+ *****************************************************************************/
+
+/**
+ * @brief Azzera gli istogrammi e prepara il contatore di cicli della PMU
+ */
+void inizializza_misura_isr(void);
+
+/**
+ * @brief Marca l'ingresso nel side loop
+ *
+ * @details Va chiamata come prima istruzione del side loop, prima di
+ * azzerare il flag del timer. Legge il contatore del timer SCU per la
+ * latenza, il timer globale per il periodo e il contatore di cicli per la
+ * durata.
+ */
+void ingresso_misura_isr(void);
+
+/**
+ * @brief Marca l'uscita dal side loop e aggiorna gli istogrammi
+ */
+void uscita_misura_isr(void);
+
+/**
+ * @brief Serializza un istogramma in little endian
+ *
+ * @param tipo Uno tra ISTOGRAMMA_LATENZA, ISTOGRAMMA_DURATA e
+ * ISTOGRAMMA_PERIODO
+ * @param buffer Destinazione di almeno L_ISTOGRAMMA_SERIALIZZATO byte
+ *
+ * @note Va chiamata dal side loop stesso, così l'istogramma non cambia
+ * durante la copia.
+ */
+void serializza_istogramma_isr(uint8_t tipo, uint8_t *buffer);
+
+/**
+ * @brief Azzera tutti gli istogrammi
+ *
+ * @details Centra le classi del periodo sul periodo attivo del tick.
+ *
+ * @note Come serializza_istogramma_isr(), va chiamata dal side loop.
+ */
+void reset_istogrammi_isr(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
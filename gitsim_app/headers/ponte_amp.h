@@ -0,0 +1,36 @@
+/**
+ ******************************************************************************
+ * @file    ponte_amp.h
+ * @author  Saimon Collaku
+ ******************************************************************************
+ */
+
+#ifndef HEADERS_PONTE_AMP_H_
+#define HEADERS_PONTE_AMP_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "canale_amp.h"
+
+
+/******************************************************************************
+ * GLOBAL FUNCTION PROTOTYPES
+ *****************************************************************************/
+#if (RUOLO_CORE == RUOLO_CORE_PROTOCOLLO)
+void servi_telemetria_amp(void);
+void servi_connessione_amp(void);
+#elif (RUOLO_CORE == RUOLO_CORE_ENCODER)
+void servi_comandi_amp(void);
+void manda_telemetria_amp(void);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
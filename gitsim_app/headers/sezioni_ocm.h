@@ -0,0 +1,72 @@
+/**
+ ******************************************************************************
+ * @file    sezioni_ocm.h
+ * @author  Saimon Collaku
+ ******************************************************************************
+ */
+
+#ifndef HEADERS_SEZIONI_OCM_H_
+#define HEADERS_SEZIONI_OCM_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "canale_amp.h"
+
+
+/******************************************************************************
+ * MACROS AND DEFINES
+ *****************************************************************************/
+
+/**
+ * @brief Abilita il posizionamento del percorso del tick in OCM
+ *
+ * Con valore 1U le funzioni e i dati marcati con FUNZIONE_OCM, DATI_OCM e
+ * COSTANTI_OCM vengono collegati in ps7_ram_0 (vedi src/lscript.ld) e
+ * copiati lì da copia_sezioni_ocm() all'avvio. Con valore 0U le macro sono
+ * vuote e tutto resta in DDR. Nella build AMP l'OCM bassa è riservata alla
+ * CPU1, quindi la CPU0 parte con valore 0U.
+ */
+#ifndef CODICE_IN_OCM
+#if (RUOLO_CORE == RUOLO_CORE_PROTOCOLLO)
+#define CODICE_IN_OCM		0U
+#else
+#define CODICE_IN_OCM		1U
+#endif
+#endif
+
+#if (CODICE_IN_OCM == 1U)
+/** @brief Funzione eseguita dall'OCM */
+#define FUNZIONE_OCM		__attribute__((section(".ocm_text")))
+
+/** @brief Variabile modificabile allocata in OCM */
+#define DATI_OCM			__attribute__((section(".ocm_data")))
+
+/**
+ * @brief Costante allocata in OCM
+ *
+ * Sezione separata da DATI_OCM: GCC non accetta oggetti const e non const
+ * nella stessa sezione di un file.
+ */
+#define COSTANTI_OCM		__attribute__((section(".ocm_rodata")))
+#else
+#define FUNZIONE_OCM
+#define DATI_OCM
+#define COSTANTI_OCM
+#endif
+
+
+/******************************************************************************
+ * GLOBAL FUNCTION PROTOTYPES
+ *****************************************************************************/
+void copia_sezioni_ocm(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
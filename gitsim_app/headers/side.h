@@ -12,11 +12,19 @@
 extern "C" {
 #endif
 
+/************************************
+ * INCLUDES
+ ************************************/
+#include "xil_types.h"
+#include "math.h"
+#include <stdbool.h>
+
 /************************************
  * GLOBAL FUNCTION PROTOTYPES
  ************************************/
 void side_loop(void *CallBack_Timer);
 void inizializza_side_loop(void);
+bool assegna_periodo_side_loop(float_t periodo);
 
 
 #ifdef __cplusplus
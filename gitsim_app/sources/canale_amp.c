@@ -0,0 +1,337 @@
+/**
+ ******************************************************************************
+ * @file    canale_amp.c
+ * @author  Saimon Collaku
+ ******************************************************************************
+ */
+
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "canale_amp.h"
+#include "sezioni_ocm.h"
+#include "xil_io.h"
+#include "xil_mmu.h"
+#include "xpseudo_asm.h"
+
+#if (RUOLO_CORE != RUOLO_CORE_SINGOLO)
+
+
+/******************************************************************************
+ * PRIVATE MACROS AND DEFINES
+ *****************************************************************************/
+
+/**
+ * @brief Inizio della memoria condivisa tra i due core
+ *
+ * OCM alta (ps7_ram_1), mappata da entrambi i core come
+ * memoria normale condivisa non cacheabile.
+ */
+#define BASE_MEMORIA_CONDIVISA	0xFFFF0000U
+
+/** @brief Attributi MMU della memoria condivisa (S=1 TEX=100 C=0 B=0) */
+#define ATTRIBUTI_CONDIVISA		0x14DE2U
+
+/** @brief Registro letto da CPU1 in attesa dopo il reset (WFE) */
+#define REGISTRO_AVVIO_CPU1		0xFFFFFFF0U
+
+/** @brief Valore scritto da CPU0 quando gli anelli sono pronti */
+#define FIRMA_CANALE_PRONTO		0x47495453U
+
+/** @brief Maschera per riavvolgere gli indici degli anelli */
+#define MASCHERA_MESSAGGI_AMP	(N_MESSAGGI_AMP - 1U)
+
+/** @brief Puntatore alla memoria condivisa */
+#define MEMORIA_CONDIVISA		((memoria_condivisa_amp *) BASE_MEMORIA_CONDIVISA)
+
+
+/******************************************************************************
+ * TYPEDEFS
+ *****************************************************************************/
+
+/**
+ * @brief Anello con un solo produttore e un solo consumatore
+ *
+ * I due indici sono su linee da 32 byte diverse: ognuno è scritto da un
+ * solo core.
+ */
+typedef struct
+{
+	/** @brief Prossima cella da scrivere, modificato dal produttore */
+	volatile u32 scrittura;
+	u32 riempimento_scrittura[7];
+
+	/** @brief Prossima cella da leggere, modificato dal consumatore */
+	volatile u32 lettura;
+	u32 riempimento_lettura[7];
+
+	/** @brief Celle dei messaggi */
+	messaggio_amp messaggi[N_MESSAGGI_AMP];
+
+} anello_amp;
+
+/** @brief Contenuto della memoria condivisa */
+typedef struct
+{
+	/** @brief FIRMA_CANALE_PRONTO dopo l'inizializzazione di CPU0 */
+	volatile u32 firma;
+	u32 riempimento[7];
+
+	/** @brief Comandi da CPU0 a CPU1 */
+	anello_amp comandi;
+
+	/** @brief Telemetria da CPU1 a CPU0 */
+	anello_amp telemetria;
+
+} memoria_condivisa_amp;
+
+
+/******************************************************************************
+ * STATIC VARIABLES
+ *****************************************************************************/
+
+/** @brief Messaggi scartati da questo core per anello pieno */
+static uint32_t messaggi_persi;
+
+
+/******************************************************************************
+ * STATIC FUNCTION PROTOTYPES
+ *****************************************************************************/
+static bool scrivi_anello_amp(anello_amp *anello, const messaggio_amp *messaggio);
+static bool leggi_anello_amp(anello_amp *anello, messaggio_amp *messaggio);
+
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+/**
+ * @brief Accoda un messaggio in un anello
+ *
+ * @param anello Anello di cui questo core è il produttore
+ * @param messaggio Messaggio da copiare
+ * @return bool true se accodato, false se l'anello è pieno
+ *
+ * @details La barriera garantisce che l'altro core veda il messaggio prima
+ * del nuovo indice di scrittura.
+ */
+FUNZIONE_OCM static bool scrivi_anello_amp(anello_amp *anello,
+										   const messaggio_amp *messaggio)
+{
+	bool scritto = false;
+	u32 scrittura = anello->scrittura;
+
+	if (((scrittura + 1U) & MASCHERA_MESSAGGI_AMP) != anello->lettura)
+	{
+		anello->messaggi[scrittura] = *messaggio;
+		dmb();
+		anello->scrittura = (scrittura + 1U) & MASCHERA_MESSAGGI_AMP;
+		scritto = true;
+	}
+	else
+	{
+		messaggi_persi++;
+	}
+
+	return scritto;
+}
+
+/**
+ * @brief Estrae un messaggio da un anello
+ *
+ * @param anello Anello di cui questo core è il consumatore
+ * @param messaggio Destinazione del messaggio
+ * @return bool true se un messaggio è stato estratto
+ *
+ * @details La prima barriera ordina la lettura del messaggio dopo quella
+ * dell'indice, la seconda libera la cella solo dopo la copia.
+ */
+FUNZIONE_OCM static bool leggi_anello_amp(anello_amp *anello,
+										  messaggio_amp *messaggio)
+{
+	bool letto = false;
+	u32 lettura = anello->lettura;
+
+	if (lettura != anello->scrittura)
+	{
+		dmb();
+		*messaggio = anello->messaggi[lettura];
+		dmb();
+		anello->lettura = (lettura + 1U) & MASCHERA_MESSAGGI_AMP;
+		letto = true;
+	}
+	else
+	{
+		/* Anello vuoto, MISRA-2023-15.7 */
+	}
+
+	return letto;
+}
+
+
+/******************************************************************************
+ * GLOBAL FUNCTIONS
+ *****************************************************************************/
+
+/**
+ * @brief Prepara la memoria condivisa tra i due core
+ *
+ * @details Entrambi i core mappano la OCM alta come non cacheabile. CPU0
+ * azzera gli anelli e poi pubblica la firma; CPU1 attende la firma prima
+ * di usare gli anelli. Su CPU0 va chiamata prima di avvia_cpu1().
+ */
+void inizializza_canale_amp(void)
+{
+	memoria_condivisa_amp *memoria = MEMORIA_CONDIVISA;
+
+	Xil_SetTlbAttributes(BASE_MEMORIA_CONDIVISA, ATTRIBUTI_CONDIVISA);
+	messaggi_persi = 0;
+
+#if (RUOLO_CORE == RUOLO_CORE_PROTOCOLLO)
+	memoria->comandi.scrittura = 0;
+	memoria->comandi.lettura = 0;
+	memoria->telemetria.scrittura = 0;
+	memoria->telemetria.lettura = 0;
+	dmb();
+	memoria->firma = FIRMA_CANALE_PRONTO;
+#else
+	while (memoria->firma != FIRMA_CANALE_PRONTO)
+	{
+		/* CPU0 non ha ancora preparato gli anelli */
+	}
+	dmb();
+#endif
+}
+
+/**
+ * @brief Avvia CPU1 all'indirizzo INDIRIZZO_AVVIO_CPU1
+ *
+ * @details Dopo il reset CPU1 attende in WFE e poi salta all'indirizzo
+ * scritto in REGISTRO_AVVIO_CPU1. L'ELF di CPU1 deve essere già stato
+ * caricato dall'FSBL.
+ */
+void avvia_cpu1(void)
+{
+	Xil_Out32(REGISTRO_AVVIO_CPU1, INDIRIZZO_AVVIO_CPU1);
+	dsb();
+	__asm__ __volatile__ ("sev");
+}
+
+/**
+ * @brief Manda un comando da CPU0 a CPU1
+ *
+ * @param tipo Uno dei comandi di tipo_messaggio_amp
+ * @param indice Indice dell'encoder
+ * @param intero Argomento intero
+ * @param valore Argomento in virgola mobile
+ * @return bool true se accodato, false se l'anello è pieno
+ */
+bool invia_comando_amp(uint8_t tipo, uint8_t indice, int16_t intero,
+					   float_t valore)
+{
+	messaggio_amp messaggio;
+
+	messaggio.tipo = tipo;
+	messaggio.indice = indice;
+	messaggio.intero = intero;
+	messaggio.valore = valore;
+	messaggio.intero_lungo = 0;
+
+	return scrivi_anello_amp(&MEMORIA_CONDIVISA->comandi, &messaggio);
+}
+
+/**
+ * @brief Manda da CPU0 a CPU1 un comando con un argomento a 64 bit
+ *
+ * @param tipo Uno dei comandi di tipo_messaggio_amp
+ * @param intero_lungo Argomento intero a 64 bit
+ * @return bool true se accodato, false se l'anello è pieno
+ */
+bool invia_comando_lungo_amp(uint8_t tipo, int64_t intero_lungo)
+{
+	messaggio_amp messaggio;
+
+	messaggio.tipo = tipo;
+	messaggio.indice = 0;
+	messaggio.intero = 0;
+	messaggio.valore = 0.0f;
+	messaggio.intero_lungo = intero_lungo;
+
+	return scrivi_anello_amp(&MEMORIA_CONDIVISA->comandi, &messaggio);
+}
+
+/**
+ * @brief Estrae un comando su CPU1
+ *
+ * @param messaggio Destinazione del comando
+ * @return bool true se un comando è stato estratto
+ */
+FUNZIONE_OCM bool ricevi_comando_amp(messaggio_amp *messaggio)
+{
+	return leggi_anello_amp(&MEMORIA_CONDIVISA->comandi, messaggio);
+}
+
+/**
+ * @brief Ritorna i messaggi che CPU0 può ancora accodare ai comandi
+ *
+ * @return uint32_t Celle libere dell'anello dei comandi
+ *
+ * @details CPU1 può solo liberare celle, quindi per l'unico produttore il
+ * valore resta valido fino al prossimo invio.
+ */
+uint32_t ritorna_spazio_comandi_amp(void)
+{
+	anello_amp *anello = &MEMORIA_CONDIVISA->comandi;
+
+	return (anello->lettura - anello->scrittura - 1U) & MASCHERA_MESSAGGI_AMP;
+}
+
+/**
+ * @brief Manda la telemetria di un encoder da CPU1 a CPU0
+ *
+ * @param indice Indice dell'encoder
+ * @param conteggio Conteggio del periodo di telemetria
+ * @param totale Conteggio cumulativo dall'inizializzazione
+ * @param velocita Velocità corrente, in m/s
+ * @return bool true se accodata, false se l'anello è pieno
+ */
+FUNZIONE_OCM bool invia_telemetria_amp(uint8_t indice, int16_t conteggio,
+									   int64_t totale, float_t velocita)
+{
+	messaggio_amp messaggio;
+
+	messaggio.tipo = (uint8_t) MESSAGGIO_TELEMETRIA;
+	messaggio.indice = indice;
+	messaggio.intero = conteggio;
+	messaggio.valore = velocita;
+	messaggio.intero_lungo = totale;
+
+	return scrivi_anello_amp(&MEMORIA_CONDIVISA->telemetria, &messaggio);
+}
+
+/**
+ * @brief Estrae un messaggio di telemetria su CPU0
+ *
+ * @param messaggio Destinazione del messaggio
+ * @return bool true se un messaggio è stato estratto
+ */
+bool ricevi_telemetria_amp(messaggio_amp *messaggio)
+{
+	return leggi_anello_amp(&MEMORIA_CONDIVISA->telemetria, messaggio);
+}
+
+/**
+ * @brief Ritorna i messaggi persi da questo core per anello pieno
+ *
+ * @return uint32_t Numero di messaggi non accodati
+ */
+uint32_t ritorna_messaggi_amp_persi(void)
+{
+	return messaggi_persi;
+}
+
+#endif
+
+
+/****************** (C) COPYRIGHT GITSIM ***** END OF FILE *******************/
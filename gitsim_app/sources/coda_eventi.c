@@ -0,0 +1,184 @@
+/**
+ ******************************************************************************
+ * @file    coda_eventi.c
+ * @author  Saimon Collaku
+ ******************************************************************************
+ */
+
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "coda_eventi.h"
+#include "sezioni_ocm.h"
+#include <stdbool.h>
+
+
+/******************************************************************************
+ * STATIC FUNCTION PROTOTYPES
+ *****************************************************************************/
+static void scambia_eventi(coda_eventi *coda, uint8_t pos_1, uint8_t pos_2);
+static bool precede(const coda_eventi *coda, uint8_t pos_1, uint8_t pos_2);
+
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+/**
+ * @brief Scambia due elementi dello heap aggiornando le posizioni
+ *
+ * @param coda Coda di eventi
+ * @param pos_1 Prima posizione nello heap
+ * @param pos_2 Seconda posizione nello heap
+ */
+FUNZIONE_OCM static void scambia_eventi(coda_eventi *coda, uint8_t pos_1, uint8_t pos_2)
+{
+	uint8_t id_1 = coda->heap[pos_1];
+	uint8_t id_2 = coda->heap[pos_2];
+
+	coda->heap[pos_1] = id_2;
+	coda->heap[pos_2] = id_1;
+	coda->posizione[id_2] = pos_1;
+	coda->posizione[id_1] = pos_2;
+}
+
+/**
+ * @brief Indica se l'evento in pos_1 avviene prima di quello in pos_2
+ *
+ * @param coda Coda di eventi
+ * @param pos_1 Prima posizione nello heap
+ * @param pos_2 Seconda posizione nello heap
+ * @return bool true se l'evento in pos_1 è strettamente precedente
+ *
+ * @note Il confronto è fatto sulla differenza con segno, quindi resta
+ * corretto anche a cavallo del riavvolgimento del contatore a 64 bit.
+ */
+FUNZIONE_OCM static bool precede(const coda_eventi *coda, uint8_t pos_1, uint8_t pos_2)
+{
+	uint64_t tempo_1 = coda->tempo[coda->heap[pos_1]];
+	uint64_t tempo_2 = coda->tempo[coda->heap[pos_2]];
+
+	return ((int64_t) (tempo_1 - tempo_2)) < 0;
+}
+
+
+/******************************************************************************
+ * GLOBAL FUNCTIONS
+ *****************************************************************************/
+
+/**
+ * @brief Inizializza una coda con tutti gli eventi allo stesso tempo
+ *
+ * @param coda Coda di eventi da inizializzare
+ * @param n_eventi Numero di sorgenti, al massimo N_EVENTI_MAX
+ * @param tempo Tempo iniziale di tutti gli eventi
+ */
+void inizializza_coda_eventi(coda_eventi *coda, uint8_t n_eventi,
+							 uint64_t tempo)
+{
+	coda->n_eventi = (n_eventi > N_EVENTI_MAX) ? N_EVENTI_MAX : n_eventi;
+
+	for (uint8_t id = 0; id < coda->n_eventi; id++)
+	{
+		coda->tempo[id] = tempo;
+		coda->heap[id] = id;
+		coda->posizione[id] = id;
+	}
+}
+
+/**
+ * @brief Cambia il tempo del prossimo evento di una sorgente
+ *
+ * @param coda Coda di eventi
+ * @param id Identificativo della sorgente
+ * @param tempo Nuovo tempo dell'evento
+ *
+ * @details L'elemento risale verso la radice se il nuovo tempo è più
+ * vicino, altrimenti scende verso le foglie.
+ */
+FUNZIONE_OCM void aggiorna_evento(coda_eventi *coda, uint8_t id, uint64_t tempo)
+{
+	uint8_t pos;
+	bool ordinato = false;
+
+	if (id < coda->n_eventi)
+	{
+		coda->tempo[id] = tempo;
+		pos = coda->posizione[id];
+
+		/* Risalita */
+		while ((pos > 0U) && (precede(coda, pos, (pos - 1U) / 2U) == true))
+		{
+			scambia_eventi(coda, pos, (pos - 1U) / 2U);
+			pos = (pos - 1U) / 2U;
+		}
+
+		/* Discesa */
+		while (ordinato == false)
+		{
+			uint8_t figlio_sx = (2U * pos) + 1U;
+			uint8_t figlio_dx = figlio_sx + 1U;
+			uint8_t minimo = pos;
+
+			if ((figlio_sx < coda->n_eventi) &&
+				(precede(coda, figlio_sx, minimo) == true))
+			{
+				minimo = figlio_sx;
+			}
+			else
+			{
+				/* Non succede niente, MISRA-2023-15.7 */
+			}
+
+			if ((figlio_dx < coda->n_eventi) &&
+				(precede(coda, figlio_dx, minimo) == true))
+			{
+				minimo = figlio_dx;
+			}
+			else
+			{
+				/* Non succede niente, MISRA-2023-15.7 */
+			}
+
+			if (minimo != pos)
+			{
+				scambia_eventi(coda, pos, minimo);
+				pos = minimo;
+			}
+			else
+			{
+				ordinato = true;
+			}
+		}
+	}
+	else
+	{
+		/* Identificativo non valido, MISRA-2023-15.7 */
+	}
+}
+
+/**
+ * @brief Restituisce la sorgente del prossimo evento
+ *
+ * @param coda Coda di eventi
+ * @return uint8_t Identificativo della sorgente con il tempo più vicino
+ */
+FUNZIONE_OCM uint8_t ritorna_primo_evento(const coda_eventi *coda)
+{
+	return coda->heap[0];
+}
+
+/**
+ * @brief Restituisce il tempo del prossimo evento
+ *
+ * @param coda Coda di eventi
+ * @return uint64_t Tempo più vicino tra tutti gli eventi in coda
+ */
+FUNZIONE_OCM uint64_t ritorna_tempo_primo_evento(const coda_eventi *coda)
+{
+	return coda->tempo[coda->heap[0]];
+}
+
+
+/****************** (C) COPYRIGHT GITSIM ***** END OF FILE *******************/
@@ -12,6 +12,19 @@
 #include "emulazione_encoder.h"
 #include "gestione_uart.h"
 #include "gestione_polling.h"
+#include "gestione_gpio.h"
+#include "xpseudo_asm.h"
+#include "sezioni_ocm.h"
+#include "xtime_l.h"
+#include "xil_exception.h"
+#include "gestione_task.h"
+#if (SCHEDULAZIONE_ENCODER == SCHEDULAZIONE_EVENTI)
+#include "coda_eventi.h"
+#include "misura_cicli.h"
+#endif
+
+/* Nella CPU0 della build AMP gli encoder girano su CPU1, vedi ponte_amp.c */
+#if (RUOLO_CORE != RUOLO_CORE_PROTOCOLLO)
 
 
 /******************************************************************************
@@ -24,6 +37,48 @@
 /** @brief Velocita' massima lineare emulabile dal GIT, in m/s */
 #define VELOCITA_MAX (700/3.6)
 
+#if (N_ENCODER > N_ENCODER_MAX) || (N_ENCODER == 0U)
+#error "N_ENCODER deve essere compreso tra 1 e N_ENCODER_MAX"
+#endif
+
+#if (MOTORE_ENCODER == MOTORE_ENCODER_PUNTO_FISSO)
+/** @brief Valore di un periodo intero nell'accumulatore di fase Q16.48 */
+#define UNO_Q48 281474976710656.0
+
+/** @brief Valore del bit meno significativo Q16.48 nelle parti sotto il bit */
+#define UNO_FRAZIONE_LSB 4294967296.0
+
+/** @brief Bit da scartare per passare da fase Q16.48 a frazione a 32 bit */
+#define SHIFT_FRAZIONE 16U
+
+/** @brief Bit da scartare per passare da fase Q16.48 a periodi interi */
+#define SHIFT_PERIODI 48U
+
+/**
+ * @brief Massimo numero di fronti in coda per un encoder
+ *
+ * Sono 16 periodi del canale. I fronti oltre questo limite non possono più
+ * essere recuperati e vengono contati come passi persi.
+ */
+#define FRONTI_IN_ATTESA_MAX 64
+#endif
+
+#if (SCHEDULAZIONE_ENCODER == SCHEDULAZIONE_EVENTI)
+/** @brief Maschera della parte frazionaria della fase Q16.48 */
+#define MASCHERA_PERIODO ((1ULL << SHIFT_PERIODI) - 1ULL)
+
+/**
+ * @brief Distanza massima di pianificazione, in tick di supervisione
+ *
+ * Un fronte più lontano viene sostituito da un evento di sola
+ * ripianificazione; di norma lo precede il tick di supervisione.
+ */
+#define ORIZZONTE_TICK 2.0
+
+/** @brief Massimo numero di eventi gestiti in un solo interrupt */
+#define EVENTI_PER_IRQ_MAX (4U * N_ENCODER)
+#endif
+
 /******************************************************************************
  * TYPEDEFS
  *****************************************************************************/
@@ -42,16 +97,73 @@ typedef enum
 	/** @brief Stato 3: Canale A = 1, Canale B = 1 */
 	tre,
 	/** @brief Stato incerto, usato per l'inizializzazione */
-	incerto
+	incerto,
+	/** @brief Numero di stati, dimensiona le tabelle di transizione */
+	N_STATI_QUADRATURA
 }stato_encoder;
 
 
-/** @brief Struttura che rappresenta un encoder incrementale emulato.
+/** @brief Soglie e limiti di un encoder pronti per il side loop.
+ *
+ *  Compilati da compila_configurazione_encoder() quando cambiano passo, duty
+ *  o fase, mai ad ogni tick. Ogni encoder ha due blocchi: si scrive quello
+ *  inattivo e poi si pubblica il puntatore (configurazione_attiva).
+ */
+typedef struct
+{
+#if (MOTORE_ENCODER == MOTORE_ENCODER_PUNTO_FISSO)
+  /** @brief Saturazione di incremento_fase, equivalente a VELOCITA_MAX. */
+  int64_t incremento_max;
+
+  /** @brief Soglia di duty del canale A, in frazione di periodo a 32 bit.
+   *  Il canale è alto quando la frazione di fase è minore della soglia.
+   */
+  uint32_t soglia_duty_A;
+
+  /** @brief Soglia di duty del canale B, in frazione di periodo a 32 bit. */
+  uint32_t soglia_duty_B;
+
+  /** @brief Sfasamento del canale B rispetto ad A, in frazione di periodo a
+   *  32 bit. Ricavato da fase.
+   */
+  uint32_t sfasamento_B;
+
+  /** @brief true se B è in anticipo su A (fase oltre 180 gradi).
+   *  Il movimento in avanti produce allora la sequenza di stati all'indietro.
+   */
+  bool quadratura_invertita;
+#else
+  /** @brief Periodo del canale, 2 * l_passo, in metri */
+  double_t periodo;
+
+  /** @brief Scostamento di B rispetto ad A, in metri (periodo * -fase/360) */
+  double_t sfasamento_B;
+
+  /** @brief true se B ha la posizione minore, cioè fase >= 0 */
+  bool b_in_ritardo;
+
+  /** @brief Duty% * 2passi per il canale A */
+  double_t soglia_pos_A;
+
+  /** @brief Duty% * 2passi per il canale B */
+  double_t soglia_pos_B;
+
+  /** @brief (1-Duty%) * -2passi per il canale A */
+  double_t soglia_neg_A;
+
+  /** @brief (1-Duty%) * -2passi per il canale B */
+  double_t soglia_neg_B;
+#endif
+
+} configurazione_tick;
+
+
+/** @brief Parametri di configurazione di un encoder incrementale emulato.
  *
- *  Questa struttura contiene tutti i parametri e le informazioni necessarie
- *  per emulare e gestire un encoder incrementale in un sistema embedded.
- *  Include caratteristiche fisiche, stati operativi/errore, e parametri di
- *  output.
+ *  Questa struttura contiene le caratteristiche fisiche, gli stati di
+ *  errore e le periferiche di uscita di un encoder. Sono dati letti o
+ *  modificati solo quando arriva un telegramma: lo stato aggiornato ad ogni
+ *  tick si trova in stato_tick_encoder.
  */
 typedef struct
 {
@@ -115,83 +227,366 @@ typedef struct
    */
   double_t l_passo;
 
+  /** @brief Accelerazione del GIT.
+   *  Misurato in m/s^2.
+   */
+  double_t acc;
+
+#if (MOTORE_ENCODER == MOTORE_ENCODER_PUNTO_FISSO)
+  /** @brief Fattore di conversione da m/s a incremento di fase Q16.48. */
+  double_t scala_velocita;
+
+  /** @brief Fattore di conversione da m/s^2 a incremento di velocità Q16.48. */
+  double_t scala_accelerazione;
+#endif
+
+} encoder;
+
+
+/** @brief Stato di tutti gli encoder aggiornato ad ogni tick.
+ *
+ *  I campi usati dal side loop sono organizzati come strutture di array
+ *  (un elemento per encoder): il ciclo sugli encoder legge ogni array in
+ *  modo sequenziale, senza attraversare i parametri di configurazione.
+ */
+typedef struct
+{
+#if (MOTORE_ENCODER == MOTORE_ENCODER_PUNTO_FISSO)
+  /** @brief Accumulatore di fase del canale A.
+   *  Q16.48 in periodi del canale (un periodo = 2 * l_passo): la parte
+   *  frazionaria è la posizione all'interno del periodo, la parte intera
+   *  conta i periodi e si riavvolge senza effetti sull'uscita.
+   */
+  uint64_t accumulatore_fase[N_ENCODER];
+
+  /** @brief Incremento di fase per tick, cioè la velocità.
+   *  Q16.48 in periodi per tick, con segno.
+   */
+  int64_t incremento_fase[N_ENCODER];
+
+  /** @brief Variazione dell'incremento di fase per tick, cioè l'accelerazione.
+   *  Q16.48 in periodi per tick al quadrato, con segno.
+   */
+  int64_t incremento_vel[N_ENCODER];
+
+  /** @brief Parte dell'accelerazione sotto il bit meno significativo di
+   *  incremento_vel, in 2^-32 bit. incremento_vel è arrotondato per difetto,
+   *  quindi la parte è sempre positiva.
+   */
+  uint32_t frazione_vel[N_ENCODER];
+
+  /** @brief Parte della velocità sotto il bit meno significativo di
+   *  incremento_fase, accumulata da frazione_vel, in 2^-32 bit.
+   */
+  uint32_t residuo_fase[N_ENCODER];
+
+  /** @brief Fronti di A e B attraversati dall'accumulatore di fase.
+   *  Contatore modulo 2^16, confrontato ad ogni tick con il valore
+   *  precedente per sapere quanti fronti sono caduti nel tick.
+   */
+  uint16_t fronti_modello[N_ENCODER];
+
+  /** @brief Fronti attraversati dal modello e non ancora emessi sui GPIO.
+   *  Con segno: positivo in avanti, negativo all'indietro.
+   */
+  int32_t fronti_in_attesa[N_ENCODER];
+
+  /** @brief Blocco di configurazione con cui è stato calcolato
+   *  fronti_modello. Se differisce da quello attivo il riferimento dei fronti
+   *  va ricalcolato.
+   */
+  const configurazione_tick *configurazione_in_uso[N_ENCODER];
+
+#if (SCHEDULAZIONE_ENCODER == SCHEDULAZIONE_EVENTI)
+  /** @brief Tempo del timer globale a cui si riferisce lo stato */
+  uint64_t tempo_ultimo[N_ENCODER];
+
+  /** @brief Fase esatta del fronte pianificato */
+  uint64_t fase_fronte[N_ENCODER];
+
+  /** @brief true se l'evento in coda è un fronte, false se è solo una
+   *  ripianificazione
+   */
+  bool fronte_programmato[N_ENCODER];
+
+  /** @brief Verso del fronte pianificato, true in avanti */
+  bool fronte_avanti[N_ENCODER];
+#endif
+#else
   /** @brief Posizione del sensore A.
    *  Misurato in metri. Rappresenta la posizione nell'intervallo di 4 passi,
    *  con risoluzione x2
    */
-  double_t pos_A;
+  double_t pos_A[N_ENCODER];
 
   /** @brief Posizione del sensore B.
    *  Misurato in metri. Rappresenta la posizione nell'intervallo di 4 passi,
    *  con risoluzione x2
    */
-  double_t pos_B;
+  double_t pos_B[N_ENCODER];
 
   /** @brief Velocità del GIT.
    *  Misurato in m/s.
    */
-  double_t vel;
+  double_t vel[N_ENCODER];
 
-  /** @brief Accelerazione del GIT.
+  /** @brief Accelerazione del GIT applicata dal side loop.
    *  Misurato in m/s^2.
    */
-  double_t acc;
+  double_t acc[N_ENCODER];
+#endif
 
-  /** @brief Numero di passi svolti dall'ultimo reset.
+  /** @brief Stato corrente dell'encoder.
+   *  Enumerazione che rappresenta lo stato operativo dell'encoder.
+   */
+  stato_encoder stato[N_ENCODER];
+
+  /** @brief Numero di passi svolti dall'ultimo reset, con segno.
    *  Conteggio contato con i passi a risoluzione x4.
    *
    *  @note quindi la lunghezza del passo equivalente per il
    *  calcolo dei conteggi e la metà rispetto a quello della
    *  variabile l_passo.
    */
-  uint16_t conteggio;
+  int16_t conteggio[N_ENCODER];
 
-  /** @brief Indirizzo GPIO per il canale A.
-   *  Struttura XGpio per la gestione del GPIO del canale A.
+  /** @brief Numero di passi svolti dall'inizializzazione, con segno.
+   *  Come conteggio, ma non viene azzerato da reset_conteggi_encoder(): a
+   *  64 bit non si riavvolge nella vita del sistema.
    */
-  XGpio indirizzo_gpio_A;
+  int64_t conteggio_totale[N_ENCODER];
 
-  /** @brief Indirizzo GPIO per il canale B.
-   *  Struttura XGpio per la gestione del GPIO del canale B.
+  /** @brief Numero di cambi contemporanei di A e B dall'inizializzazione.
+   *  Ogni transizione illegale è un passo perso dal conteggio. Con il motore a
+   *  punto fisso include i fronti scartati perché la coda era piena.
    */
-  XGpio indirizzo_gpio_B;
+  uint32_t transizioni_illegali[N_ENCODER];
 
-  /** @brief Stato corrente dell'encoder.
-   *  Enumerazione che rappresenta lo stato operativo dell'encoder.
+  /** @brief Numero di fronti emessi in un tick successivo a quello in cui
+   *  sono stati attraversati, dall'inizializzazione.
    */
-  stato_encoder stato;
+  uint32_t fronti_compensati[N_ENCODER];
 
-} encoder;
+} stato_tick_encoder;
+
+
+/** @brief Casella dei comandi dal main loop al side loop.
+ *
+ *  Funziona come un seqlock: il main loop rende dispari sequenza prima di
+ *  scrivere e la riporta pari dopo; il side loop applica i comandi solo con
+ *  sequenza pari. Le maschere hanno il bit i a 1 se c'è un comando in attesa
+ *  per l'encoder i; comandi successivi non ancora applicati si sommano.
+ */
+typedef struct
+{
+  /** @brief Numero di sequenza, dispari durante una scrittura */
+  volatile uint32_t sequenza;
+
+  /** @brief Encoder con una nuova velocità in attesa */
+  uint32_t maschera_velocita;
+
+  /** @brief Encoder con una nuova accelerazione in attesa */
+  uint32_t maschera_accelerazione;
+
+#if (MOTORE_ENCODER == MOTORE_ENCODER_PUNTO_FISSO)
+  /** @brief Encoder la cui velocità va riportata alla nuova scala */
+  uint32_t maschera_riscala;
+
+  /** @brief Velocità da assegnare, come incremento_fase */
+  int64_t velocita[N_ENCODER];
+
+  /** @brief Accelerazione da assegnare, come incremento_vel */
+  int64_t accelerazione[N_ENCODER];
+
+  /** @brief Parte dell'accelerazione da assegnare, come frazione_vel */
+  uint32_t frazione_accelerazione[N_ENCODER];
+
+  /** @brief Rapporto tra nuova e vecchia scala_velocita */
+  double_t fattore_riscala[N_ENCODER];
+#else
+  /** @brief Velocità da assegnare, in m/s */
+  double_t velocita[N_ENCODER];
+
+  /** @brief Accelerazione da assegnare, in m/s^2 */
+  double_t accelerazione[N_ENCODER];
+#endif
+
+} casella_comandi_encoder;
+
+
+/** @brief Gruppo di comandi in attesa del suo tick */
+typedef struct
+{
+  /** @brief Tick del side loop in cui applicare i comandi */
+  uint32_t tick;
+
+  /** @brief Comandi del gruppo, con la sequenza non usata */
+  casella_comandi_encoder comandi;
+
+} comando_programmato;
 
 
 /******************************************************************************
  * STATIC VARIABLES
  *****************************************************************************/
 
-/** @brief Tempo di aggiornamento delle variabili di encoder */
-static float_t t_update;
+/**
+ * @brief Tempo di aggiornamento delle variabili di encoder, in secondi
+ *
+ * Ricavato in double_t dai conteggi interi del timer globale per tick,
+ * non dal float di ritorna_tempo_del_polling(): l'errore relativo di un
+ * float (circa 1e-8) diventerebbe una deriva di centimetri in un giorno.
+ */
+static double_t t_update DATI_OCM;
+
+/**
+ *  @brief Parametri di configurazione di tutti gli encoder, indicizzati da
+ *  0 a N_ENCODER - 1
+ */
+static encoder parametri_encoder[N_ENCODER] DATI_OCM;
+
+/** @brief Stato aggiornato ad ogni tick di tutti gli encoder */
+static stato_tick_encoder stato_tick DATI_OCM;
+
+/** @brief Doppio buffer dei blocchi di configurazione di ogni encoder */
+static configurazione_tick blocchi_configurazione[N_ENCODER][2] DATI_OCM;
+
+/**
+ * @brief Blocco di configurazione letto dal side loop, per ogni encoder
+ *
+ * Scritto solo da compila_configurazione_encoder(). La scrittura di un
+ * puntatore è atomica, quindi l'interrupt vede sempre un blocco completo.
+ */
+static const configurazione_tick * volatile configurazione_attiva[N_ENCODER] DATI_OCM;
+
+/** @brief Comandi in attesa di essere applicati dal side loop */
+static casella_comandi_encoder casella_comandi DATI_OCM;
+
+/** @brief Livello di annidamento di apri_comandi_encoder() */
+static uint8_t profondita_comandi;
+
+/**
+ * @brief Casella in cui scrivono le funzioni assegna_*
+ *
+ * È casella_comandi, tranne tra apri_comandi_programmati() e
+ * chiudi_comandi_programmati(), quando è gruppo_in_scrittura.comandi.
+ */
+static casella_comandi_encoder *casella_in_scrittura = &casella_comandi;
+
+/** @brief Gruppo programmato in preparazione nel main loop */
+static comando_programmato gruppo_in_scrittura;
+
+/**
+ * @brief Gruppi programmati ordinati per tick, il primo è il più vicino
+ *
+ * Il main loop inserisce con l'interrupt mascherato, il side loop estrae
+ * dalla testa.
+ */
+static comando_programmato coda_programmati[N_COMANDI_PROGRAMMATI] DATI_OCM;
+
+/** @brief Gruppi validi in coda_programmati */
+static volatile uint8_t n_programmati DATI_OCM;
+
+/** @brief Gruppi rifiutati da apri_comandi_programmati() per coda piena */
+static uint32_t programmati_scartati;
+
+#if (SCHEDULAZIONE_ENCODER == SCHEDULAZIONE_EVENTI)
+/** @brief Conteggi del timer globale in un tick di supervisione */
+static double_t conteggi_per_tick DATI_OCM;
+
+/** @brief Prossimo evento di ogni encoder, ordinato per tempo */
+static coda_eventi coda_fronti DATI_OCM;
+
+#if (MISURA_CICLI_ENCODER == 1U)
+/**
+ * @brief Cicli CPU spesi in ogni interrupt del comparatore
+ *
+ * Da leggere con il debugger e confrontare con cicli_encoder di side.c
+ * compilato con la schedulazione a polling.
+ */
+static statistica_cicli cicli_eventi;
+#endif
+#endif
 
 /**
- *  @brief Struttura dati utilizzata per contenere tutte le variabili
- * di stato dell'encoder 1
+ * @brief Variazione del conteggio per ogni transizione di stato
+ *
+ * Indicizzata da (stato precedente << 2) | (A << 1) | B. In avanti la
+ * sequenza degli stati è due -> tre -> uno -> zero -> due.
  */
-static encoder e_1;
+static const int8_t delta_quadratura[N_STATI_QUADRATURA * 4U] COSTANTI_OCM =
+{
+	/* Da zero:    zero, uno,  due,  tre */
+	 0, -1, +1,  0,
+	/* Da uno */
+	+1,  0,  0, -1,
+	/* Da due */
+	-1,  0,  0, +1,
+	/* Da tre */
+	 0, +1, -1,  0,
+	/* Da incerto */
+	 0,  0,  0,  0
+};
 
 /**
- *  @brief Struttura dati utilizzata per contenere tutte le variabili
- * di stato dell'encoder 2
+ * @brief 1 per le transizioni in cui A e B cambiano insieme, 0 altrimenti
+ *
+ * Indicizzata come delta_quadratura.
  */
-static encoder e_2;
+static const uint8_t transizione_illegale[N_STATI_QUADRATURA * 4U] COSTANTI_OCM =
+{
+	/* Da zero:    zero, uno,  due,  tre */
+	0, 0, 0, 1,
+	/* Da uno */
+	0, 0, 1, 0,
+	/* Da due */
+	0, 1, 0, 0,
+	/* Da tre */
+	1, 0, 0, 0,
+	/* Da incerto */
+	0, 0, 0, 0
+};
+
+#if (MOTORE_ENCODER == MOTORE_ENCODER_PUNTO_FISSO)
+/** @brief Stato successivo in avanti, usato per emettere i fronti in coda */
+static const stato_encoder stato_avanti[N_STATI_QUADRATURA] COSTANTI_OCM =
+{
+	due, zero, tre, uno, incerto
+};
 
+/** @brief Stato successivo all'indietro, usato per emettere i fronti in coda */
+static const stato_encoder stato_indietro[N_STATI_QUADRATURA] COSTANTI_OCM =
+{
+	uno, tre, zero, due, incerto
+};
+#endif
 
 /******************************************************************************
  * STATIC FUNCTION PROTOTYPES
  *****************************************************************************/
-static void aggiorna_encoder(encoder *e_x);
-static void emula_encoder(encoder *e_x);
-static void inizializza_encoder(encoder *e_x);
-static void valuta_stato_encoder(encoder *e_x, bool statoA, bool statoB);
-static void reset_gpio(encoder *e_x);
+#if (SCHEDULAZIONE_ENCODER == SCHEDULAZIONE_POLLING)
+static void aggiorna_encoder(uint8_t indice, uint32_t n_tick);
+#endif
+static void emula_encoder(uint8_t indice);
+static void inizializza_encoder(uint8_t indice);
+static void valuta_stato_encoder(uint8_t indice, bool statoA, bool statoB);
+static void compila_configurazione_encoder(uint8_t indice);
+static void applica_casella_encoder(casella_comandi_encoder *casella);
+static void applica_comandi_encoder(void);
+static void applica_comandi_programmati(void);
+#if (MOTORE_ENCODER == MOTORE_ENCODER_PUNTO_FISSO)
+static void aggiorna_scale_punto_fisso(uint8_t indice);
+static int64_t converti_in_q48(double_t valore, double_t scala,
+							   int64_t limite);
+static void converti_accelerazione(uint8_t indice);
+static uint16_t conta_fronti(const configurazione_tick *conf, uint64_t fase);
+#endif
+#if (SCHEDULAZIONE_ENCODER == SCHEDULAZIONE_EVENTI)
+static void avanza_encoder_a(uint8_t indice, uint64_t tempo);
+static uint64_t distanza_fronte(const configurazione_tick *conf,
+								uint64_t fase, bool avanti);
+static void pianifica_fronte_encoder(uint8_t indice);
+#endif
 
 
 /******************************************************************************
@@ -201,7 +596,9 @@ static void reset_gpio(encoder *e_x);
 /**
  * @brief Aggiorna lo stato di un encoder
  *
- * @param e_x Puntatore alla struttura dell'encoder da aggiornare
+ * @param indice Indice dell'encoder da aggiornare
+ * @param n_tick Tick nominali da integrare, più di uno dopo un overrun o
+ * con il tick degradato
  *
  * @details Questa funzione aggiorna la velocità, la posizione e gestisce
  * la saturazione per un encoder. Implementa un modello di movimento
@@ -223,8 +620,74 @@ static void reset_gpio(encoder *e_x);
  * @see VELOCITA_MAX
  * @see t_update
  */
-static void aggiorna_encoder(encoder *e_x)
+#if (SCHEDULAZIONE_ENCODER == SCHEDULAZIONE_EVENTI)
+/* Con la schedulazione a eventi l'integrazione è in avanza_encoder_a() */
+#elif (MOTORE_ENCODER == MOTORE_ENCODER_PUNTO_FISSO)
+FUNZIONE_OCM static void aggiorna_encoder(uint8_t indice, uint32_t n_tick)
+{
+	int64_t incremento_max = configurazione_attiva[indice]->incremento_max;
+	int64_t incremento_precedente = stato_tick.incremento_fase[indice];
+	int64_t avanzamento;
+
+	/* Parti sotto il bit: il riporto passa nella velocità */
+	uint64_t residuo = ((uint64_t) stato_tick.residuo_fase[indice]) +
+					   (((uint64_t) n_tick) * stato_tick.frazione_vel[indice]);
+
+	/* Integrazione dell'accelerazione */
+	int64_t incremento = incremento_precedente +
+						 (((int64_t) n_tick) * stato_tick.incremento_vel[indice]) +
+						 ((int64_t) (residuo >> 32U));
+
+	stato_tick.residuo_fase[indice] = (uint32_t) residuo;
+
+	/* Saturo la velocità se va oltre la soglia fissata */
+	if (incremento > incremento_max)
+	{
+		incremento = incremento_max;
+		stato_tick.residuo_fase[indice] = 0;
+	}
+	else if (incremento < -incremento_max)
+	{
+		incremento = -incremento_max;
+		stato_tick.residuo_fase[indice] = 0;
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+	stato_tick.incremento_fase[indice] = incremento;
+
+	if (n_tick == 1U)
+	{
+		avanzamento = incremento;
+	}
+	else
+	{
+		/*
+		 * Somma degli incrementi dei tick recuperati, n * v0 + a * n(n+1)/2,
+		 * esatta se la velocità non satura durante l'intervallo
+		 */
+		avanzamento = (((int64_t) n_tick) * (incremento_precedente + incremento +
+						stato_tick.incremento_vel[indice])) / 2;
+	}
+
+	/*
+	 * Integro la velocità. La somma modulo 2^64 riavvolge da sola la fase
+	 * sul periodo, quindi non serve la correzione dello spazio del modello
+	 * in virgola mobile
+	 */
+	stato_tick.accumulatore_fase[indice] =
+			stato_tick.accumulatore_fase[indice] + ((uint64_t) avanzamento);
+}
+#else
+FUNZIONE_OCM static void aggiorna_encoder(uint8_t indice, uint32_t n_tick)
 {
+	/* Soglie compilate dell'encoder */
+	const configurazione_tick *conf = configurazione_attiva[indice];
+
+	/* Tempo reale trascorso dal tick precedente */
+	double_t t_trascorso = t_update * ((double_t) n_tick);
+
 	/*
 	 * Contiene la posizione MINORE tra quella
 	*  del canale A e B, serve per la correzione
@@ -240,16 +703,17 @@ static void aggiorna_encoder(encoder *e_x)
 	double_t pos_maggiore;
 
 	/* Integrazione dell'accelerazione */
-	e_x->vel = (e_x->acc * t_update) + e_x->vel;
+	stato_tick.vel[indice] = (stato_tick.acc[indice] * t_trascorso) +
+							 stato_tick.vel[indice];
 
 	/* Saturo la velocità se va oltre la soglia fissata */
-	if (e_x->vel > VELOCITA_MAX)
+	if (stato_tick.vel[indice] > VELOCITA_MAX)
 	{
-		e_x->vel = VELOCITA_MAX;
+		stato_tick.vel[indice] = VELOCITA_MAX;
 	}
-	else if (e_x->vel < -VELOCITA_MAX)
+	else if (stato_tick.vel[indice] < -VELOCITA_MAX)
 	{
-		e_x->vel = -VELOCITA_MAX;
+		stato_tick.vel[indice] = -VELOCITA_MAX;
 	}
 	else
 	{
@@ -260,51 +724,63 @@ static void aggiorna_encoder(encoder *e_x)
 	 * Integro la velocità, assegno lo spazio ad A
 	 * (è una scelta arbitraria)
 	 */
-	e_x->pos_A = e_x->pos_A + (e_x->vel * t_update);
+	stato_tick.pos_A[indice] = stato_tick.pos_A[indice] + (stato_tick.vel[indice] * t_trascorso);
 
 	/*
-	 * Estrapolo il fattore di sfasamento, cio� converto i gradi nella
-	 * quantit� di spazio da cui il canale B si discosta dal canale A
+	 * Con più tick da recuperare lo spazio può uscire di più periodi: lo
+	 * riporto entro un periodo, la correzione sotto fa il resto
 	 */
-	float_t k_fase = ((float_t) - (e_x->fase) / 360);
-	e_x->pos_B = e_x->pos_A + (2 * e_x->l_passo * k_fase);
+	if (n_tick > 1U)
+	{
+		stato_tick.pos_A[indice] = fmod(stato_tick.pos_A[indice], conf->periodo);
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+
+	/*
+	 * Il canale B si discosta dal canale A della quantità di spazio
+	 * ricavata dai gradi di sfasamento
+	 */
+	stato_tick.pos_B[indice] = stato_tick.pos_A[indice] + conf->sfasamento_B;
 
 	/*
 	 * Indico chi è il sensore con la posizione maggiore e quale con la
 	 * minore, mi serve per fare il controllo sulla correzione di spazio
 	 */
-	if (k_fase <= 0)
+	if (conf->b_in_ritardo == true)
 	{
 		/* Posizione del B è minore dell'A */
-		pos_minore = e_x->pos_B;
-		pos_maggiore = e_x->pos_A;
+		pos_minore = stato_tick.pos_B[indice];
+		pos_maggiore = stato_tick.pos_A[indice];
 	}
 	else
 	{
 		/* Posizione dell'A è minore del B */
-		pos_minore = e_x->pos_A;
-		pos_maggiore = e_x->pos_B;
+		pos_minore = stato_tick.pos_A[indice];
+		pos_maggiore = stato_tick.pos_B[indice];
 	}
 
 	/* Satura lo spazio se uno dei due sensori va oltre la
 	soglia [-2*passi, 2*passi] */
-	if (pos_minore <= (-2 * e_x->l_passo))
+	if (pos_minore <= -conf->periodo)
 	{
 		/*
 		 * Il MINORE ha sforato, esso ritorna a 0 mentre il maggiore
 		 * va ad un valore maggiore di 0 (dipende dalla fase)
 		 */
-		e_x->pos_A = e_x->pos_A + (2 * e_x->l_passo);
-		e_x->pos_B = e_x->pos_B + (2 * e_x->l_passo);
+		stato_tick.pos_A[indice] = stato_tick.pos_A[indice] + conf->periodo;
+		stato_tick.pos_B[indice] = stato_tick.pos_B[indice] + conf->periodo;
 	}
-	else if (pos_maggiore >= (2 * e_x->l_passo))
+	else if (pos_maggiore >= conf->periodo)
 	{
 		/*
 		 * Il MAGGIORE ha sforato, esso ritorna a 0 mentre il minore
 		 * va ad un valore minore di 0 (dipende dalla fase)
 		 */
-		e_x->pos_A = e_x->pos_A - (2 * e_x->l_passo);
-		e_x->pos_B = e_x->pos_B - (2 * e_x->l_passo);
+		stato_tick.pos_A[indice] = stato_tick.pos_A[indice] - conf->periodo;
+		stato_tick.pos_B[indice] = stato_tick.pos_B[indice] - conf->periodo;
 	}
 	else
 	{
@@ -313,51 +789,171 @@ static void aggiorna_encoder(encoder *e_x)
 
 	return;
 }
+#endif
 
 /**
  * @brief Emula il comportamento di un encoder
  *
- * @param e_x Puntatore alla struttura dell'encoder da emulare
+ * @param indice Indice dell'encoder da emulare
  *
  * @details
  * Questa funzione simula il comportamento di un encoder generando segnali
  * per i canali A e B basati sulla posizione attuale dell'encoder. Il processo
  * include:
- * 1. Calcolo delle soglie basate sul duty cycle per ciascun canale
- * 2. Generazione dei segnali per i canali A e B usando GPIO
+ * 1. Lettura delle soglie compilate per ciascun canale
+ * 2. Generazione dei segnali per i canali A e B, registrati nell'immagine
+ * delle uscite GPIO
  * 3. Valutazione dello stato dell'encoder basata sui segnali generati
  *
  * @note
- * - Assume l'uso di XGpio per la scrittura dei segnali
+ * - La scrittura sui GPIO avviene una volta sola per tick, in
+ * emula_sensori_encoder(), con scrivi_uscite_gpio()
  * - Il comportamento è influenzato dai duty cycle e dalle posizioni dei canali
  * A e B
+ * - Con il motore a punto fisso, se in un tick cade più di un fronte, le
+ * uscite avanzano di un passo di quadratura per tick e i fronti restanti
+ * vengono emessi nei tick successivi (fronti_in_attesa). Se duty e fase non
+ * alternano i fronti di A e B, durante il recupero la forma d'onda è quella
+ * di un encoder ideale
  * - Utilizza la funzione valuta_stato_encoder per aggiornare lo stato dell'
  * encoder
  *
- * @see encoder, valuta_stato_encoder, XGpio_DiscreteWrite
+ * @see encoder, valuta_stato_encoder, imposta_uscite_encoder_gpio
  */
-static void emula_encoder(encoder *e_x)
+#if (MOTORE_ENCODER == MOTORE_ENCODER_PUNTO_FISSO)
+FUNZIONE_OCM static void emula_encoder(uint8_t indice)
 {
-	/* Stato del canale, equivalente al valore logico di GPIO corrispondente */
+	/* Soglie compilate dell'encoder */
+	const configurazione_tick *conf = configurazione_attiva[indice];
+
+	/* Fronti attraversati in questo tick, con segno */
+	uint16_t fronti;
+	int32_t fronti_tick;
+	int32_t attesa = stato_tick.fronti_in_attesa[indice];
+	stato_encoder stato = stato_tick.stato[indice];
+
 	bool stato_sensoreA;
 	bool stato_sensoreB;
 
-	/* Porto i duty cycle da percentuale intera a decimale */
-	float_t k_dutyA = ((float_t) e_x->duty_A) * 0.01;
-	float_t k_dutyB = ((float_t) e_x->duty_B) * 0.01;
+	/*
+	 * Con soglie nuove i fronti si spostano senza che l'encoder si muova:
+	 * riallineo il riferimento per non contarli come movimento. Si perdono
+	 * al più i fronti del tick in cui cambia la configurazione
+	 */
+	if (conf != stato_tick.configurazione_in_uso[indice])
+	{
+		stato_tick.fronti_modello[indice] =
+				conta_fronti(conf, stato_tick.accumulatore_fase[indice]);
+		stato_tick.configurazione_in_uso[indice] = conf;
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+
+	fronti = conta_fronti(conf, stato_tick.accumulatore_fase[indice]);
+	fronti_tick =
+			(int32_t) ((int16_t) (fronti - stato_tick.fronti_modello[indice]));
+	stato_tick.fronti_modello[indice] = fronti;
+
+	if (((attesa == 0) && (fronti_tick >= -1) && (fronti_tick <= 1)) ||
+		(stato == incerto))
+	{
+		/* Posizione dei due canali all'interno del periodo, su 32 bit */
+		uint32_t frazione_A = (uint32_t) (stato_tick.accumulatore_fase[indice] >>
+										  SHIFT_FRAZIONE);
+		uint32_t frazione_B = frazione_A + conf->sfasamento_B;
+
+		/*
+		 * Il canale è alto nella prima parte del periodo, lunga quanto il duty.
+		 * Equivale ai quattro intervalli del modello in virgola mobile, perché
+		 * la frazione è già riportata nell'intervallo [0, 2passi)
+		 */
+		stato_sensoreA = (frazione_A < conf->soglia_duty_A);
+		stato_sensoreB = (frazione_B < conf->soglia_duty_B);
+	}
+	else
+	{
+		/*
+		 * Più di un fronte da emettere: un solo passo di quadratura per tick,
+		 * gli altri restano in coda per i tick successivi. Il ricevitore vede
+		 * solo transizioni legali e il conteggio resta esatto
+		 */
+		if (attesa != 0)
+		{
+			stato_tick.fronti_compensati[indice]++;
+		}
+		else
+		{
+			/* Il fronte emesso è di questo tick, MISRA-2023-15.7 */
+		}
+
+		attesa = attesa + fronti_tick;
+		if (attesa > 0)
+		{
+			stato = (conf->quadratura_invertita == true) ?
+					stato_indietro[stato] : stato_avanti[stato];
+			attesa--;
+		}
+		else if (attesa < 0)
+		{
+			stato = (conf->quadratura_invertita == true) ?
+					stato_avanti[stato] : stato_indietro[stato];
+			attesa++;
+		}
+		else
+		{
+			/* Fronti in verso opposto si sono annullati, MISRA-2023-15.7 */
+		}
+
+		/* Oltre il limite della coda i fronti sono persi */
+		if (attesa > FRONTI_IN_ATTESA_MAX)
+		{
+			stato_tick.transizioni_illegali[indice] +=
+					(uint32_t) (attesa - FRONTI_IN_ATTESA_MAX);
+			attesa = FRONTI_IN_ATTESA_MAX;
+		}
+		else if (attesa < -FRONTI_IN_ATTESA_MAX)
+		{
+			stato_tick.transizioni_illegali[indice] +=
+					(uint32_t) (-FRONTI_IN_ATTESA_MAX - attesa);
+			attesa = -FRONTI_IN_ATTESA_MAX;
+		}
+		else
+		{
+			/* Non succede niente, MISRA-2023-15.7 */
+		}
+
+		stato_tick.fronti_in_attesa[indice] = attesa;
+		stato_sensoreA = ((((uint32_t) stato) >> 1U) & 1U) != 0U;
+		stato_sensoreB = (((uint32_t) stato) & 1U) != 0U;
+	}
+
+	imposta_uscite_encoder_gpio(indice, stato_sensoreA, stato_sensoreB);
+	valuta_stato_encoder(indice, stato_sensoreA, stato_sensoreB);
+}
+#else
+FUNZIONE_OCM static void emula_encoder(uint8_t indice)
+{
+	/* Posizioni dei due canali */
+	double_t pos_A = stato_tick.pos_A[indice];
+	double_t pos_B = stato_tick.pos_B[indice];
+
+	/* Stato del canale, equivalente al valore logico di GPIO corrispondente */
+	bool stato_sensoreA = false;
+	bool stato_sensoreB = false;
 
 	/*
-	 * Genero le soglie su cui fare il confronto, per stimare in che
-	 * posizione è il sensore
+	 * Soglie su cui fare il confronto per stimare in che posizione è il
+	 * sensore, compilate da compila_configurazione_encoder()
 	 */
-	double_t soglia_max_def = 2 * e_x->l_passo; /* 2passi */
+	const configurazione_tick *conf = configurazione_attiva[indice];
+	double_t soglia_max_def = conf->periodo; /* 2passi */
 	double_t soglia_min_def = - soglia_max_def; /* -2passi */
-	/* Duty% * 2passi */
-	double_t soglia_pos_A = k_dutyA * soglia_max_def;
-	double_t soglia_pos_B = k_dutyB * soglia_max_def;
-	/* (1-Duty%) * 2passi */
-	double_t soglia_neg_A = (1 - k_dutyA) * soglia_min_def;
-	double_t soglia_neg_B = (1 - k_dutyB) * soglia_min_def;
+	double_t soglia_pos_A = conf->soglia_pos_A;
+	double_t soglia_pos_B = conf->soglia_pos_B;
+	double_t soglia_neg_A = conf->soglia_neg_A;
+	double_t soglia_neg_B = conf->soglia_neg_B;
 
 	/*
 	 * Generazione segnale per canale A da GPIO,
@@ -368,24 +964,20 @@ static void emula_encoder(encoder *e_x)
 	 * Esempio: il range dello spazio � 0 -> 2 passi, se duty = 50%
 	 * la soglia di transizione alto/basso sar� 1 passo.
 	 */
-	if ((e_x->pos_A >= soglia_min_def) && (e_x->pos_A < soglia_neg_A))
+	if ((pos_A >= soglia_min_def) && (pos_A < soglia_neg_A))
 	{
-		XGpio_DiscreteWrite(&e_x->indirizzo_gpio_A, 1, 0x01);
 		stato_sensoreA = true;
 	}
-	else if ((e_x->pos_A >= soglia_neg_A) && (e_x->pos_A < 0))
+	else if ((pos_A >= soglia_neg_A) && (pos_A < 0))
 	{
-		XGpio_DiscreteWrite(&e_x->indirizzo_gpio_A, 1, 0x00);
 		stato_sensoreA = false;
 	}
-	else if  ((e_x->pos_A >= 0) && (e_x->pos_A < soglia_pos_A))
+	else if  ((pos_A >= 0) && (pos_A < soglia_pos_A))
 	{
-		XGpio_DiscreteWrite(&e_x->indirizzo_gpio_A, 1, 0x01);
 		stato_sensoreA = true;
 	}
-	else if ((e_x->pos_A >= soglia_pos_A) && (e_x->pos_A < soglia_max_def))
+	else if ((pos_A >= soglia_pos_A) && (pos_A < soglia_max_def))
 	{
-		XGpio_DiscreteWrite(&e_x->indirizzo_gpio_A, 1, 0x00);
 		stato_sensoreA = false;
 	}
 	else
@@ -397,24 +989,20 @@ static void emula_encoder(encoder *e_x)
 	 * Generazione segnale per canale B da GPIO, valgono gli stessi
 	 * ragionamenti del canale A
 	 */
-	if ((e_x->pos_B >= soglia_min_def) && (e_x->pos_B < soglia_neg_B))
+	if ((pos_B >= soglia_min_def) && (pos_B < soglia_neg_B))
 	{
-		XGpio_DiscreteWrite(&e_x->indirizzo_gpio_B, 1, 0x01);
 		stato_sensoreB = true;
 	}
-	else if ((e_x->pos_B >= soglia_neg_B) && (e_x->pos_B < 0))
+	else if ((pos_B >= soglia_neg_B) && (pos_B < 0))
 	{
-		XGpio_DiscreteWrite(&e_x->indirizzo_gpio_B, 1, 0x00);
 		stato_sensoreB = false;
 	}
-	else if  ((e_x->pos_B >= 0) && (e_x->pos_B < soglia_pos_B))
+	else if  ((pos_B >= 0) && (pos_B < soglia_pos_B))
 	{
-		XGpio_DiscreteWrite(&e_x->indirizzo_gpio_B, 1, 0x01);
 		stato_sensoreB = true;
 	}
-	else if ((e_x->pos_B >= soglia_pos_B) && (e_x->pos_B < soglia_max_def))
+	else if ((pos_B >= soglia_pos_B) && (pos_B < soglia_max_def))
 	{
-		XGpio_DiscreteWrite(&e_x->indirizzo_gpio_B, 1, 0x00);
 		stato_sensoreB = false;
 	}
 	else
@@ -422,16 +1010,18 @@ static void emula_encoder(encoder *e_x)
 		/* Non succede niente, MISRA-2023-15.7 */
 	}
 
-	valuta_stato_encoder(e_x, stato_sensoreA, stato_sensoreB);
+	imposta_uscite_encoder_gpio(indice, stato_sensoreA, stato_sensoreB);
+	valuta_stato_encoder(indice, stato_sensoreA, stato_sensoreB);
 }
+#endif
 
 /**
- * @brief Inizializza una struttura encoder con valori predefiniti
+ * @brief Inizializza un encoder con valori predefiniti
  *
- * @param e_x Puntatore alla struttura dell'encoder da inizializzare
+ * @param indice Indice dell'encoder da inizializzare
  *
  * @details
- * Imposta i valori iniziali per tutti i campi della struttura encoder,
+ * Imposta i valori iniziali per i parametri e lo stato di tick dell'encoder,
  * inclusi:
  * velocità, accelerazione, posizioni, duty cycle, fase, conteggio, stato di
  * incollaggio,
@@ -440,129 +1030,695 @@ static void emula_encoder(encoder *e_x)
  * @note
  * - Il valore di PI_GRECO deve essere definito altrove nel codice
  * - I valori iniziali sono pensati per un encoder standard a quadratura
+ * - Lo stato di tick è a 64 bit e il side loop lo legge a ogni tick: viene
+ * azzerato con l'interrupt mascherato, così il side loop non vede mai un
+ * accumulatore scritto a metà
  *
- * @see encoder
+ * @see encoder, stato_tick_encoder
  */
-static void inizializza_encoder(encoder *e_x)
+static void inizializza_encoder(uint8_t indice)
 {
-	e_x->vel = 0;
+	encoder *e_x = &parametri_encoder[indice];
+	u32 cpsr = mfcpsr();
+
 	e_x->acc = 0;
-	e_x->pos_A = 0;
-	e_x->pos_B = PI_GRECO / 512;
 	e_x->duty_A = 50;
 	e_x->duty_B = 50;
 	e_x->fase = 90;
-	e_x->conteggio = 0;
 	e_x->incollaggio_A = false;
 	e_x->incollaggio_B = false;
 	e_x->ppr = 128;
 	e_x->diametro = 1;
 	e_x->l_passo = PI_GRECO / 256;
+
+	mtcpsr(cpsr | XIL_EXCEPTION_IRQ);
+
+	stato_tick.conteggio[indice] = 0;
+	stato_tick.conteggio_totale[indice] = 0;
+	stato_tick.transizioni_illegali[indice] = 0;
+	stato_tick.fronti_compensati[indice] = 0;
+	stato_tick.stato[indice] = incerto;
+#if (MOTORE_ENCODER == MOTORE_ENCODER_PUNTO_FISSO)
+	stato_tick.accumulatore_fase[indice] = 0;
+	stato_tick.incremento_fase[indice] = 0;
+	stato_tick.incremento_vel[indice] = 0;
+	stato_tick.frazione_vel[indice] = 0;
+	stato_tick.residuo_fase[indice] = 0;
+	stato_tick.fronti_in_attesa[indice] = 0;
+	stato_tick.configurazione_in_uso[indice] = NULL;
+#else
+	stato_tick.vel[indice] = 0;
+	stato_tick.acc[indice] = 0;
+	stato_tick.pos_A[indice] = 0;
+	stato_tick.pos_B[indice] = PI_GRECO / 512;
+#endif
+
+	mtcpsr(cpsr);
+
+	/* Le scale e le soglie passano da casella e doppio buffer */
+#if (MOTORE_ENCODER == MOTORE_ENCODER_PUNTO_FISSO)
+	aggiorna_scale_punto_fisso(indice);
+#else
+	compila_configurazione_encoder(indice);
+#endif
 }
 
+#if (MOTORE_ENCODER == MOTORE_ENCODER_PUNTO_FISSO)
 /**
- * @brief Resetta lo stato dei GPIO associati all'encoder
+ * @brief Ricalcola i parametri interi del motore a punto fisso
  *
- * @param e_x Puntatore alla struttura dell'encoder
+ * @param indice Indice dell'encoder
  *
- * @details
- * Configura i GPIO associati ai canali A e B dell'encoder come output
- * e li imposta a un valore basso (0).
+ * @details Va chiamata ogni volta che cambia l_passo. Calcola i fattori di
+ * scala da unità fisiche a incrementi per tick e ricompila il blocco di
+ * configurazione. La velocità in corso viene conservata in m/s con un
+ * comando di riscalatura, l'accelerazione viene riconvertita dal valore
+ * assegnato in acc; entrambi passano dalla casella dei comandi.
  *
- * @note
- * - Utilizza le funzioni XGpio per la configurazione e il controllo dei GPIO
- * - Assume che i campi indirizzo_gpio_A e indirizzo_gpio_B siano correttamente
- *  inizializzati
+ * Con un periodo del canale pari a 2 * l_passo:
+ * @f[
+ *    scala_{vel} = \frac{t_{update}}{2 \cdot l_{passo}} \cdot 2^{48}
+ *    \qquad
+ *    scala_{acc} = scala_{vel} \cdot t_{update}
+ * @f]
  *
- * @see encoder, XGpio_SetDataDirection, XGpio_DiscreteClear
+ * @note Q16.48 al posto di Q32.32: con tick di 4 us un'accelerazione di
+ * 0.01 m/s^2 vale circa 1e-11 periodi per tick^2, sotto la risoluzione di una
+ * parte frazionaria a 32 bit.
+ *
+ * @see aggiorna_encoder, emula_encoder, compila_configurazione_encoder
  */
-static void reset_gpio(encoder *e_x)
+static void aggiorna_scale_punto_fisso(uint8_t indice)
 {
+	encoder *e_x = &parametri_encoder[indice];
+	double_t scala_precedente = e_x->scala_velocita;
+	double_t periodo = 2 * e_x->l_passo;
+	uint32_t bit_encoder = 1UL << indice;
 
-    XGpio_SetDataDirection(&e_x->indirizzo_gpio_A, 1, 0x00);
-    XGpio_DiscreteClear(&e_x->indirizzo_gpio_A, 1, 0x01);
-    XGpio_SetDataDirection(&e_x->indirizzo_gpio_B, 1, 0x00);
-    XGpio_DiscreteClear(&e_x->indirizzo_gpio_B, 1, 0x01);
-}
+	e_x->scala_velocita = (t_update / periodo) * UNO_Q48;
+	e_x->scala_accelerazione = e_x->scala_velocita * t_update;
+	compila_configurazione_encoder(indice);
 
-/**
- * @brief Valuta e aggiorna lo stato dell'encoder basato sui segnali dei canali
- *  A e B
- *
- * @param e_x Puntatore alla struttura dell'encoder
- * @param statoA Stato logico del canale A
- * @param statoB Stato logico del canale B
- *
- * @details
- * Questa funzione determina lo stato dell'encoder basandosi sui segnali dei
- * canali A e B.
- * Aggiorna il conteggio dell'encoder quando viene rilevato un cambiamento di
- * stato valido.
- * Gli stati possibili sono: zero, uno, due, tre e incerto.
- *
- * @note
- * - Il conteggio viene incrementato solo quando lo stato cambia da uno stato
- * valido a un altro
- * - Lo stato 'incerto' è usato per gestire l'inizializzazione
- *
- * @see encoder
- */
-static void valuta_stato_encoder(encoder *e_x, bool statoA, bool statoB)
-{
+	apri_comandi_encoder();
 
-	if((statoA == false) && (statoB == false) && (e_x->stato != zero))
+	/* Conservo la velocità attuale in m/s, riportandola alla nuova scala */
+	if (scala_precedente > 0)
 	{
-		if(e_x->stato != incerto)
+		double_t fattore = e_x->scala_velocita / scala_precedente;
+
+		if ((casella_comandi.maschera_velocita & bit_encoder) != 0U)
 		{
-			e_x->conteggio++;
+			/* La velocità in attesa è espressa nella vecchia scala */
+			casella_comandi.velocita[indice] =
+					(int64_t) (((double_t) casella_comandi.velocita[indice]) *
+							   fattore);
+		}
+		else if ((casella_comandi.maschera_riscala & bit_encoder) != 0U)
+		{
+			casella_comandi.fattore_riscala[indice] =
+					casella_comandi.fattore_riscala[indice] * fattore;
 		}
 		else
 		{
-			/* Non succede niente, MISRA-2023-15.7 */
+			casella_comandi.fattore_riscala[indice] = fattore;
+			casella_comandi.maschera_riscala |= bit_encoder;
 		}
-		e_x->stato = zero;
 	}
-	else if((statoA == false) && (statoB == true) && (e_x->stato != uno))
+	else
+	{
+		/* Prima inizializzazione, MISRA-2023-15.7 */
+	}
+
+	converti_accelerazione(indice);
+
+	chiudi_comandi_encoder();
+}
+
+/**
+ * @brief Converte una grandezza fisica in un incremento Q16.48 saturato
+ *
+ * @param valore Grandezza da convertire (m/s oppure m/s^2)
+ * @param scala Fattore di conversione da applicare
+ * @param limite Valore assoluto massimo del risultato
+ * @return int64_t Incremento Q16.48 compreso in [-limite, limite]
+ *
+ * @details La saturazione avviene prima del cast, così anche valori
+ * anomali ricevuti da UART non producono un overflow dell'intero.
+ * L'arrotondamento è al più vicino: un troncamento verso zero darebbe a
+ * ogni tick un errore sempre dello stesso segno.
+ */
+static int64_t converti_in_q48(double_t valore, double_t scala,
+							   int64_t limite)
+{
+	double_t convertito = valore * scala;
+	int64_t risultato;
+
+	if (convertito > ((double_t) limite))
+	{
+		risultato = limite;
+	}
+	else if (convertito < -((double_t) limite))
 	{
-		if(e_x->stato != incerto)
+		risultato = -limite;
+	}
+	else
+	{
+		risultato = (int64_t) llround(convertito);
+	}
+
+	return risultato;
+}
+
+/**
+ * @brief Mette nella casella dei comandi l'accelerazione assegnata in acc
+ *
+ * @param indice Indice dell'encoder
+ *
+ * @details Va chiamata tra apri_comandi_encoder() e chiudi_comandi_encoder().
+ * Con tick di 4 us un'accelerazione di 0.3 m/s^2 vale circa 50 bit Q16.48 per
+ * tick^2: arrotondata all'intero sbaglierebbe la velocità fino all'1% e in
+ * un giorno la posizione di chilometri. La parte sotto il bit viene quindi
+ * conservata in frazione_accelerazione, con 32 bit in più di risoluzione.
+ */
+static void converti_accelerazione(uint8_t indice)
+{
+	const encoder *e_x = &parametri_encoder[indice];
+	double_t limite = (double_t) configurazione_attiva[indice]->incremento_max;
+	double_t convertito = e_x->acc * e_x->scala_accelerazione;
+	double_t intero;
+
+	if (convertito > limite)
+	{
+		convertito = limite;
+	}
+	else if (convertito < -limite)
+	{
+		convertito = -limite;
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+
+	intero = floor(convertito);
+	casella_in_scrittura->accelerazione[indice] = (int64_t) intero;
+	casella_in_scrittura->frazione_accelerazione[indice] =
+			(uint32_t) ((convertito - intero) * UNO_FRAZIONE_LSB);
+	casella_in_scrittura->maschera_accelerazione |= 1UL << indice;
+}
+
+/**
+ * @brief Conta i fronti di A e B che precedono una posizione di fase
+ *
+ * @param conf Blocco di configurazione con soglie e sfasamento
+ * @param fase Posizione nell'accumulatore di fase Q16.48
+ * @return uint16_t Numero di fronti modulo 2^16
+ *
+ * @details Ogni canale ha due fronti per periodo: A sale a frazione 0 e
+ * scende alla soglia di duty, B fa lo stesso spostato di sfasamento_B.
+ * Spostando la fase dell'opposto di ciascun fronte, la parte intera conta
+ * quante volte quel fronte è stato attraversato:
+ * @f[
+ *    N = \lfloor x \rfloor + \lfloor x - d_A \rfloor +
+ *        \lfloor x + s_B \rfloor + \lfloor x + s_B - d_B \rfloor
+ * @f]
+ * La differenza tra due chiamate, presa su 16 bit con segno, è il numero di
+ * fronti attraversati nell'intervallo, con il verso del movimento.
+ *
+ * @note I 16 bit bassi degli scostamenti sono nulli, quindi i fronti
+ * coincidono esattamente con i confronti a 32 bit di emula_encoder.
+ */
+FUNZIONE_OCM static uint16_t conta_fronti(const configurazione_tick *conf, uint64_t fase)
+{
+	uint64_t duty_A = ((uint64_t) conf->soglia_duty_A) << SHIFT_FRAZIONE;
+	uint64_t duty_B = ((uint64_t) conf->soglia_duty_B) << SHIFT_FRAZIONE;
+	uint64_t fase_B = fase + (((uint64_t) conf->sfasamento_B) <<
+							  SHIFT_FRAZIONE);
+
+	return (uint16_t) ((fase >> SHIFT_PERIODI) +
+					   ((fase - duty_A) >> SHIFT_PERIODI) +
+					   (fase_B >> SHIFT_PERIODI) +
+					   ((fase_B - duty_B) >> SHIFT_PERIODI));
+}
+#endif
+
+#if (SCHEDULAZIONE_ENCODER == SCHEDULAZIONE_EVENTI)
+/**
+ * @brief Porta lo stato di un encoder a un istante del timer globale
+ *
+ * @param indice Indice dell'encoder
+ * @param tempo Istante di arrivo, in conteggi del timer globale
+ *
+ * @details Integra in forma chiusa, in tick di supervisione:
+ * @f[
+ *    \Delta fase = v k + \frac{a k^2}{2} \qquad v' = v + a k
+ * @f]
+ * Se la velocità raggiunge incremento_max durante l'intervallo, il tratto
+ * successivo prosegue a velocità costante. I conti sono in double_t: con
+ * incrementi fino a 2^53 l'errore è sotto il bit meno significativo della
+ * fase.
+ */
+FUNZIONE_OCM static void avanza_encoder_a(uint8_t indice, uint64_t tempo)
+{
+	double_t k = ((double_t) (tempo - stato_tick.tempo_ultimo[indice])) /
+				 conteggi_per_tick;
+	double_t v = ((double_t) stato_tick.incremento_fase[indice]) +
+				 (((double_t) stato_tick.residuo_fase[indice]) / UNO_FRAZIONE_LSB);
+	double_t a = ((double_t) stato_tick.incremento_vel[indice]) +
+				 (((double_t) stato_tick.frazione_vel[indice]) / UNO_FRAZIONE_LSB);
+	double_t v_max = (double_t) configurazione_attiva[indice]->incremento_max;
+	double_t v_fine = v + (a * k);
+	double_t spazio;
+	double_t v_intero;
+
+	if ((v_fine > v_max) || (v_fine < -v_max))
+	{
+		double_t v_limite = (v_fine > 0) ? v_max : -v_max;
+		double_t k_saturazione = 0;
+
+		if (a != 0)
 		{
-			e_x->conteggio++;
+			k_saturazione = (v_limite - v) / a;
+		}
+		else
+		{
+			/* Già oltre il limite, MISRA-2023-15.7 */
+		}
+
+		if (k_saturazione < 0)
+		{
+			k_saturazione = 0;
 		}
 		else
 		{
 			/* Non succede niente, MISRA-2023-15.7 */
 		}
-		e_x->stato = uno;
+
+		spazio = (v * k_saturazione) +
+				 (0.5 * a * k_saturazione * k_saturazione) +
+				 (v_limite * (k - k_saturazione));
+		v_fine = v_limite;
 	}
-	else if((statoA == true) && (statoB == false) && (e_x->stato != due))
+	else
+	{
+		spazio = (v * k) + (0.5 * a * k * k);
+	}
+
+	/* Arrotondo al più vicino, senza errore sistematico tra un evento e l'altro */
+	stato_tick.accumulatore_fase[indice] = stato_tick.accumulatore_fase[indice] +
+										   ((uint64_t) llround(spazio));
+	v_intero = floor(v_fine);
+	stato_tick.incremento_fase[indice] = (int64_t) v_intero;
+	stato_tick.residuo_fase[indice] =
+			(uint32_t) ((v_fine - v_intero) * UNO_FRAZIONE_LSB);
+	stato_tick.tempo_ultimo[indice] = tempo;
+}
+
+/**
+ * @brief Calcola la distanza di fase dal prossimo fronte di A o B
+ *
+ * @param conf Blocco di configurazione con soglie e sfasamento
+ * @param fase Posizione nell'accumulatore di fase Q16.48
+ * @param avanti Verso del movimento
+ * @return uint64_t Distanza Q16.48 dal fronte più vicino, mai nulla
+ *
+ * @details Usa gli stessi scostamenti di conta_fronti(): il fronte j cade
+ * dove (fase + c_j) è multiplo di un periodo. In avanti si arriva al
+ * multiplo successivo, all'indietro si deve scendere sotto il multiplo
+ * corrente, quindi serve un bit in più.
+ */
+FUNZIONE_OCM static uint64_t distanza_fronte(const configurazione_tick *conf,
+								uint64_t fase, bool avanti)
+{
+	uint64_t sfasamento = ((uint64_t) conf->sfasamento_B) << SHIFT_FRAZIONE;
+	uint64_t scostamenti[4];
+	uint64_t distanza_minima = MASCHERA_PERIODO + 1ULL;
+
+	scostamenti[0] = 0;
+	scostamenti[1] = 0ULL - (((uint64_t) conf->soglia_duty_A) << SHIFT_FRAZIONE);
+	scostamenti[2] = sfasamento;
+	scostamenti[3] = sfasamento -
+					 (((uint64_t) conf->soglia_duty_B) << SHIFT_FRAZIONE);
+
+	for (uint8_t fronte = 0; fronte < 4U; fronte++)
 	{
-		if(e_x->stato != incerto)
+		uint64_t resto = (fase + scostamenti[fronte]) & MASCHERA_PERIODO;
+		uint64_t distanza = (avanti == true) ?
+							((MASCHERA_PERIODO + 1ULL) - resto) : (resto + 1ULL);
+
+		if (distanza < distanza_minima)
 		{
-			e_x->conteggio++;
+			distanza_minima = distanza;
 		}
 		else
 		{
 			/* Non succede niente, MISRA-2023-15.7 */
 		}
-		e_x->stato = due;
 	}
-	else if((statoA == true) && (statoB == true) && (e_x->stato != tre))
+
+	return distanza_minima;
+}
+
+/**
+ * @brief Calcola il tempo del prossimo fronte di un encoder e lo mette in
+ * coda
+ *
+ * @param indice Indice dell'encoder, già portato a tempo_ultimo
+ *
+ * @details Risolve la distanza dal prossimo fronte con velocità e
+ * accelerazione correnti, nella forma stabile
+ * @f[
+ *    k = \frac{2 d}{v + \sqrt{v^2 + 2 a d}}
+ * @f]
+ * arrotondando per eccesso ai conteggi del timer globale. Se l'encoder è
+ * fermo, si ferma prima del fronte o il fronte è oltre ORIZZONTE_TICK, mette
+ * in coda solo una ripianificazione (al più all'istante di arresto).
+ */
+FUNZIONE_OCM static void pianifica_fronte_encoder(uint8_t indice)
+{
+	double_t v = (double_t) stato_tick.incremento_fase[indice];
+	double_t a = ((double_t) stato_tick.incremento_vel[indice]) +
+				 (((double_t) stato_tick.frazione_vel[indice]) / UNO_FRAZIONE_LSB);
+	double_t k_evento = ORIZZONTE_TICK;
+	bool avanti = (v > 0) || ((v == 0) && (a > 0));
+	bool fronte = false;
+
+	if ((v != 0) || (a != 0))
 	{
-		if(e_x->stato != incerto)
+		uint64_t distanza = distanza_fronte(configurazione_attiva[indice],
+											stato_tick.accumulatore_fase[indice],
+											avanti);
+		double_t d = (double_t) distanza;
+		double_t v_verso = (avanti == true) ? v : -v;
+		double_t a_verso = (avanti == true) ? a : -a;
+		double_t discriminante = (v_verso * v_verso) + (2 * a_verso * d);
+
+		if (discriminante >= 0)
 		{
-			e_x->conteggio++;
+			double_t k = (2 * d) / (v_verso + sqrt(discriminante));
+
+			if (k < k_evento)
+			{
+				k_evento = k;
+				fronte = true;
+				stato_tick.fase_fronte[indice] = (avanti == true) ?
+						(stato_tick.accumulatore_fase[indice] + distanza) :
+						(stato_tick.accumulatore_fase[indice] - distanza);
+				stato_tick.fronte_avanti[indice] = avanti;
+			}
+			else
+			{
+				/* Fronte oltre l'orizzonte, MISRA-2023-15.7 */
+			}
 		}
 		else
 		{
-			/* Non succede niente, MISRA-2023-15.7 */
+			/* Inverte il moto prima del fronte: ripianifico all'arresto */
+			double_t k_arresto = -v_verso / a_verso;
+
+			if (k_arresto < k_evento)
+			{
+				k_evento = k_arresto;
+			}
+			else
+			{
+				/* Non succede niente, MISRA-2023-15.7 */
+			}
 		}
-		e_x->stato = tre;
 	}
 	else
 	{
-		/* Non succede niente, MISRA-2023-15.7 */
+		/* Encoder fermo, MISRA-2023-15.7 */
 	}
 
+	stato_tick.fronte_programmato[indice] = fronte;
+	aggiorna_evento(&coda_fronti, indice, stato_tick.tempo_ultimo[indice] +
+					(uint64_t) ceil(k_evento * conteggi_per_tick));
+}
+#endif
+
+/**
+ * @brief Compila le soglie di un encoder e le pubblica al side loop
+ *
+ * @param indice Indice dell'encoder
+ *
+ * @details Va chiamata ogni volta che cambiano l_passo, duty cycle o fase.
+ * Scrive il blocco di configurazione inattivo dell'encoder e poi lo rende
+ * attivo cambiando configurazione_attiva, così il side loop esegue solo
+ * confronti su valori già pronti.
+ *
+ * @note L'interrupt può interrompere la compilazione ma non il contrario,
+ * quindi il blocco inattivo non è mai letto mentre viene scritto. La barriera
+ * garantisce che il blocco sia completo prima di pubblicare il puntatore.
+ *
+ * @see configurazione_tick, configurazione_attiva
+ */
+static void compila_configurazione_encoder(uint8_t indice)
+{
+	const encoder *e_x = &parametri_encoder[indice];
+	configurazione_tick *blocco =
+			(configurazione_attiva[indice] == &blocchi_configurazione[indice][0]) ?
+			&blocchi_configurazione[indice][1] : &blocchi_configurazione[indice][0];
+
+#if (MOTORE_ENCODER == MOTORE_ENCODER_PUNTO_FISSO)
+	int32_t fase_normalizzata = ((e_x->fase % 360) + 360) % 360;
+	uint64_t frazione_fase;
+
+	blocco->incremento_max = (int64_t) (VELOCITA_MAX * e_x->scala_velocita);
+
+	/* Duty% * periodo, saturato a 32 bit per duty = 100% */
+	if (e_x->duty_A >= 100U)
+	{
+		blocco->soglia_duty_A = UINT32_MAX;
+	}
+	else
+	{
+		blocco->soglia_duty_A =
+				(uint32_t) ((((uint64_t) e_x->duty_A) << 32U) / 100U);
+	}
+
+	if (e_x->duty_B >= 100U)
+	{
+		blocco->soglia_duty_B = UINT32_MAX;
+	}
+	else
+	{
+		blocco->soglia_duty_B =
+				(uint32_t) ((((uint64_t) e_x->duty_B) << 32U) / 100U);
+	}
+
+	/*
+	 * Il canale B è in ritardo di fase/360 periodi rispetto ad A, come nel
+	 * modello in virgola mobile (k_fase = -fase/360)
+	 */
+	frazione_fase = (((uint64_t) fase_normalizzata) << 32U) / 360U;
+	blocco->sfasamento_B = 0U - ((uint32_t) frazione_fase);
+	blocco->quadratura_invertita = (fase_normalizzata > 180);
+#else
+	/* Porto i duty cycle da percentuale intera a decimale */
+	float_t k_dutyA = ((float_t) e_x->duty_A) * 0.01;
+	float_t k_dutyB = ((float_t) e_x->duty_B) * 0.01;
+
+	/*
+	 * Estrapolo il fattore di sfasamento, cioè converto i gradi nella
+	 * quantità di spazio da cui il canale B si discosta dal canale A
+	 */
+	float_t k_fase = ((float_t) - (e_x->fase) / 360);
+
+	blocco->periodo = 2 * e_x->l_passo; /* 2passi */
+	blocco->sfasamento_B = blocco->periodo * k_fase;
+	blocco->b_in_ritardo = (k_fase <= 0);
+	/* Duty% * 2passi */
+	blocco->soglia_pos_A = k_dutyA * blocco->periodo;
+	blocco->soglia_pos_B = k_dutyB * blocco->periodo;
+	/* (1-Duty%) * -2passi */
+	blocco->soglia_neg_A = (1 - k_dutyA) * (-blocco->periodo);
+	blocco->soglia_neg_B = (1 - k_dutyB) * (-blocco->periodo);
+#endif
+
+	dmb();
+	configurazione_attiva[indice] = blocco;
+}
+
+/**
+ * @brief Applica al side loop i comandi di una casella e la svuota
+ *
+ * @param casella Casella dei comandi immediati o di un gruppo programmato
+ */
+FUNZIONE_OCM static void applica_casella_encoder(casella_comandi_encoder *casella)
+{
+	uint32_t maschere = casella->maschera_velocita |
+						casella->maschera_accelerazione;
+
+#if (MOTORE_ENCODER == MOTORE_ENCODER_PUNTO_FISSO)
+	maschere |= casella->maschera_riscala;
+#endif
+
+	if (maschere != 0U)
+	{
+		for (uint8_t indice = 0; indice < N_ENCODER; indice++)
+		{
+			uint32_t bit_encoder = 1UL << indice;
+
+#if (MOTORE_ENCODER == MOTORE_ENCODER_PUNTO_FISSO)
+			if ((casella->maschera_riscala & bit_encoder) != 0U)
+			{
+				stato_tick.incremento_fase[indice] = (int64_t)
+						(((double_t) stato_tick.incremento_fase[indice]) *
+						 casella->fattore_riscala[indice]);
+			}
+			else
+			{
+				/* Non succede niente, MISRA-2023-15.7 */
+			}
+
+			if ((casella->maschera_velocita & bit_encoder) != 0U)
+			{
+				stato_tick.incremento_fase[indice] =
+						casella->velocita[indice];
+				stato_tick.residuo_fase[indice] = 0;
+			}
+			else
+			{
+				/* Non succede niente, MISRA-2023-15.7 */
+			}
+
+			if ((casella->maschera_accelerazione & bit_encoder) != 0U)
+			{
+				stato_tick.incremento_vel[indice] =
+						casella->accelerazione[indice];
+				stato_tick.frazione_vel[indice] =
+						casella->frazione_accelerazione[indice];
+			}
+			else
+			{
+				/* Non succede niente, MISRA-2023-15.7 */
+			}
+#else
+			if ((casella->maschera_velocita & bit_encoder) != 0U)
+			{
+				stato_tick.vel[indice] = casella->velocita[indice];
+			}
+			else
+			{
+				/* Non succede niente, MISRA-2023-15.7 */
+			}
+
+			if ((casella->maschera_accelerazione & bit_encoder) != 0U)
+			{
+				stato_tick.acc[indice] = casella->accelerazione[indice];
+			}
+			else
+			{
+				/* Non succede niente, MISRA-2023-15.7 */
+			}
+#endif
+		}
+
+		casella->maschera_velocita = 0;
+		casella->maschera_accelerazione = 0;
+#if (MOTORE_ENCODER == MOTORE_ENCODER_PUNTO_FISSO)
+		casella->maschera_riscala = 0;
+#endif
+	}
+	else
+	{
+		/* Nessun comando, MISRA-2023-15.7 */
+	}
+}
+
+/**
+ * @brief Applica al side loop i comandi in attesa nella casella
+ *
+ * @details Va chiamata all'inizio del tick, prima dell'integrazione, così
+ * tutti i comandi di un telegramma hanno effetto sullo stesso tick. Se il
+ * main loop è stato interrotto a metà di una scrittura (sequenza dispari) i
+ * comandi restano in attesa fino al tick successivo.
+ *
+ * @note Il main loop non può interrompere il side loop, quindi non serve
+ * rileggere la sequenza dopo la copia come in un seqlock tra due core.
+ *
+ * @see casella_comandi_encoder, apri_comandi_encoder, chiudi_comandi_encoder
+ */
+FUNZIONE_OCM static void applica_comandi_encoder(void)
+{
+	if ((casella_comandi.sequenza & 1U) == 0U)
+	{
+		applica_casella_encoder(&casella_comandi);
+	}
+	else
+	{
+		/* Scrittura in corso, MISRA-2023-15.7 */
+	}
+}
+
+/**
+ * @brief Applica i gruppi programmati dovuti entro il tick corrente
+ *
+ * @details Va chiamata subito dopo applica_comandi_encoder(). Il tick
+ * corrente è l'ultimo contato da esegui_task_tick(), che nel side loop
+ * viene prima degli encoder. Un gruppo applicato viene tolto dalla testa
+ * della coda.
+ */
+FUNZIONE_OCM static void applica_comandi_programmati(void)
+{
+	uint32_t ora = ritorna_tick_corrente() - 1U;
+	uint8_t n = n_programmati;
+
+	while ((n > 0U) && (((int32_t) (ora - coda_programmati[0].tick)) >= 0))
+	{
+		applica_casella_encoder(&coda_programmati[0].comandi);
+
+		for (uint8_t posizione = 1U; posizione < n; posizione++)
+		{
+			coda_programmati[posizione - 1U] = coda_programmati[posizione];
+		}
+		n--;
+	}
+
+	n_programmati = n;
+}
+
+/**
+ * @brief Valuta e aggiorna lo stato dell'encoder basato sui segnali dei canali
+ *  A e B
+ *
+ * @param indice Indice dell'encoder
+ * @param statoA Stato logico del canale A
+ * @param statoB Stato logico del canale B
+ *
+ * @details
+ * Questa funzione determina lo stato dell'encoder basandosi sui segnali dei
+ * canali A e B e aggiorna il conteggio con segno, senza salti dipendenti dai
+ * dati: lo stato precedente e i due livelli indicizzano delta_quadratura e
+ * transizione_illegale.
+ * Gli stati possibili sono: zero, uno, due, tre e incerto.
+ *
+ * @note
+ * - Il conteggio cresce con la velocità positiva (B in ritardo su A) e cala
+ * con quella negativa
+ * - Un cambio contemporaneo di A e B non ha un verso definito: non modifica
+ * il conteggio e viene sommato in transizioni_illegali
+ * - Lo stato 'incerto' è usato per gestire l'inizializzazione
+ * - Su host costa circa metà della vecchia catena di if/else, che sbaglia
+ * la previsione dei salti a ogni fronte; non ancora misurato sul target
+ *
+ * @see stato_tick_encoder, delta_quadratura, transizione_illegale
+ */
+FUNZIONE_OCM static void valuta_stato_encoder(uint8_t indice, bool statoA, bool statoB)
+{
+	uint32_t stato_nuovo = (((uint32_t) statoA) << 1U) | ((uint32_t) statoB);
+	uint32_t transizione = (((uint32_t) stato_tick.stato[indice]) << 2U) |
+						   stato_nuovo;
+
+	stato_tick.conteggio[indice] = (int16_t) (stato_tick.conteggio[indice] +
+									delta_quadratura[transizione]);
+	stato_tick.conteggio_totale[indice] = stato_tick.conteggio_totale[indice] +
+										  delta_quadratura[transizione];
+	stato_tick.transizioni_illegali[indice] =
+			stato_tick.transizioni_illegali[indice] +
+			transizione_illegale[transizione];
+	stato_tick.stato[indice] = (stato_encoder) stato_nuovo;
 }
 
 
@@ -572,31 +1728,227 @@ static void valuta_stato_encoder(encoder *e_x, bool statoA, bool statoB)
 
 void inizializza_variabili_encoder()
 {
-	t_update = ritorna_tempo_del_polling();
+	t_update = ((double_t) ritorna_conteggi_tick()) /
+			   ((double_t) COUNTS_PER_SECOND);
 
-	/* Inizializzo variabili */
-	inizializza_encoder(&e_1);
-	inizializza_encoder(&e_2);
+	/* Un nuovo test riparte dal tick nominale */
+	richiedi_tick_nominale();
 
-	/* Inizializzo gpio */
-	XGpio_Initialize(&e_1.indirizzo_gpio_A, XPAR_AXI_GPIO_E1_A_DEVICE_ID);
-	XGpio_Initialize(&e_1.indirizzo_gpio_B, XPAR_AXI_GPIO_E1_B_DEVICE_ID);
-	XGpio_Initialize(&e_2.indirizzo_gpio_A, XPAR_AXI_GPIO_E2_A_DEVICE_ID);
-	XGpio_Initialize(&e_2.indirizzo_gpio_B, XPAR_AXI_GPIO_E2_B_DEVICE_ID);
+	/*
+	 * Chiudo anche una scrittura rimasta aperta, per esempio un gruppo di
+	 * CPU1 di cui si è persa la chiusura
+	 */
+	casella_in_scrittura = &casella_comandi;
+	profondita_comandi = 0;
+	if ((casella_comandi.sequenza & 1U) != 0U)
+	{
+		casella_comandi.sequenza = casella_comandi.sequenza + 1U;
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+
+	/* Scarto i comandi non ancora applicati */
+	apri_comandi_encoder();
+	casella_comandi.maschera_velocita = 0;
+	casella_comandi.maschera_accelerazione = 0;
+#if (MOTORE_ENCODER == MOTORE_ENCODER_PUNTO_FISSO)
+	casella_comandi.maschera_riscala = 0;
+#endif
+	chiudi_comandi_encoder();
+	n_programmati = 0;
+
+	for (uint8_t indice = 0; indice < N_ENCODER; indice++)
+	{
+		/* Inizializzo variabili */
+		inizializza_encoder(indice);
+	}
+
+#if (SCHEDULAZIONE_ENCODER == SCHEDULAZIONE_EVENTI)
+	XTime adesso;
+	u32 cpsr = mfcpsr();
+
+	/*
+	 * Il comparatore e il tick estraggono dalla coda dei fronti: la
+	 * ricostruisco con entrambi gli interrupt mascherati
+	 */
+	mtcpsr(cpsr | XIL_EXCEPTION_IRQ);
+	ferma_comparatore_globale();
+	XTime_GetTime(&adesso);
+	conteggi_per_tick = (double_t) ritorna_conteggi_tick();
+	for (uint8_t indice = 0; indice < N_ENCODER; indice++)
+	{
+		stato_tick.tempo_ultimo[indice] = adesso;
+		stato_tick.fronte_programmato[indice] = false;
+	}
+	inizializza_coda_eventi(&coda_fronti, N_ENCODER, adesso);
+	mtcpsr(cpsr);
+#if (MISURA_CICLI_ENCODER == 1U)
+	reset_statistica_cicli(&cicli_eventi);
+#endif
+#endif
+
+	/* Configuro e resetto i gpio presenti nel design */
+	inizializza_uscite_gpio();
+}
+
+void aggiorna_tempo_encoder(void)
+{
+	t_update = ((double_t) ritorna_conteggi_tick()) /
+			   ((double_t) COUNTS_PER_SECOND);
+
+#if (SCHEDULAZIONE_ENCODER == SCHEDULAZIONE_EVENTI)
+	conteggi_per_tick = (double_t) ritorna_conteggi_tick();
+#endif
+
+#if (MOTORE_ENCODER == MOTORE_ENCODER_PUNTO_FISSO)
+	for (uint8_t indice = 0; indice < N_ENCODER; indice++)
+	{
+		aggiorna_scale_punto_fisso(indice);
+	}
+#endif
+}
+
+#if (SCHEDULAZIONE_ENCODER == SCHEDULAZIONE_EVENTI)
+FUNZIONE_OCM void aggiorna_variabili_encoder(uint32_t n_tick)
+{
+	bool stato_connessione_app = ritorna_stato_connessione_app();
+
+	/* Il tempo trascorso viene letto dal timer globale */
+	(void) n_tick;
+
+	if(stato_connessione_app == true)
+	{
+		XTime adesso;
+
+		/* Porto tutti gli encoder ad ora con i comandi precedenti */
+		XTime_GetTime(&adesso);
+		for (uint8_t indice = 0; indice < N_ENCODER; indice++)
+		{
+			avanza_encoder_a(indice, adesso);
+		}
+	}
+	else
+	{
+		/* Non succede niente */
+	}
+
+	/* Confine del tick: applico i comandi arrivati dal main loop */
+	applica_comandi_encoder();
+	applica_comandi_programmati();
+}
+
+FUNZIONE_OCM void emula_sensori_encoder()
+{
+	bool stato_connessione_app = ritorna_stato_connessione_app();
+
+	if(stato_connessione_app == true)
+	{
+		for (uint8_t indice = 0; indice < N_ENCODER; indice++)
+		{
+			emula_encoder(indice);
+		}
+		scrivi_uscite_gpio();
 
-	/* Reset gpio */
-	reset_gpio(&e_1);
-	reset_gpio(&e_2);
+		/* I comandi possono aver cambiato velocità: ripianifico tutto */
+		for (uint8_t indice = 0; indice < N_ENCODER; indice++)
+		{
+			pianifica_fronte_encoder(indice);
+		}
+		programma_comparatore_globale(ritorna_tempo_primo_evento(&coda_fronti));
+	}
+	else
+	{
+		ferma_comparatore_globale();
+	}
 }
 
-void aggiorna_variabili_encoder()
+FUNZIONE_OCM void gestore_eventi_encoder(void *riferimento)
+{
+	bool stato_connessione_app = ritorna_stato_connessione_app();
+	uint32_t n_eventi = 0;
+	XTime adesso;
+
+#if (MISURA_CICLI_ENCODER == 1U)
+	u32 cicli_inizio = leggi_contatore_cicli();
+#endif
+
+	pulisci_comparatore_globale();
+
+	if(stato_connessione_app == true)
+	{
+		XTime_GetTime(&adesso);
+
+		/* Emetto tutti gli eventi già dovuti, in ordine di tempo */
+		while ((((int64_t) (ritorna_tempo_primo_evento(&coda_fronti) - adesso))
+				<= 0) && (n_eventi < EVENTI_PER_IRQ_MAX))
+		{
+			uint8_t indice = ritorna_primo_evento(&coda_fronti);
+
+			avanza_encoder_a(indice, ritorna_tempo_primo_evento(&coda_fronti));
+
+			if (stato_tick.fronte_programmato[indice] == true)
+			{
+				/*
+				 * L'arrotondamento può lasciare la fase appena prima del
+				 * fronte: la porto esattamente sul fronte
+				 */
+				int64_t mancante = (int64_t) (stato_tick.fase_fronte[indice] -
+									stato_tick.accumulatore_fase[indice]);
+
+				if (((stato_tick.fronte_avanti[indice] == true) &&
+					 (mancante > 0)) ||
+					((stato_tick.fronte_avanti[indice] == false) &&
+					 (mancante < 0)))
+				{
+					stato_tick.accumulatore_fase[indice] =
+							stato_tick.fase_fronte[indice];
+				}
+				else
+				{
+					/* Fronte già raggiunto, MISRA-2023-15.7 */
+				}
+
+				emula_encoder(indice);
+			}
+			else
+			{
+				/* Sola ripianificazione, MISRA-2023-15.7 */
+			}
+
+			pianifica_fronte_encoder(indice);
+			n_eventi++;
+		}
+
+		scrivi_uscite_gpio();
+		programma_comparatore_globale(ritorna_tempo_primo_evento(&coda_fronti));
+	}
+	else
+	{
+		ferma_comparatore_globale();
+	}
+
+#if (MISURA_CICLI_ENCODER == 1U)
+	aggiorna_statistica_cicli(&cicli_eventi,
+							  leggi_contatore_cicli() - cicli_inizio);
+#endif
+}
+#else
+FUNZIONE_OCM void aggiorna_variabili_encoder(uint32_t n_tick)
 {
 	bool stato_connessione_app = ritorna_stato_connessione_app();
 
+	/* Confine del tick: applico i comandi arrivati dal main loop */
+	applica_comandi_encoder();
+	applica_comandi_programmati();
+
 	if(stato_connessione_app == true)
 	{
-		aggiorna_encoder(&e_1);
-		aggiorna_encoder(&e_2);
+		for (uint8_t indice = 0; indice < N_ENCODER; indice++)
+		{
+			aggiorna_encoder(indice, n_tick);
+		}
 	}
 	else
 	{
@@ -604,95 +1956,327 @@ void aggiorna_variabili_encoder()
 	}
 }
 
-void emula_sensori_encoder()
+FUNZIONE_OCM void emula_sensori_encoder()
 {
 	bool stato_connessione_app = ritorna_stato_connessione_app();
 
 	if(stato_connessione_app == true)
 	{
-		emula_encoder(&e_1);
-		emula_encoder(&e_2);
+		for (uint8_t indice = 0; indice < N_ENCODER; indice++)
+		{
+			emula_encoder(indice);
+		}
+
+		/* Un solo passaggio sul bus per tutti i canali cambiati */
+		scrivi_uscite_gpio();
 	}
 	else
 	{
 		/* Non succede niente */
 	}
 }
+#endif
 
-void reset_conteggi_encoder()
+FUNZIONE_OCM void reset_conteggi_encoder()
 {
-	e_1.conteggio = 0;
-	e_2.conteggio = 0;
+	for (uint8_t indice = 0; indice < N_ENCODER; indice++)
+	{
+		stato_tick.conteggio[indice] = 0;
+	}
 }
 
-double_t ritorna_velocita_encoder1()
+double_t ritorna_velocita_encoder(uint8_t indice)
 {
-	return e_1.vel;
+	double_t vel = 0;
+
+	if (indice < N_ENCODER)
+	{
+#if (MOTORE_ENCODER == MOTORE_ENCODER_PUNTO_FISSO)
+		vel = ((double_t) stato_tick.incremento_fase[indice]) /
+			  parametri_encoder[indice].scala_velocita;
+#else
+		vel = stato_tick.vel[indice];
+#endif
+	}
+	else
+	{
+		/* Indice non valido, MISRA-2023-15.7 */
+	}
+
+	return vel;
 }
 
-double_t ritorna_velocita_encoder2()
+int16_t ritorna_conteggio_encoder(uint8_t indice)
 {
-	return e_2.vel;
+	int16_t conteggio = 0;
+
+	if (indice < N_ENCODER)
+	{
+		conteggio = stato_tick.conteggio[indice];
+	}
+	else
+	{
+		/* Indice non valido, MISRA-2023-15.7 */
+	}
+
+	return conteggio;
 }
 
-uint16_t ritorna_conteggio_encoder1()
+int64_t ritorna_conteggio_totale_encoder(uint8_t indice)
 {
-	return e_1.conteggio;
+	int64_t conteggio = 0;
+
+	if (indice < N_ENCODER)
+	{
+		conteggio = stato_tick.conteggio_totale[indice];
+	}
+	else
+	{
+		/* Indice non valido, MISRA-2023-15.7 */
+	}
+
+	return conteggio;
 }
 
-uint16_t ritorna_conteggio_encoder2()
+uint32_t ritorna_transizioni_illegali_encoder(uint8_t indice)
 {
-	return e_2.conteggio;
+	uint32_t transizioni = 0;
+
+	if (indice < N_ENCODER)
+	{
+		transizioni = stato_tick.transizioni_illegali[indice];
+	}
+	else
+	{
+		/* Indice non valido, MISRA-2023-15.7 */
+	}
+
+	return transizioni;
 }
 
-void assegna_ppr_encoder1(uint16_t ppr)
+uint32_t ritorna_fronti_compensati_encoder(uint8_t indice)
 {
-	e_1.ppr = ppr;
+	uint32_t fronti = 0;
+
+	if (indice < N_ENCODER)
+	{
+		fronti = stato_tick.fronti_compensati[indice];
+	}
+	else
+	{
+		/* Indice non valido, MISRA-2023-15.7 */
+	}
+
+	return fronti;
 }
 
-void assegna_ppr_encoder2(uint16_t ppr)
+void assegna_ppr_encoder(uint8_t indice, uint16_t ppr)
 {
-	e_2.ppr = ppr;
+	if (indice < N_ENCODER)
+	{
+		parametri_encoder[indice].ppr = ppr;
+	}
+	else
+	{
+		/* Indice non valido, MISRA-2023-15.7 */
+	}
 }
 
 void assegna_diametro_ruota(float_t diametro)
 {
-	e_1.diametro = diametro;
-	e_2.diametro = diametro;
+	for (uint8_t indice = 0; indice < N_ENCODER; indice++)
+	{
+		parametri_encoder[indice].diametro = diametro;
+	}
 }
 
-void assegna_velocita_encoder1(float_t vel)
+void assegna_velocita_encoder(uint8_t indice, float_t vel)
 {
-	e_1.vel = ((double_t) vel);
+	if (indice < N_ENCODER)
+	{
+		uint32_t bit_encoder = 1UL << indice;
+
+		apri_comandi_encoder();
+#if (MOTORE_ENCODER == MOTORE_ENCODER_PUNTO_FISSO)
+		casella_in_scrittura->velocita[indice] =
+				converti_in_q48((double_t) vel,
+								parametri_encoder[indice].scala_velocita,
+								configurazione_attiva[indice]->incremento_max);
+
+		/* La nuova velocità sostituisce una riscalatura in attesa */
+		casella_in_scrittura->maschera_riscala &= ~bit_encoder;
+#else
+		casella_in_scrittura->velocita[indice] = ((double_t) vel);
+#endif
+		casella_in_scrittura->maschera_velocita |= bit_encoder;
+		chiudi_comandi_encoder();
+	}
+	else
+	{
+		/* Indice non valido, MISRA-2023-15.7 */
+	}
+}
+
+void assegna_accelerazione_encoder(uint8_t indice, float_t acc)
+{
+	if (indice < N_ENCODER)
+	{
+		encoder *e_x = &parametri_encoder[indice];
+
+		e_x->acc = ((double_t) acc);
+
+		apri_comandi_encoder();
+#if (MOTORE_ENCODER == MOTORE_ENCODER_PUNTO_FISSO)
+		converti_accelerazione(indice);
+#else
+		casella_in_scrittura->accelerazione[indice] = e_x->acc;
+		casella_in_scrittura->maschera_accelerazione |= 1UL << indice;
+#endif
+		chiudi_comandi_encoder();
+	}
+	else
+	{
+		/* Indice non valido, MISRA-2023-15.7 */
+	}
+}
+
+void apri_comandi_encoder(void)
+{
+	profondita_comandi++;
+
+	if (profondita_comandi == 1U)
+	{
+		/* Sequenza dispari: il side loop non legge la casella */
+		casella_comandi.sequenza = casella_comandi.sequenza + 1U;
+		dmb();
+	}
+	else
+	{
+		/* Scrittura già aperta, MISRA-2023-15.7 */
+	}
 }
 
-void assegna_velocita_encoder2(float_t vel)
+void chiudi_comandi_encoder(void)
 {
-	e_2.vel = ((double_t) vel);
+	if (profondita_comandi > 0U)
+	{
+		profondita_comandi--;
+
+		if (profondita_comandi == 0U)
+		{
+			/* I comandi sono completi prima di tornare a sequenza pari */
+			dmb();
+			casella_comandi.sequenza = casella_comandi.sequenza + 1U;
+		}
+		else
+		{
+			/* Scrittura esterna ancora aperta, MISRA-2023-15.7 */
+		}
+	}
+	else
+	{
+		/* Chiusura senza apertura, MISRA-2023-15.7 */
+	}
 }
 
-void assegna_accelerazione_encoder1(float_t acc)
+bool apri_comandi_programmati(uint32_t tick)
 {
-	e_1.acc = ((double_t) acc);
+	bool aperto = false;
+
+	if ((profondita_comandi == 0U) && (n_programmati < N_COMANDI_PROGRAMMATI))
+	{
+		gruppo_in_scrittura.tick = tick;
+		gruppo_in_scrittura.comandi.maschera_velocita = 0;
+		gruppo_in_scrittura.comandi.maschera_accelerazione = 0;
+#if (MOTORE_ENCODER == MOTORE_ENCODER_PUNTO_FISSO)
+		gruppo_in_scrittura.comandi.maschera_riscala = 0;
+#endif
+
+		/* Le apri_comandi_encoder() annidate non toccano la sequenza */
+		casella_in_scrittura = &gruppo_in_scrittura.comandi;
+		profondita_comandi = 1U;
+		aperto = true;
+	}
+	else if (profondita_comandi == 0U)
+	{
+		programmati_scartati++;
+	}
+	else
+	{
+		/* Scrittura già aperta, MISRA-2023-15.7 */
+	}
+
+	return aperto;
 }
 
-void assegna_accelerazione_encoder2(float_t acc)
+void chiudi_comandi_programmati(void)
 {
-	e_2.acc = ((double_t) acc);
+	if (casella_in_scrittura == &gruppo_in_scrittura.comandi)
+	{
+		u32 cpsr = mfcpsr();
+		uint8_t n;
+		uint8_t posizione;
+
+		casella_in_scrittura = &casella_comandi;
+		profondita_comandi = 0;
+
+		mtcpsr(cpsr | XIL_EXCEPTION_IRQ);
+
+		n = n_programmati;
+		if (n < N_COMANDI_PROGRAMMATI)
+		{
+			/* Dopo i gruppi dello stesso tick: restano in ordine di arrivo */
+			posizione = n;
+			while ((posizione > 0U) &&
+				   (((int32_t) (coda_programmati[posizione - 1U].tick -
+								gruppo_in_scrittura.tick)) > 0))
+			{
+				coda_programmati[posizione] = coda_programmati[posizione - 1U];
+				posizione--;
+			}
+
+			coda_programmati[posizione] = gruppo_in_scrittura;
+			n_programmati = n + 1U;
+		}
+		else
+		{
+			programmati_scartati++;
+		}
+
+		mtcpsr(cpsr);
+	}
+	else
+	{
+		/* Nessun gruppo aperto, MISRA-2023-15.7 */
+	}
 }
 
-void aggiorna_passo_encoder1(void)
+uint32_t ritorna_comandi_programmati_scartati(void)
 {
-	double_t numeratore = ((double_t) e_1.diametro) * PI_GRECO;
-	double_t denominatore = ((double_t) e_1.ppr) * 2;
-	e_1.l_passo = numeratore / denominatore;
+	return programmati_scartati;
 }
 
-void aggiorna_passo_encoder2(void)
+void aggiorna_passo_encoder(uint8_t indice)
 {
-	double_t numeratore = ((double_t) e_2.diametro) * PI_GRECO;
-	double_t denominatore = ((double_t) e_2.ppr) * 2;
-	e_2.l_passo = numeratore / denominatore;
+	if (indice < N_ENCODER)
+	{
+		encoder *e_x = &parametri_encoder[indice];
+		double_t numeratore = ((double_t) e_x->diametro) * PI_GRECO;
+		double_t denominatore = ((double_t) e_x->ppr) * 2;
+		e_x->l_passo = numeratore / denominatore;
+#if (MOTORE_ENCODER == MOTORE_ENCODER_PUNTO_FISSO)
+		aggiorna_scale_punto_fisso(indice);
+#else
+		compila_configurazione_encoder(indice);
+#endif
+	}
+	else
+	{
+		/* Indice non valido, MISRA-2023-15.7 */
+	}
 }
 
+#endif
+
+
 /****************** (C) COPYRIGHT GITSIM ***** END OF FILE *******************/
@@ -0,0 +1,244 @@
+/**
+ ******************************************************************************
+ * @file    gestione_gpio.c
+ * @author  Saimon Collaku
+ ******************************************************************************
+ */
+
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "gestione_gpio.h"
+#include "xgpio_l.h"
+#include "xparameters.h"
+#include "sezioni_ocm.h"
+
+/* Nella CPU0 della build AMP i GPIO degli encoder sono di CPU1 */
+#if (RUOLO_CORE != RUOLO_CORE_PROTOCOLLO)
+
+
+/******************************************************************************
+ * PRIVATE MACROS AND DEFINES
+ *****************************************************************************/
+
+/** @brief Indirizzo fittizio per gli encoder senza GPIO nel design hardware */
+#define GPIO_NON_PRESENTE		0U
+
+/** @brief Bit del canale A dell'encoder indicato nell'immagine delle uscite */
+#define BIT_CANALE_A(indice)	(1UL << (2U * (indice)))
+
+/** @brief Bit del canale B dell'encoder indicato nell'immagine delle uscite */
+#define BIT_CANALE_B(indice)	(1UL << ((2U * (indice)) + 1U))
+
+
+/******************************************************************************
+ * STATIC VARIABLES
+ *****************************************************************************/
+
+/**
+ * @brief Livelli richiesti per tutti i canali nel tick corrente
+ *
+ * Bit 2i = canale A, bit 2i+1 = canale B dell'encoder i.
+ */
+static uint32_t immagine_uscite DATI_OCM;
+
+/** @brief Livelli effettivamente scritti sui registri dei GPIO */
+static uint32_t ombra_uscite DATI_OCM;
+
+#if (USCITE_GPIO_PORTA_UNICA == 0U)
+/**
+ * @brief Indirizzo base dell'AXI GPIO del canale A, per ogni encoder
+ *
+ * Il design hardware attuale espone i GPIO solo per i primi due encoder.
+ * Aggiungere qui gli indirizzi XPAR quando il design viene esteso.
+ */
+static const UINTPTR indirizzo_gpio_A[N_ENCODER_MAX] COSTANTI_OCM =
+{
+	XPAR_AXI_GPIO_E1_A_BASEADDR, XPAR_AXI_GPIO_E2_A_BASEADDR,
+	GPIO_NON_PRESENTE, GPIO_NON_PRESENTE, GPIO_NON_PRESENTE,
+	GPIO_NON_PRESENTE, GPIO_NON_PRESENTE, GPIO_NON_PRESENTE
+};
+
+/** @brief Indirizzo base dell'AXI GPIO del canale B, per ogni encoder */
+static const UINTPTR indirizzo_gpio_B[N_ENCODER_MAX] COSTANTI_OCM =
+{
+	XPAR_AXI_GPIO_E1_B_BASEADDR, XPAR_AXI_GPIO_E2_B_BASEADDR,
+	GPIO_NON_PRESENTE, GPIO_NON_PRESENTE, GPIO_NON_PRESENTE,
+	GPIO_NON_PRESENTE, GPIO_NON_PRESENTE, GPIO_NON_PRESENTE
+};
+#endif
+
+
+/******************************************************************************
+ * STATIC FUNCTION PROTOTYPES
+ *****************************************************************************/
+#if (USCITE_GPIO_PORTA_UNICA == 0U)
+static void scrivi_canale_gpio(UINTPTR indirizzo, bool livello);
+#endif
+
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+#if (USCITE_GPIO_PORTA_UNICA == 0U)
+/**
+ * @brief Scrive il livello di un canale sul suo AXI GPIO a 1 bit
+ *
+ * @param indirizzo Indirizzo base dell'AXI GPIO
+ * @param livello Livello logico da scrivere
+ *
+ * @details Scrittura diretta sul registro dati, senza le verifiche di
+ * XGpio_DiscreteWrite. I canali senza GPIO nel design vengono saltati.
+ */
+FUNZIONE_OCM static void scrivi_canale_gpio(UINTPTR indirizzo, bool livello)
+{
+	if (indirizzo != GPIO_NON_PRESENTE)
+	{
+		Xil_Out32(indirizzo + XGPIO_DATA_OFFSET,
+				  (livello == true) ? 0x01U : 0x00U);
+	}
+	else
+	{
+		/* Encoder solo emulato, senza GPIO */
+	}
+}
+#endif
+
+
+/******************************************************************************
+ * GLOBAL FUNCTIONS
+ *****************************************************************************/
+
+/**
+ * @brief Configura come uscite i GPIO degli encoder e li porta a livello
+ * basso
+ *
+ * @details Azzera anche l'immagine e l'ombra delle uscite, così il primo
+ * tick scrive solo i canali che devono andare alti.
+ */
+void inizializza_uscite_gpio(void)
+{
+	immagine_uscite = 0;
+	ombra_uscite = 0;
+
+#if (USCITE_GPIO_PORTA_UNICA == 1U)
+	Xil_Out32(GPIO_PORTA_UNICA_BASEADDR + XGPIO_TRI_OFFSET, 0x00U);
+	Xil_Out32(GPIO_PORTA_UNICA_BASEADDR + XGPIO_DATA_OFFSET, 0x00U);
+#else
+	for (uint8_t indice = 0; indice < N_ENCODER; indice++)
+	{
+		if (indirizzo_gpio_A[indice] != GPIO_NON_PRESENTE)
+		{
+			Xil_Out32(indirizzo_gpio_A[indice] + XGPIO_TRI_OFFSET, 0x00U);
+		}
+		else
+		{
+			/* Encoder solo emulato, senza GPIO */
+		}
+
+		if (indirizzo_gpio_B[indice] != GPIO_NON_PRESENTE)
+		{
+			Xil_Out32(indirizzo_gpio_B[indice] + XGPIO_TRI_OFFSET, 0x00U);
+		}
+		else
+		{
+			/* Encoder solo emulato, senza GPIO */
+		}
+
+		scrivi_canale_gpio(indirizzo_gpio_A[indice], false);
+		scrivi_canale_gpio(indirizzo_gpio_B[indice], false);
+	}
+#endif
+}
+
+/**
+ * @brief Registra i livelli dei canali di un encoder per il tick corrente
+ *
+ * @param indice Indice dell'encoder, da 0 a N_ENCODER - 1
+ * @param statoA Livello logico del canale A
+ * @param statoB Livello logico del canale B
+ *
+ * @details Non accede al bus: aggiorna solo l'immagine delle uscite, che
+ * viene scritta da scrivi_uscite_gpio() alla fine del tick.
+ */
+FUNZIONE_OCM void imposta_uscite_encoder_gpio(uint8_t indice, bool statoA, bool statoB)
+{
+	uint32_t immagine = immagine_uscite &
+						~(BIT_CANALE_A(indice) | BIT_CANALE_B(indice));
+
+	if (statoA == true)
+	{
+		immagine |= BIT_CANALE_A(indice);
+	}
+	else
+	{
+		/* Canale basso, MISRA-2023-15.7 */
+	}
+
+	if (statoB == true)
+	{
+		immagine |= BIT_CANALE_B(indice);
+	}
+	else
+	{
+		/* Canale basso, MISRA-2023-15.7 */
+	}
+
+	immagine_uscite = immagine;
+}
+
+/**
+ * @brief Scrive sui GPIO i soli canali cambiati dall'ultimo tick
+ *
+ * @details Confronta l'immagine delle uscite con l'ombra dei registri. Se
+ * niente è cambiato non c'è alcun accesso al bus; altrimenti con la porta
+ * unica si fa una sola scrittura, con le porte separate una scrittura per
+ * ogni canale cambiato.
+ */
+FUNZIONE_OCM void scrivi_uscite_gpio(void)
+{
+	uint32_t cambiati = immagine_uscite ^ ombra_uscite;
+
+	if (cambiati != 0U)
+	{
+#if (USCITE_GPIO_PORTA_UNICA == 1U)
+		Xil_Out32(GPIO_PORTA_UNICA_BASEADDR + XGPIO_DATA_OFFSET,
+				  immagine_uscite);
+#else
+		for (uint8_t indice = 0; indice < N_ENCODER; indice++)
+		{
+			if ((cambiati & BIT_CANALE_A(indice)) != 0U)
+			{
+				scrivi_canale_gpio(indirizzo_gpio_A[indice],
+						(immagine_uscite & BIT_CANALE_A(indice)) != 0U);
+			}
+			else
+			{
+				/* Non succede niente, MISRA-2023-15.7 */
+			}
+
+			if ((cambiati & BIT_CANALE_B(indice)) != 0U)
+			{
+				scrivi_canale_gpio(indirizzo_gpio_B[indice],
+						(immagine_uscite & BIT_CANALE_B(indice)) != 0U);
+			}
+			else
+			{
+				/* Non succede niente, MISRA-2023-15.7 */
+			}
+		}
+#endif
+		ombra_uscite = immagine_uscite;
+	}
+	else
+	{
+		/* Nessun canale cambiato, nessun accesso al bus */
+	}
+}
+
+#endif
+
+
+/****************** (C) COPYRIGHT GITSIM ***** END OF FILE *******************/
@@ -12,7 +12,11 @@
 #include "xil_exception.h"
 #include "ps7_init.h"
 #include "xscugic.h"
+#include "xtime_l.h"
 #include "side.h"
+#include "sezioni_ocm.h"
+#include "gestione_task.h"
+#include "xpseudo_asm.h"
 
 
 /************************************
@@ -28,6 +32,30 @@
 /** @brief Numero di interrupt associato al timer  */
 #define TIMER_IRPT_INTR		 XPAR_SCUTIMER_INTR
 
+/** @brief Numero di interrupt del comparatore del timer globale */
+#define GTIMER_IRPT_INTR	 XPAR_GLOBAL_TMR_INTR
+
+/** @brief Indirizzo base dell'interfaccia CPU del GIC */
+#define GIC_CPU_BASEADDR	 XPAR_SCUGIC_0_CPU_BASEADDR
+
+/** @brief Indirizzo base del timer SCU privato */
+#define TIMER_BASEADDR		 XPAR_PS7_SCUTIMER_0_BASEADDR
+
+/** @brief Registro di stato del timer globale (flag di evento) */
+#define GTIMER_STATO_OFFSET				0x0CU
+
+/** @brief Parte bassa del comparatore del timer globale */
+#define GTIMER_COMPARATORE_BASSO_OFFSET	0x10U
+
+/** @brief Parte alta del comparatore del timer globale */
+#define GTIMER_COMPARATORE_ALTO_OFFSET	0x14U
+
+/** @brief Bit del controllo del timer globale: abilita il comparatore */
+#define GTIMER_ABILITA_COMPARATORE		0x02U
+
+/** @brief Bit del controllo del timer globale: abilita l'interrupt */
+#define GTIMER_ABILITA_IRQ				0x04U
+
 /************************************
  * STATIC VARIABLES
  ************************************/
@@ -38,6 +66,71 @@ static XScuGic istanza_interrupt_gic;
 /** @brief Istanza del timer SCU */
 static XScuTimer istanza_timer_scu;
 
+/**
+ * @brief Valore di ricarica del tick nominale
+ *
+ * TIMER_LV all'avvio, poi quello scelto con imposta_periodo_tick().
+ */
+static volatile u32 ricarica_nominale DATI_OCM = TIMER_LV;
+
+/** @brief Valore di ricarica attivo del timer SCU */
+static volatile u32 ricarica_timer DATI_OCM = TIMER_LV;
+
+/** @brief Tick nominali coperti da un interrupt del timer SCU */
+static uint32_t tick_per_interrupt DATI_OCM = 1U;
+
+/** @brief Tempo del timer globale a cui è attesa la prossima scadenza */
+static XTime tempo_tick_atteso DATI_OCM;
+
+/**
+ * @brief false se tempo_tick_atteso va ricavato di nuovo dal contatore del
+ * timer SCU (primo tick o cambio di periodo)
+ */
+static bool tempo_tick_valido DATI_OCM = false;
+
+/** @brief Interrupt del tick terminati dopo la scadenza successiva */
+static volatile uint32_t overrun_tick DATI_OCM;
+
+/** @brief Tick nominali recuperati dopo scadenze senza interrupt */
+static volatile uint32_t tick_recuperati DATI_OCM;
+
+/** @brief Tick nominali oltre N_TICK_RECUPERO_MAX, persi dal modello */
+static volatile uint32_t tick_non_recuperati DATI_OCM;
+
+/**
+ * @brief Minimo margine tra uscita dal side loop e scadenza successiva, in
+ * conteggi del timer globale
+ */
+static volatile u32 margine_minimo_tick DATI_OCM = UINT32_MAX;
+
+/**
+ * @brief Massimo tempo tra ingresso e uscita dal side loop, in conteggi
+ * del timer globale
+ *
+ * È il costo peggiore del tick con il periodo corrente, usato per validare
+ * un nuovo periodo. La latenza dell'interrupt non è compresa, così le
+ * finestre mascherate del main loop non lo gonfiano; viene azzerato quando
+ * un periodo è accettato.
+ */
+static volatile u32 costo_massimo_tick DATI_OCM;
+
+/** @brief Tempo del timer globale all'ingresso del side loop corrente */
+static XTime tempo_ingresso_tick DATI_OCM;
+
+/** @brief true se il timer SCU gira con il periodo degradato */
+static volatile bool tick_degradato DATI_OCM = false;
+
+/** @brief Richiesta del main loop di tornare al tick nominale */
+static volatile bool richiesta_tick_nominale DATI_OCM = false;
+
+#if (DEGRADO_TICK == 1U)
+/** @brief Interrupt contati nella finestra di overrun corrente */
+static uint32_t interrupt_finestra DATI_OCM;
+
+/** @brief Overrun contati nella finestra di overrun corrente */
+static uint32_t overrun_finestra DATI_OCM;
+#endif
+
 /************************************
  * STATIC FUNCTION PROTOTYPES
  ************************************/
@@ -45,6 +138,11 @@ static void connetti_interrupt_su_timer(XScuGic *istanza_interrupt_gic,
 								XScuTimer *istanza_timer,
 								uint16_t n_timer_interrupt);
 static s32 configura_gic_system(XScuGic *IstanzaGIC);
+#if (IRQ_VELOCE_TICK == 1U)
+static void gestore_irq_veloce(void *riferimento);
+#endif
+static void imposta_ricarica_timer(u32 ricarica, uint32_t tick);
+static XTime ritorna_tempo_prossimo_tick(void);
 
 
 /************************************
@@ -79,9 +177,15 @@ static s32 configura_gic_system(XScuGic *istanza_gic)
 		 * Collega l'handler dell'interrupt alla logica di gestione di
 		 * di interrupt hw del processore
 		 */
+#if (IRQ_VELOCE_TICK == 1U)
+		Xil_ExceptionRegisterHandler(XIL_EXCEPTION_ID_INT,
+					(Xil_ExceptionHandler)gestore_irq_veloce,
+					istanza_gic);
+#else
 		Xil_ExceptionRegisterHandler(XIL_EXCEPTION_ID_INT,
 					(Xil_ExceptionHandler)XScuGic_InterruptHandler,
 					istanza_gic);
+#endif
 
 		/* Abilita l'interrupt del processore */
 		Xil_ExceptionEnableMask(XIL_EXCEPTION_IRQ);
@@ -95,6 +199,43 @@ static s32 configura_gic_system(XScuGic *istanza_gic)
 }
 
 
+#if (IRQ_VELOCE_TICK == 1U)
+/**
+ * @brief Gestore dell'eccezione IRQ con percorso veloce per il tick
+ *
+ * @param riferimento Istanza del GIC, con la tabella degli handler
+ *
+ * @details Legge l'ID dal registro di acknowledge del GIC. Il tick del
+ * timer SCU va direttamente a side_loop(), senza la ricerca in tabella e
+ * le asserzioni del driver; ogni altro interrupt viene smistato dalla
+ * tabella riempita da XScuGic_Connect(), come farebbe
+ * XScuGic_InterruptHandler. Gli ID spuri (1023) non vengono chiusi.
+ */
+FUNZIONE_OCM static void gestore_irq_veloce(void *riferimento)
+{
+	u32 riconoscimento = Xil_In32(GIC_CPU_BASEADDR + XSCUGIC_INT_ACK_OFFSET);
+	u32 id = riconoscimento & XSCUGIC_ACK_INTID_MASK;
+
+	if (id == TIMER_IRPT_INTR)
+	{
+		side_loop(NULL);
+		Xil_Out32(GIC_CPU_BASEADDR + XSCUGIC_EOI_OFFSET, riconoscimento);
+	}
+	else if (id < XSCUGIC_MAX_NUM_INTR_INPUTS)
+	{
+		const XScuGic_VectorTableEntry *voce =
+				&((XScuGic *) riferimento)->Config->HandlerTable[id];
+
+		voce->Handler(voce->CallBackRef);
+		Xil_Out32(GIC_CPU_BASEADDR + XSCUGIC_EOI_OFFSET, riconoscimento);
+	}
+	else
+	{
+		/* Interrupt spurio, non va chiuso */
+	}
+}
+#endif
+
 /**
  * @brief Connette e configura l'interrupt per il timer SCU
  *
@@ -125,6 +266,43 @@ static void connetti_interrupt_su_timer(XScuGic *istanza_interrupt,
 }
 
 
+/**
+ * @brief Cambia il periodo del timer SCU
+ *
+ * @param ricarica Nuovo valore di ricarica
+ * @param tick Tick nominali coperti da un periodo
+ *
+ * @details La scrittura del registro di ricarica carica anche il contatore,
+ * quindi il nuovo periodo parte subito. La prossima scadenza attesa viene
+ * ricavata di nuovo dal contatore al prossimo interrupt. Va chiamata dal
+ * side loop.
+ */
+static void imposta_ricarica_timer(u32 ricarica, uint32_t tick)
+{
+	Xil_Out32(TIMER_BASEADDR + XSCUTIMER_LOAD_OFFSET, ricarica - 1U);
+	ricarica_timer = ricarica;
+	tick_per_interrupt = tick;
+	tempo_tick_valido = false;
+}
+
+/**
+ * @brief Restituisce l'istante del timer globale del tick
+ * ritorna_tick_corrente()
+ *
+ * @return XTime Prossima scadenza attesa, anticipata dei tick nominali in
+ * più che la stessa scadenza serve quando il tick è degradato
+ *
+ * @details Va chiamata con l'interrupt del tick mascherato. Dopo un cambio
+ * di periodo il valore torna esatto dal tick successivo.
+ */
+static XTime ritorna_tempo_prossimo_tick(void)
+{
+	XTime conteggi = (XTime) (TIMER_PSC * ricarica_nominale);
+
+	return tempo_tick_atteso - (((XTime) tick_per_interrupt - 1U) * conteggi);
+}
+
+
 /************************************
  * GLOBAL FUNCTIONS
  ************************************/
@@ -145,7 +323,7 @@ void inizializza_polling_timer()
 	status = configura_gic_system(&istanza_interrupt_gic);
 	while(status != XST_SUCCESS)
 	{
-		/* Configurazione interrupt fallita, mi blocco qui */
+		/* Configurazione interrupt fallita, mi blocco qui fino al watchdog */
 	}
 
 	/* Inizializza il driver del timer SCU */
@@ -154,14 +332,14 @@ void inizializza_polling_timer()
 									 scu_config_pointer->BaseAddr);
 	while(status != XST_SUCCESS)
 	{
-		/* Configurazione timer fallita, mi blocco qui */
+		/* Configurazione timer fallita, mi blocco qui fino al watchdog */
 	}
 
 	/* Eseguo un self-test del timer */
 	status = XScuTimer_SelfTest(&istanza_timer_scu);
 	while(status != XST_SUCCESS)
 	{
-		/* Self-test del timer fallito, mi blocco qui */
+		/* Self-test del timer fallito, mi blocco qui fino al watchdog */
 	}
 
 	/* Configuro l'interrupt sul reset del timer */
@@ -174,12 +352,31 @@ void inizializza_polling_timer()
 	XScuTimer_SetPrescaler(&istanza_timer_scu, TIMER_PSC - 1U);
 
 	/* Imposto il valore di ricarica del timer */
-	XScuTimer_LoadTimer(&istanza_timer_scu, TIMER_LV - 1U);
+	XScuTimer_LoadTimer(&istanza_timer_scu, ricarica_nominale - 1U);
 
 	/* Avvio il conteggio del timer */
 	XScuTimer_Start(&istanza_timer_scu);
 }
 
+/**
+ * @brief Collega l'handler di una periferica all'interrupt controller
+ *
+ * Registra l'handler nella tabella del GIC già configurato da
+ * inizializza_polling_timer() e abilita l'interrupt indicato. Va chiamata
+ * dopo inizializza_polling_timer().
+ *
+ * @param n_interrupt Numero dell'interrupt della periferica
+ * @param handler Funzione da eseguire all'arrivo dell'interrupt
+ * @param riferimento Argomento passato all'handler
+ */
+void connetti_interrupt_periferica(uint16_t n_interrupt,
+								   Xil_InterruptHandler handler,
+								   void *riferimento)
+{
+	XScuGic_Connect(&istanza_interrupt_gic, n_interrupt, handler, riferimento);
+	XScuGic_Enable(&istanza_interrupt_gic, n_interrupt);
+}
+
 /**
  * @brief Restituisce l'istanza del timer SCU utilizzato.
  *
@@ -194,12 +391,25 @@ XScuTimer ritorna_istanza_timer(void)
 	return istanza_timer_scu;
 }
 
+/**
+ * @brief Azzera il flag di interrupt del timer SCU
+ *
+ * Scrittura diretta sul registro di stato, senza passare da una copia
+ * dell'istanza del driver. Va chiamata all'inizio del side loop.
+ */
+FUNZIONE_OCM void pulisci_interrupt_timer(void)
+{
+	Xil_Out32(TIMER_BASEADDR + XSCUTIMER_ISR_OFFSET,
+			  XSCUTIMER_ISR_EVENT_FLAG_MASK);
+}
+
 /**
  * @brief Calcola e restituisce il tempo di polling del timer
  *
  * Questa funzione calcola il tempo di polling basandosi sui valori di
- * TIMER_PSC (prescaler), TIMER_LV (valore di ricarica), e la frequenza
- * della CPU.
+ * TIMER_PSC (prescaler), valore di ricarica nominale (TIMER_LV o quello
+ * scelto con imposta_periodo_tick()), e la frequenza della CPU. Il tick
+ * degradato non cambia il risultato.
  *
  * Viene utilizzato nel side loop per dare il timing all'aggiornamento ed
  * emulazione delle variabili di encoder.
@@ -214,6 +424,484 @@ XScuTimer ritorna_istanza_timer(void)
  */
 float_t ritorna_tempo_del_polling(void)
 {
-	float_t t_polling = (TIMER_PSC * TIMER_LV) / (APU_FREQ * 0.5);
+	float_t t_polling = (TIMER_PSC * ricarica_nominale) / (APU_FREQ * 0.5);
 	return t_polling;
 }
+
+/**
+ * @brief Restituisce la durata esatta del tick nominale
+ *
+ * Timer SCU e timer globale contano con lo stesso clock, quindi il tick
+ * dura un numero intero di conteggi del timer globale. È la base dei tempi
+ * del modello degli encoder, senza l'arrotondamento di
+ * ritorna_tempo_del_polling().
+ *
+ * @return u32 Conteggi del timer globale per tick nominale
+ */
+u32 ritorna_conteggi_tick(void)
+{
+	return TIMER_PSC * ricarica_nominale;
+}
+
+/**
+ * @brief Restituisce l'istante del timer globale di un tick nominale
+ *
+ * Il riferimento è la scadenza del timer SCU che serve il tick
+ * ritorna_tick_corrente(); gli altri tick distano multipli del periodo
+ * nominale. Il timer globale è comune ai due core, quindi nella build AMP
+ * l'istante vale anche sull'altro core, che ha un tick diverso.
+ *
+ * Va chiamata dal main loop o dal side loop dopo esegui_task_tick().
+ *
+ * @param tick Tick nella numerazione di ritorna_tick_corrente(), entro
+ * 2^31 tick da quello corrente
+ * @return XTime Istante del tick, in conteggi del timer globale
+ */
+XTime ritorna_tempo_del_tick(uint32_t tick)
+{
+	u32 cpsr = mfcpsr();
+	int64_t conteggi;
+	int32_t distanza;
+	XTime riferimento;
+
+	/* Scadenza e numero del tick vanno letti nello stesso tick */
+	mtcpsr(cpsr | XIL_EXCEPTION_IRQ);
+	conteggi = (int64_t) (TIMER_PSC * ricarica_nominale);
+	riferimento = ritorna_tempo_prossimo_tick();
+	distanza = (int32_t) (tick - ritorna_tick_corrente());
+	mtcpsr(cpsr);
+
+	return riferimento + ((XTime) (((int64_t) distanza) * conteggi));
+}
+
+/**
+ * @brief Restituisce i tick nominali che mancano a un istante del timer
+ * globale
+ *
+ * Inversa di ritorna_tempo_del_tick(): il tick è il più vicino
+ * all'istante, quindi il suo istante dista al massimo mezzo tick.
+ *
+ * Va chiamata dal main loop o dal side loop dopo esegui_task_tick().
+ *
+ * @param tempo Istante, in conteggi del timer globale
+ * @return int64_t Tick da sommare a ritorna_tick_corrente(), negativo per
+ * un istante già passato
+ */
+int64_t ritorna_tick_del_tempo(XTime tempo)
+{
+	u32 cpsr = mfcpsr();
+	int64_t conteggi;
+	int64_t differenza;
+
+	mtcpsr(cpsr | XIL_EXCEPTION_IRQ);
+	conteggi = (int64_t) (TIMER_PSC * ricarica_nominale);
+	differenza = (int64_t) (tempo - ritorna_tempo_prossimo_tick());
+	mtcpsr(cpsr);
+
+	/* La divisione tronca verso zero: arrotondo in entrambi i versi */
+	if (differenza >= 0)
+	{
+		differenza = differenza + (conteggi / 2);
+	}
+	else
+	{
+		differenza = differenza - (conteggi / 2);
+	}
+
+	return differenza / conteggi;
+}
+
+/**
+ * @brief Cambia il periodo del tick nominale
+ *
+ * Il periodo viene arrotondato ai conteggi del timer SCU e accettato solo
+ * se la ricarica è tra RICARICA_TICK_MIN e RICARICA_TICK_MAX e se il
+ * periodo è almeno MARGINE_COSTO_TICK volte il costo peggiore del tick
+ * misurato finora. Il periodo predefinito è sempre accettato: è quello
+ * delle connessioni classiche. Un periodo accettato parte subito, annulla
+ * il degrado e fa ripartire la misura del costo.
+ *
+ * Va chiamata con l'interrupt del tick mascherato, o dal side loop stesso,
+ * insieme all'aggiornamento di task ed encoder (assegna_periodo_side_loop()).
+ *
+ * @param periodo Nuovo periodo, in secondi; 0 per il periodo predefinito
+ * dato da TIMER_LV
+ * @return bool true se il periodo è stato applicato
+ */
+bool imposta_periodo_tick(float_t periodo)
+{
+	bool accettato = false;
+
+	/* Creo la variabile temporanea per MISRA-2023 */
+	float_t n_temp = ((periodo * (APU_FREQ * 0.5)) / TIMER_PSC) + 0.5f;
+
+	if (periodo == 0.0f)
+	{
+		n_temp = (float_t) TIMER_LV;
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+
+	/* I confronti falliscono anche per NaN */
+	if ((n_temp >= (float_t) RICARICA_TICK_MIN) &&
+		(n_temp < (float_t) (RICARICA_TICK_MAX + 1U)))
+	{
+		u32 ricarica = (u32) n_temp;
+
+		if ((periodo == 0.0f) ||
+			((TIMER_PSC * ricarica) >= (MARGINE_COSTO_TICK * costo_massimo_tick)))
+		{
+			imposta_ricarica_timer(ricarica, 1U);
+			ricarica_nominale = ricarica;
+			tick_degradato = false;
+			richiesta_tick_nominale = false;
+			margine_minimo_tick = UINT32_MAX;
+			costo_massimo_tick = 0;
+#if (DEGRADO_TICK == 1U)
+			interrupt_finestra = 0;
+			overrun_finestra = 0;
+#endif
+			accettato = true;
+		}
+		else
+		{
+			/* Periodo troppo corto per il costo misurato */
+		}
+	}
+	else
+	{
+		/* Periodo fuori dai limiti */
+	}
+
+	return accettato;
+}
+
+/**
+ * @brief Misura i tick nominali trascorsi dall'interrupt precedente
+ *
+ * Va chiamata all'inizio del side loop. Confronta il timer globale con la
+ * scadenza attesa del timer SCU: se nel frattempo sono passate scadenze
+ * senza interrupt (side loop precedente troppo lungo, interrupt mascherati)
+ * le conta, così il modello degli encoder integra il tempo reale e non
+ * resta indietro. Timer globale e timer SCU contano con lo stesso clock,
+ * quindi la scadenza attesa non deriva.
+ *
+ * @return uint32_t Tick nominali da integrare, almeno uno e al massimo
+ * N_TICK_RECUPERO_MAX
+ */
+FUNZIONE_OCM uint32_t misura_tick_trascorsi(void)
+{
+	u32 periodo = TIMER_PSC * ricarica_timer;
+	uint32_t scadenze = 1U;
+	uint32_t n_tick;
+	XTime adesso;
+
+	XTime_GetTime(&adesso);
+	tempo_ingresso_tick = adesso;
+
+	if (tempo_tick_valido == true)
+	{
+		/* Ritardo dalla scadenza attesa, spostato di mezzo periodo */
+		u32 ritardo = ((u32) (adesso - tempo_tick_atteso)) + (periodo / 2U);
+
+		if (((int32_t) ritardo) < 0)
+		{
+			/* Interrupt in anticipo: la scadenza attesa non è affidabile */
+			tempo_tick_valido = false;
+		}
+		else if (ritardo >= periodo)
+		{
+			/* Scadenze passate senza interrupt, divisione solo qui */
+			scadenze = 1U + (ritardo / periodo);
+		}
+		else
+		{
+			/* Caso normale, MISRA-2023-15.7 */
+		}
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+
+	if (tempo_tick_valido == false)
+	{
+		/* Il contatore scende da ricarica - 1 dopo la scadenza appena servita */
+		u32 contatore = Xil_In32(TIMER_BASEADDR + XSCUTIMER_COUNTER_OFFSET);
+
+		tempo_tick_atteso = adesso -
+				(((ricarica_timer - 1U) - contatore) * TIMER_PSC);
+		tempo_tick_valido = true;
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+
+	tempo_tick_atteso = tempo_tick_atteso + (((XTime) scadenze) * periodo);
+	n_tick = scadenze * tick_per_interrupt;
+	tick_recuperati = tick_recuperati + (n_tick - tick_per_interrupt);
+
+	if (n_tick > N_TICK_RECUPERO_MAX)
+	{
+		tick_non_recuperati = tick_non_recuperati +
+							  (n_tick - N_TICK_RECUPERO_MAX);
+		n_tick = N_TICK_RECUPERO_MAX;
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+
+	return n_tick;
+}
+
+/**
+ * @brief Controlla all'uscita dal side loop se il tick è andato in overrun
+ *
+ * Va chiamata come ultima istruzione del side loop. Il flag del timer SCU,
+ * azzerato all'ingresso, è di nuovo alto se la scadenza successiva è già
+ * passata; altrimenti il contatore dà il margine rimasto. Il costo è il
+ * tempo passato da misura_tick_trascorsi(), senza la latenza di ingresso:
+ * anche dopo un overrun misura solo il side loop. Con DEGRADO_TICK
+ * applica il periodo degradato quando gli overrun persistono, e il ritorno
+ * al periodo nominale chiesto con richiedi_tick_nominale().
+ */
+FUNZIONE_OCM void controlla_overrun_tick(void)
+{
+	u32 stato = Xil_In32(TIMER_BASEADDR + XSCUTIMER_ISR_OFFSET);
+	u32 costo;
+	XTime uscita;
+
+	XTime_GetTime(&uscita);
+	costo = (u32) (uscita - tempo_ingresso_tick);
+
+	if ((stato & XSCUTIMER_ISR_EVENT_FLAG_MASK) != 0U)
+	{
+		/* La scadenza successiva è già arrivata */
+		overrun_tick++;
+		margine_minimo_tick = 0;
+#if (DEGRADO_TICK == 1U)
+		overrun_finestra++;
+#endif
+	}
+	else
+	{
+		u32 margine = Xil_In32(TIMER_BASEADDR + XSCUTIMER_COUNTER_OFFSET) *
+					  TIMER_PSC;
+
+		if (margine < margine_minimo_tick)
+		{
+			margine_minimo_tick = margine;
+		}
+		else
+		{
+			/* Non succede niente, MISRA-2023-15.7 */
+		}
+	}
+
+	if (costo > costo_massimo_tick)
+	{
+		costo_massimo_tick = costo;
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+
+#if (DEGRADO_TICK == 1U)
+	interrupt_finestra++;
+	if (interrupt_finestra >= FINESTRA_OVERRUN)
+	{
+		if ((overrun_finestra >= SOGLIA_OVERRUN_DEGRADO) &&
+			(tick_degradato == false))
+		{
+			imposta_ricarica_timer(ricarica_nominale * FATTORE_DEGRADO_TICK,
+								   FATTORE_DEGRADO_TICK);
+			tick_degradato = true;
+		}
+		else
+		{
+			/* Non succede niente, MISRA-2023-15.7 */
+		}
+
+		interrupt_finestra = 0;
+		overrun_finestra = 0;
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+#endif
+
+	if (richiesta_tick_nominale == true)
+	{
+		richiesta_tick_nominale = false;
+
+		if (tick_degradato == true)
+		{
+			imposta_ricarica_timer(ricarica_nominale, 1U);
+			tick_degradato = false;
+		}
+		else
+		{
+			/* Non succede niente, MISRA-2023-15.7 */
+		}
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+}
+
+/**
+ * @brief Chiede di tornare al tick nominale
+ *
+ * Il cambio viene applicato dal side loop, alla fine del prossimo tick. Se
+ * il tick non è degradato non ha effetto.
+ */
+void richiedi_tick_nominale(void)
+{
+	richiesta_tick_nominale = true;
+}
+
+/**
+ * @brief Restituisce il valore di ricarica attivo del timer SCU
+ *
+ * @return u32 Ricarica nominale, o il suo multiplo se il tick è degradato
+ */
+FUNZIONE_OCM u32 ritorna_ricarica_timer(void)
+{
+	return ricarica_timer;
+}
+
+/**
+ * @brief Restituisce gli overrun del tick
+ *
+ * @return uint32_t Interrupt del tick terminati dopo la scadenza successiva
+ */
+uint32_t ritorna_overrun_tick(void)
+{
+	return overrun_tick;
+}
+
+/**
+ * @brief Restituisce i tick nominali recuperati dal modello
+ *
+ * @return uint32_t Tick nominali integrati in più per scadenze senza
+ * interrupt
+ */
+uint32_t ritorna_tick_recuperati(void)
+{
+	return tick_recuperati;
+}
+
+/**
+ * @brief Restituisce i tick nominali non recuperati dal modello
+ *
+ * @return uint32_t Tick nominali oltre N_TICK_RECUPERO_MAX in un interrupt
+ */
+uint32_t ritorna_tick_non_recuperati(void)
+{
+	return tick_non_recuperati;
+}
+
+/**
+ * @brief Restituisce il minimo margine del side loop sulla scadenza
+ * successiva
+ *
+ * @return u32 Conteggi del timer globale, 0 dopo il primo overrun
+ */
+u32 ritorna_margine_minimo_tick(void)
+{
+	return margine_minimo_tick;
+}
+
+/**
+ * @brief Restituisce il costo peggiore del tick con il periodo corrente
+ *
+ * @return u32 Massimo tempo tra ingresso e uscita dal side loop, in
+ * conteggi del timer globale
+ */
+u32 ritorna_costo_massimo_tick(void)
+{
+	return costo_massimo_tick;
+}
+
+/**
+ * @brief Indica se il tick gira con il periodo degradato
+ *
+ * @return bool true se il periodo è FATTORE_DEGRADO_TICK volte il nominale
+ */
+bool ritorna_tick_degradato(void)
+{
+	return tick_degradato;
+}
+
+/**
+ * @brief Collega un handler all'interrupt del comparatore del timer globale
+ *
+ * Il comparatore resta spento fino alla prima chiamata di
+ * programma_comparatore_globale(). Va chiamata dopo
+ * inizializza_polling_timer().
+ *
+ * @param handler Funzione da eseguire quando il timer globale raggiunge il
+ * comparatore
+ */
+void inizializza_comparatore_globale(Xil_InterruptHandler handler)
+{
+	ferma_comparatore_globale();
+	connetti_interrupt_periferica(GTIMER_IRPT_INTR, handler, NULL);
+}
+
+/**
+ * @brief Programma un interrupt quando il timer globale raggiunge un tempo
+ *
+ * Il comparatore viene spento durante la scrittura delle due metà, come
+ * richiesto dal manuale del Cortex-A9, poi riacceso con l'interrupt. Se il
+ * tempo è già passato l'interrupt arriva subito.
+ *
+ * @param tempo Valore del timer globale a cui generare l'interrupt
+ */
+FUNZIONE_OCM void programma_comparatore_globale(uint64_t tempo)
+{
+	u32 controllo = Xil_In32(GLOBAL_TMR_BASEADDR + GTIMER_CONTROL_OFFSET);
+
+	controllo &= ~(GTIMER_ABILITA_COMPARATORE | GTIMER_ABILITA_IRQ);
+	Xil_Out32(GLOBAL_TMR_BASEADDR + GTIMER_CONTROL_OFFSET, controllo);
+
+	Xil_Out32(GLOBAL_TMR_BASEADDR + GTIMER_COMPARATORE_BASSO_OFFSET,
+			  (u32) tempo);
+	Xil_Out32(GLOBAL_TMR_BASEADDR + GTIMER_COMPARATORE_ALTO_OFFSET,
+			  (u32) (tempo >> 32U));
+
+	controllo |= (GTIMER_ABILITA_COMPARATORE | GTIMER_ABILITA_IRQ);
+	Xil_Out32(GLOBAL_TMR_BASEADDR + GTIMER_CONTROL_OFFSET, controllo);
+}
+
+/**
+ * @brief Spegne il comparatore del timer globale e il suo interrupt
+ *
+ * Il timer globale continua a contare, quindi XTime_GetTime() resta valida.
+ */
+void ferma_comparatore_globale(void)
+{
+	u32 controllo = Xil_In32(GLOBAL_TMR_BASEADDR + GTIMER_CONTROL_OFFSET);
+
+	controllo &= ~(GTIMER_ABILITA_COMPARATORE | GTIMER_ABILITA_IRQ);
+	Xil_Out32(GLOBAL_TMR_BASEADDR + GTIMER_CONTROL_OFFSET, controllo);
+	pulisci_comparatore_globale();
+}
+
+/**
+ * @brief Azzera il flag di evento del comparatore del timer globale
+ *
+ * Va chiamata all'inizio dell'handler collegato con
+ * inizializza_comparatore_globale().
+ */
+FUNZIONE_OCM void pulisci_comparatore_globale(void)
+{
+	Xil_Out32(GLOBAL_TMR_BASEADDR + GTIMER_STATO_OFFSET, 0x01U);
+}
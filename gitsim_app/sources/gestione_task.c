@@ -0,0 +1,546 @@
+/**
+ ******************************************************************************
+ * @file    gestione_task.c
+ * @author  Saimon Collaku
+ ******************************************************************************
+ */
+
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "gestione_task.h"
+#include "gestione_polling.h"
+#include "sezioni_ocm.h"
+#include "xil_exception.h"
+#include "xpseudo_asm.h"
+
+
+/******************************************************************************
+ * PRIVATE MACROS AND DEFINES
+ *****************************************************************************/
+
+/**
+ * @brief Fasi provate da scegli_fase_task() prima di arrendersi
+ *
+ * Senza limite la ricerca proverebbe fino a un periodo intero di fasi, con
+ * divisioni software per ognuna: centinaia di migliaia per un task lento.
+ */
+#define TENTATIVI_FASE_MAX	16U
+
+
+/******************************************************************************
+ * TYPEDEFS
+ *****************************************************************************/
+
+/** @brief Voce della tabella dei task periodici */
+typedef struct
+{
+	/** @brief Funzione da eseguire */
+	funzione_task funzione;
+
+	/** @brief Periodo richiesto, in secondi */
+	float_t periodo;
+
+	/** @brief Sfasamento richiesto, in secondi */
+	float_t sfasamento;
+
+	/** @brief Periodo, in tick del side loop */
+	uint32_t periodo_tick;
+
+	/** @brief Sfasamento effettivo, in tick, rispetto al tick zero */
+	uint32_t fase_tick;
+
+	/** @brief Tick della prossima esecuzione */
+	uint32_t prossimo_tick;
+
+	/** @brief true se il task viene eseguito dal main loop */
+	bool differito;
+
+	/** @brief Richiesta di esecuzione per il main loop, solo se differito */
+	volatile bool in_attesa;
+
+} task_periodico;
+
+
+/******************************************************************************
+ * STATIC VARIABLES
+ *****************************************************************************/
+
+/** @brief Tabella dei task registrati */
+static task_periodico tabella_task[N_TASK_MAX] DATI_OCM;
+
+/**
+ * @brief Numero di task registrati
+ *
+ * Viene incrementato solo dopo aver riempito la voce, quindi il side loop
+ * non vede mai una voce a metà.
+ */
+static volatile uint8_t n_task DATI_OCM;
+
+/** @brief Contatore dei tick del side loop, con riavvolgimento */
+static volatile uint32_t tick_corrente DATI_OCM;
+
+/**
+ * @brief Esecuzioni differite perse perché il main loop non aveva ancora
+ * servito la richiesta precedente
+ */
+static volatile uint32_t task_saltati DATI_OCM;
+
+
+/******************************************************************************
+ * STATIC FUNCTION PROTOTYPES
+ *****************************************************************************/
+static uint32_t mcd(uint32_t a, uint32_t b);
+static uint32_t scegli_fase_task(uint32_t periodo_tick, uint32_t fase_richiesta,
+								 uint8_t n_precedenti);
+static uint32_t converti_in_tick(float_t tempo, float_t t_tick);
+static uint32_t converti_periodo_in_tick(float_t periodo, float_t t_tick);
+static void imposta_tick_task(uint8_t indice, uint32_t periodo_tick,
+							  uint32_t fase_tick);
+static void calcola_tick_task(uint8_t indice, float_t t_tick);
+
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+/**
+ * @brief Massimo comun divisore con l'algoritmo di Euclide
+ *
+ * @param a Primo numero
+ * @param b Secondo numero
+ * @return uint32_t MCD di a e b
+ */
+static uint32_t mcd(uint32_t a, uint32_t b)
+{
+	while (b != 0U)
+	{
+		uint32_t resto = a % b;
+		a = b;
+		b = resto;
+	}
+
+	return a;
+}
+
+/**
+ * @brief Sceglie la fase di un nuovo task in modo che non condivida mai un
+ * tick con i task già registrati
+ *
+ * @param periodo_tick Periodo del nuovo task, in tick
+ * @param fase_richiesta Fase desiderata, in tick
+ * @param n_precedenti Numero di voci della tabella da evitare
+ * @return uint32_t Prima fase, a partire da quella richiesta, libera da
+ * collisioni; la fase richiesta se non ne esiste una entro
+ * TENTATIVI_FASE_MAX tick
+ *
+ * @details Due task di periodo p1, p2 e fase f1, f2 cadono prima o poi
+ * nello stesso tick se e solo se (f1 - f2) è multiplo di MCD(p1, p2). Gli
+ * MCD vengono calcolati una volta sola; con un MCD pari a 1 nessuna fase è
+ * libera e la ricerca non parte.
+ */
+static uint32_t scegli_fase_task(uint32_t periodo_tick, uint32_t fase_richiesta,
+								 uint8_t n_precedenti)
+{
+	uint32_t fase_scelta = fase_richiesta % periodo_tick;
+	uint32_t divisori[N_TASK_MAX];
+	uint32_t fasi_altri[N_TASK_MAX];
+	uint32_t tentativi = TENTATIVI_FASE_MAX;
+	bool trovata = false;
+
+	for (uint8_t indice = 0; indice < n_precedenti; indice++)
+	{
+		divisori[indice] = mcd(periodo_tick, tabella_task[indice].periodo_tick);
+		fasi_altri[indice] = tabella_task[indice].fase_tick % divisori[indice];
+
+		if (divisori[indice] == 1U)
+		{
+			/* Collide a ogni fase: tengo quella richiesta */
+			tentativi = 0;
+		}
+		else
+		{
+			/* Non succede niente, MISRA-2023-15.7 */
+		}
+	}
+
+	if (tentativi > periodo_tick)
+	{
+		tentativi = periodo_tick;
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+
+	for (uint32_t tentativo = 0; (tentativo < tentativi) && (trovata == false);
+		 tentativo++)
+	{
+		uint32_t fase = (fase_richiesta + tentativo) % periodo_tick;
+		bool libera = true;
+
+		for (uint8_t indice = 0; indice < n_precedenti; indice++)
+		{
+			if ((fase % divisori[indice]) == fasi_altri[indice])
+			{
+				libera = false;
+			}
+			else
+			{
+				/* Non succede niente, MISRA-2023-15.7 */
+			}
+		}
+
+		if (libera == true)
+		{
+			fase_scelta = fase;
+			trovata = true;
+		}
+		else
+		{
+			/* Provo il tick successivo */
+		}
+	}
+
+	return fase_scelta;
+}
+
+/**
+ * @brief Converte un tempo in un numero di tick del side loop
+ *
+ * @param tempo Tempo da convertire, in secondi
+ * @param t_tick Durata di un tick, in secondi
+ * @return uint32_t Numero di tick arrotondato al più vicino
+ */
+static uint32_t converti_in_tick(float_t tempo, float_t t_tick)
+{
+	/* Creo la variabile temporanea per MISRA-2023 */
+	float_t n_temp = (tempo / t_tick) + 0.5f;
+	return (uint32_t) n_temp;
+}
+
+/**
+ * @brief Converte il periodo di un task in tick del side loop
+ *
+ * @param periodo Periodo, in secondi
+ * @param t_tick Durata di un tick, in secondi
+ * @return uint32_t Periodo in tick, almeno uno
+ */
+static uint32_t converti_periodo_in_tick(float_t periodo, float_t t_tick)
+{
+	uint32_t periodo_tick = converti_in_tick(periodo, t_tick);
+
+	if (periodo_tick == 0U)
+	{
+		periodo_tick = 1U;
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+
+	return periodo_tick;
+}
+
+/**
+ * @brief Scrive periodo e fase di un task e ne calcola la prossima
+ * esecuzione
+ *
+ * @param indice Voce della tabella
+ * @param periodo_tick Periodo, in tick
+ * @param fase_tick Fase scelta da scegli_fase_task(), in tick
+ *
+ * @details Il prossimo tick è il primo futuro con la fase scelta. Va
+ * chiamata con l'interrupt del tick mascherato se la voce è già visibile al
+ * side loop.
+ */
+static void imposta_tick_task(uint8_t indice, uint32_t periodo_tick,
+							  uint32_t fase_tick)
+{
+	task_periodico *task = &tabella_task[indice];
+	uint32_t ora = tick_corrente;
+
+	task->periodo_tick = periodo_tick;
+	task->fase_tick = fase_tick;
+
+	/* Primo tick futuro con la fase scelta */
+	task->prossimo_tick = ora + 1U +
+		((fase_tick + periodo_tick - ((ora + 1U) % periodo_tick)) %
+		 periodo_tick);
+}
+
+/**
+ * @brief Converte periodo e sfasamento di un task in tick del side loop
+ *
+ * @param indice Voce della tabella, con periodo e sfasamento già scritti
+ * @param t_tick Durata di un tick, in secondi
+ *
+ * @details Il periodo minimo è di un tick. La fase evita i task delle voci
+ * precedenti.
+ */
+static void calcola_tick_task(uint8_t indice, float_t t_tick)
+{
+	const task_periodico *task = &tabella_task[indice];
+	uint32_t periodo_tick = converti_periodo_in_tick(task->periodo, t_tick);
+
+	imposta_tick_task(indice, periodo_tick,
+					  scegli_fase_task(periodo_tick,
+									   converti_in_tick(task->sfasamento,
+														t_tick),
+									   indice));
+}
+
+
+/******************************************************************************
+ * GLOBAL FUNCTIONS
+ *****************************************************************************/
+
+/**
+ * @brief Svuota la tabella dei task
+ *
+ * @details Va chiamata prima di qualunque registra_task().
+ */
+void inizializza_task(void)
+{
+	n_task = 0;
+	task_saltati = 0;
+}
+
+/**
+ * @brief Registra un task periodico
+ *
+ * @param periodo Periodo del task, in secondi
+ * @param sfasamento Sfasamento desiderato, in secondi
+ * @param funzione Funzione da chiamare a ogni periodo
+ * @param budget_us Tempo di esecuzione massimo previsto, in microsecondi
+ * @return bool true se il task è stato registrato, false se la tabella è
+ * piena
+ *
+ * @details Periodo e sfasamento vengono arrotondati ai tick del side loop
+ * dati da ritorna_tempo_del_polling(), con periodo minimo di un tick. Lo
+ * sfasamento viene spostato in avanti, se serve, così che il task non
+ * capiti mai nello stesso tick di un task già registrato. Se budget_us
+ * supera BUDGET_TASK_ISR_US il task viene eseguito dal main loop in
+ * esegui_task_differiti().
+ */
+bool registra_task(float_t periodo, float_t sfasamento,
+				   funzione_task funzione, uint32_t budget_us)
+{
+	bool registrato = false;
+	uint8_t indice = n_task;
+
+	if (indice < N_TASK_MAX)
+	{
+		task_periodico *task = &tabella_task[indice];
+
+		task->funzione = funzione;
+		task->periodo = periodo;
+		task->sfasamento = sfasamento;
+		task->differito = (budget_us > BUDGET_TASK_ISR_US);
+		task->in_attesa = false;
+		calcola_tick_task(indice, ritorna_tempo_del_polling());
+
+		n_task = indice + 1U;
+		registrato = true;
+	}
+	else
+	{
+		/* Tabella piena */
+	}
+
+	return registrato;
+}
+
+/**
+ * @brief Ricalcola i tick di tutti i task dopo un cambio del periodo del
+ * side loop
+ *
+ * @details Periodi e sfasamenti in secondi restano quelli registrati; le
+ * richieste differite in attesa non vengono perse. Va chiamata con
+ * l'interrupt del tick mascherato, o dal side loop stesso.
+ */
+void ricalcola_task(void)
+{
+	float_t t_tick = ritorna_tempo_del_polling();
+	uint8_t n = n_task;
+
+	for (uint8_t indice = 0; indice < n; indice++)
+	{
+		calcola_tick_task(indice, t_tick);
+	}
+}
+
+/**
+ * @brief Cambia il periodo di un task già registrato
+ *
+ * @param funzione Funzione con cui il task è stato registrato
+ * @param periodo Nuovo periodo, in secondi
+ * @return bool true se il task è stato trovato
+ *
+ * @details Sfasamento e modalità di esecuzione restano quelli registrati;
+ * la prossima esecuzione è il primo tick futuro con la nuova fase. Si può
+ * chiamare dal main loop: la fase viene scelta a interrupt abilitato, solo
+ * la scrittura della voce avviene con l'interrupt del tick mascherato; lo
+ * stato dell'interrupt viene ripristinato.
+ */
+bool assegna_periodo_task(funzione_task funzione, float_t periodo)
+{
+	bool trovato = false;
+	uint8_t n = n_task;
+
+	for (uint8_t indice = 0; (indice < n) && (trovato == false); indice++)
+	{
+		task_periodico *task = &tabella_task[indice];
+
+		if (task->funzione == funzione)
+		{
+			float_t t_tick = ritorna_tempo_del_polling();
+			uint32_t periodo_tick = converti_periodo_in_tick(periodo, t_tick);
+			uint32_t fase_tick = scegli_fase_task(periodo_tick,
+					converti_in_tick(task->sfasamento, t_tick), indice);
+			u32 cpsr = mfcpsr();
+
+			mtcpsr(cpsr | XIL_EXCEPTION_IRQ);
+			task->periodo = periodo;
+			imposta_tick_task(indice, periodo_tick, fase_tick);
+			mtcpsr(cpsr);
+
+			trovato = true;
+		}
+		else
+		{
+			/* Non succede niente, MISRA-2023-15.7 */
+		}
+	}
+
+	return trovato;
+}
+
+/**
+ * @brief Avvia i task dovuti nel tick corrente
+ *
+ * @param n_tick Tick nominali trascorsi dalla chiamata precedente, dati da
+ * misura_tick_trascorsi()
+ *
+ * @details Da chiamare una volta per interrupt dal side loop. I task
+ * leggeri vengono eseguiti subito; per quelli differiti viene solo alzata
+ * la richiesta. Se il tick di un task è già passato (registrazione a
+ * cavallo di un tick, tick saltati per overrun o degrado) il task parte
+ * subito e mantiene la sua fase.
+ */
+FUNZIONE_OCM void esegui_task_tick(uint32_t n_tick)
+{
+	uint32_t ora = tick_corrente + n_tick - 1U;
+	uint8_t n = n_task;
+
+	for (uint8_t indice = 0; indice < n; indice++)
+	{
+		task_periodico *task = &tabella_task[indice];
+
+		if (((int32_t) (ora - task->prossimo_tick)) >= 0)
+		{
+			uint32_t ritardo = ora - task->prossimo_tick;
+
+			if (ritardo < task->periodo_tick)
+			{
+				task->prossimo_tick = task->prossimo_tick + task->periodo_tick;
+			}
+			else
+			{
+				/* Periodi interi saltati: riparto dalla stessa fase */
+				task->prossimo_tick = task->prossimo_tick + (task->periodo_tick *
+						((ritardo / task->periodo_tick) + 1U));
+			}
+
+			if (task->differito == false)
+			{
+				task->funzione();
+			}
+			else if (task->in_attesa == true)
+			{
+				/* Il main loop è indietro di un periodo intero */
+				task_saltati++;
+			}
+			else
+			{
+				task->in_attesa = true;
+			}
+		}
+		else
+		{
+			/* Non succede niente, MISRA-2023-15.7 */
+		}
+	}
+
+	tick_corrente = ora + 1U;
+}
+
+/**
+ * @brief Esegue i task differiti richiesti dal side loop
+ *
+ * @details Da chiamare a ogni giro del main loop. La richiesta viene
+ * abbassata prima dell'esecuzione, così una nuova richiesta che arriva
+ * durante il task non va persa.
+ */
+void esegui_task_differiti(void)
+{
+	uint8_t n = n_task;
+
+	for (uint8_t indice = 0; indice < n; indice++)
+	{
+		task_periodico *task = &tabella_task[indice];
+
+		if (task->in_attesa == true)
+		{
+			task->in_attesa = false;
+			task->funzione();
+		}
+		else
+		{
+			/* Non succede niente, MISRA-2023-15.7 */
+		}
+	}
+}
+
+/**
+ * @brief Indica se un task differito attende il main loop
+ *
+ * @return bool true se esegui_task_differiti() ha almeno un task da eseguire
+ */
+bool ritorna_task_differiti_in_attesa(void)
+{
+	bool in_attesa = false;
+	uint8_t n = n_task;
+
+	for (uint8_t indice = 0; (indice < n) && (in_attesa == false); indice++)
+	{
+		in_attesa = tabella_task[indice].in_attesa;
+	}
+
+	return in_attesa;
+}
+
+/**
+ * @brief Ritorna il contatore dei tick del side loop
+ *
+ * @return uint32_t Tick nominali eseguiti, con riavvolgimento
+ */
+uint32_t ritorna_tick_corrente(void)
+{
+	return tick_corrente;
+}
+
+/**
+ * @brief Ritorna le esecuzioni differite perse
+ *
+ * @return uint32_t Numero di periodi in cui un task differito era ancora in
+ * attesa del main loop
+ */
+uint32_t ritorna_task_saltati(void)
+{
+	return task_saltati;
+}
+
+
+/****************** (C) COPYRIGHT GITSIM ***** END OF FILE *******************/
@@ -11,6 +11,18 @@
 #include "xuartps.h"
 #include "gestione_uart.h"
 #include "emulazione_encoder.h"
+#include "gestione_polling.h"
+#include "misura_isr.h"
+#include "canale_amp.h"
+#include "side.h"
+#include "gestione_task.h"
+#include "gestione_watchdog.h"
+#include "calcolo_crc.h"
+#include "xil_exception.h"
+#include "xpseudo_asm.h"
+
+/* Nella CPU1 della build AMP non c'è UART: il protocollo è su CPU0 */
+#if (RUOLO_CORE != RUOLO_CORE_ENCODER)
 
 
 /******************************************************************************
@@ -24,6 +36,56 @@
  */
 #define UART_BASEADDR 			XPAR_PS7_UART_0_BASEADDR
 
+/**
+ * @brief Numero di interrupt dell'UART
+ *
+ * Interrupt del GIC associato all'UART PS7 utilizzato per la comunicazione.
+ */
+#define UART_INTR_ID 			XPAR_XUARTPS_0_INTR
+
+/**
+ * @brief Dimensione della coda circolare di trasmissione
+ *
+ * Deve essere una potenza di 2, così l'indice si riavvolge con una maschera.
+ * Contiene diversi telegrammi di risposta completi.
+ */
+#define DIM_CODA_TX 			(uint16_t) 256
+
+/** @brief Maschera per riavvolgere gli indici della coda di trasmissione */
+#define MASCHERA_CODA_TX 		(uint16_t) (DIM_CODA_TX - 1U)
+
+/**
+ * @brief Dimensione della coda circolare di ricezione
+ *
+ * Deve essere una potenza di 2. Contiene diversi telegrammi di funzionamento,
+ * così un burst dell'applicazione non va perso mentre il main loop è occupato.
+ */
+#define DIM_CODA_RX 			(uint16_t) 256
+
+/** @brief Maschera per riavvolgere gli indici della coda di ricezione */
+#define MASCHERA_CODA_RX 		(uint16_t) (DIM_CODA_RX - 1U)
+
+/**
+ * @brief Soglia della FIFO RX dell'UART, in byte
+ *
+ * Quando la FIFO hardware (64 byte) raggiunge questo livello scatta
+ * l'interrupt di ricezione. Un telegramma di funzionamento sta sotto soglia
+ * e viene raccolto dal timeout di ricezione.
+ */
+#define SOGLIA_FIFO_RX 			(uint8_t) 32
+
+/**
+ * @brief Timeout di ricezione dell'UART
+ *
+ * Espresso in multipli di 4 tempi di bit: con 8U l'interrupt scatta dopo
+ * circa 3 caratteri di silenzio, cioè alla fine di ogni telegramma.
+ */
+#define TIMEOUT_RX 				(uint8_t) 8
+
+/** @brief Interrupt dell'UART utilizzati per la ricezione */
+#define INTERRUPT_RX 			(XUARTPS_IXR_RXOVR | XUARTPS_IXR_TOUT | \
+								 XUARTPS_IXR_RXFULL | XUARTPS_IXR_OVER)
+
 /**
  * @brief Lunghezza del telegramma di connessione
  *
@@ -34,6 +96,16 @@
  */
 #define L_TELEGRAMMA_CONN   	(uint16_t) 8
 
+/**
+ * @brief Lunghezza del telegramma di connessione esteso
+ *
+ * Il telegramma di connessione seguito dal periodo del tick in nanosecondi
+ * (4 byte, little endian; 0 per il periodo predefinito). Esiste solo in
+ * trama, dove la lunghezza lo distingue da quello classico: senza trama il
+ * telegramma di connessione è sempre di L_TELEGRAMMA_CONN byte.
+ */
+#define L_TELEGRAMMA_CONN_ESTESO	(uint16_t) 12
+
 /**
  * @brief Lunghezza del telegramma di funzionamento
  *
@@ -53,6 +125,16 @@
  */
 #define L_TELEGRAMMA_RISP   	(uint16_t) 13
 
+/**
+ * @brief Lunghezza del telegramma di risposta esteso
+ *
+ * Contiene, little endian: numero di sequenza (4 byte), tick del side loop
+ * al campionamento (4 byte), velocità encoder 1 e 2 (4 byte ciascuna),
+ * conteggio cumulativo encoder 1 e 2 (8 byte ciascuno, con segno) e
+ * l'identificativo IDENTIFICATIVO_RISPOSTA_ESTESA.
+ */
+#define L_TELEGRAMMA_RISP_ESTESA 	(uint16_t) 33
+
 
 /**
  * @brief Lunghezza della sezione valore nel telegramma di funzionamento
@@ -72,6 +154,15 @@
  */
 #define L_FUNZ_ADDON   			(uint16_t) 5
 
+/**
+ * @brief Addon del tick programmato
+ *
+ * I primi 4 byte dell'addon sono il tick del side loop (little endian) in
+ * cui applicare i comandi del valore, nella numerazione dei telegrammi di
+ * risposta estesi e di telemetria.
+ */
+#define ADDON_TICK_PROGRAMMATO 	(uint8_t) 0x01
+
 /**
  * @brief Diametro massimo consentito per la ruota
  *
@@ -108,6 +199,163 @@
  */
 #define IDENTIFICATIVO_RISPOSTA 	(uint8_t) 218
 
+/**
+ * @brief Valore fisso da mandare come ultimo byte nel telegramma di risposta
+ * esteso
+ */
+#define IDENTIFICATIVO_RISPOSTA_ESTESA 	(uint8_t) 221
+
+/**
+ * @brief Lunghezza del telegramma di negoziazione del baud rate
+ *
+ * Contiene, little endian: baud rate richiesto (4 byte), baud rate
+ * effettivo dato dai divisori (4 byte), esito (1 byte), gettone del
+ * telegramma di prova (4 byte), tick del side loop (4 byte), byte persi e
+ * trame scartate durante la verifica (4 byte) e l'identificativo
+ * IDENTIFICATIVO_BAUD.
+ */
+#define L_TELEGRAMMA_BAUD 			(uint16_t) 22
+
+/** @brief Valore fisso da mandare come ultimo byte nel telegramma baud */
+#define IDENTIFICATIVO_BAUD 		(uint8_t) 222
+
+/** @brief Esito: baud rate non realizzabile, resta quello corrente */
+#define BAUD_RIFIUTATO 				(uint8_t) 0
+
+/** @brief Esito: il baud rate cambia subito dopo questo telegramma */
+#define BAUD_ACCETTATO 				(uint8_t) 1
+
+/** @brief Esito: telegramma di prova ricevuto, mandato al nuovo baud rate */
+#define BAUD_CONFERMATO 			(uint8_t) 2
+
+/** @brief Esito: prova non arrivata, mandato al baud rate precedente */
+#define BAUD_RIPRISTINATO 			(uint8_t) 3
+
+/**
+ * @brief Baud rate massimo negoziabile
+ *
+ * Divisori 4 e 5 sul clock di riferimento dell'UART; oltre l'errore di
+ * quantizzazione dei divisori cresce troppo.
+ */
+#define BAUD_MASSIMO 				(XPAR_PS7_UART_0_UART_CLK_FREQ_HZ / 20U)
+
+/** @brief Errore massimo tra baud rate richiesto ed effettivo, in percento */
+#define ERRORE_MAX_BAUD_PERCENTO 	3U
+
+/** @brief Attesa del telegramma di prova dopo il cambio, in secondi */
+#define TIMEOUT_VERIFICA_BAUD 		0.5f
+
+/** @brief Secondo valore del telegramma di prova, fisso */
+#define SCHEMA_PROVA_BAUD 			0x0FF0AA55U
+
+/** @brief Formato di risposta classico, di L_TELEGRAMMA_RISP byte */
+#define RISPOSTA_CLASSICA 			(uint8_t) 0
+
+/** @brief Formato di risposta esteso, di L_TELEGRAMMA_RISP_ESTESA byte */
+#define RISPOSTA_ESTESA 			(uint8_t) 1
+
+/**
+ * @brief Valore fisso da mandare come ultimo byte nel telegramma di telemetria
+ *
+ * Il telegramma di telemetria contiene il tick del side loop (4 byte, little
+ * endian), la maschera dei campi (1 byte), i campi richiesti nell'ordine dei
+ * loro bit e questo identificativo.
+ */
+#define IDENTIFICATIVO_TELEMETRIA 	(uint8_t) 220
+
+/** @brief Campo di telemetria: velocità degli encoder, 4 byte ciascuna */
+#define TELEMETRIA_VELOCITA 		(uint8_t) 0x01
+
+/**
+ * @brief Campo di telemetria: conteggi cumulativi degli encoder, 8 byte
+ * ciascuno con segno, come nella risposta estesa
+ */
+#define TELEMETRIA_CONTEGGI 		(uint8_t) 0x02
+
+/**
+ * @brief Campo di telemetria: telegrammi TX scartati e byte RX persi, 4 byte
+ * ciascuno
+ */
+#define TELEMETRIA_DIAGNOSTICA 		(uint8_t) 0x04
+
+/** @brief Maschera di tutti i campi di telemetria esistenti */
+#define TELEMETRIA_TUTTI 			(uint8_t) (TELEMETRIA_VELOCITA | \
+									TELEMETRIA_CONTEGGI | TELEMETRIA_DIAGNOSTICA)
+
+/** @brief Byte di telemetria sempre presenti: tick, maschera e identificativo */
+#define L_TELEMETRIA_BASE 			(uint16_t) 6
+
+/** @brief Lunghezza del telegramma di telemetria con tutti i campi */
+#define L_TELEMETRIA_MAX 			(uint16_t) 38
+
+/** @brief Periodo del task di telemetria finché non viene richiesta */
+#define PERIODO_TELEMETRIA_SPENTA 	0.05f
+
+/**
+ * @brief Frequenza minima della telemetria continua, in Hz
+ *
+ * Una frequenza più bassa viene alzata a questa: il periodo resta di pochi
+ * milioni di tick anche con il tick più corto.
+ */
+#define FREQUENZA_TELEMETRIA_MIN 	0.1f
+
+/** @brief Budget del task di telemetria, in microsecondi: va nel side loop */
+#define BUDGET_TELEMETRIA 			2U
+
+/** @brief Tempi di bit per carattere sulla linea seriale, formato 8N1 */
+#define BIT_PER_CARATTERE 			10U
+
+#if (MISURA_LATENZA_ISR == 1U)
+/**
+ * @brief Lunghezza del telegramma con un istogramma del side loop
+ *
+ * Contiene l'istogramma serializzato da serializza_istogramma_isr() e
+ * l'identificativo IDENTIFICATIVO_ISTOGRAMMA come ultimo byte.
+ */
+#define L_TELEGRAMMA_ISTOGRAMMA 	(uint16_t) (L_ISTOGRAMMA_SERIALIZZATO + 1U)
+
+/** @brief Valore fisso da mandare come ultimo byte nel telegramma istogramma */
+#define IDENTIFICATIVO_ISTOGRAMMA 	(uint8_t) 219
+
+/** @brief Valore di istogramma_richiesto senza richieste in attesa */
+#define NESSUN_ISTOGRAMMA 			(uint8_t) 0xFF
+
+/** @brief Telegramma più lungo mandato all'applicazione */
+#define L_TELEGRAMMA_TX_MAX 		L_TELEGRAMMA_ISTOGRAMMA
+#else
+/** @brief Telegramma più lungo mandato all'applicazione */
+#define L_TELEGRAMMA_TX_MAX 		L_TELEMETRIA_MAX
+#endif
+
+/**
+ * @brief Primo byte di una trama
+ *
+ * Una trama è fatta da INIZIO_TRAMA, lunghezza del telegramma (1 byte),
+ * telegramma e CRC-16/CCITT-FALSE di lunghezza e telegramma (2 byte, little
+ * endian). Il telegramma è lo stesso del protocollo senza trama.
+ */
+#define INIZIO_TRAMA 				(uint8_t) 0xA5
+
+/** @brief Byte della trama prima del telegramma: inizio e lunghezza */
+#define L_INTESTAZIONE_TRAMA 		(uint16_t) 2
+
+/** @brief Byte aggiunti dalla trama al telegramma: intestazione e CRC */
+#define L_CORNICE_TRAMA 			(uint16_t) 4
+
+/** @brief Encoder comandati dal protocollo, ENCODER_1 ed ENCODER_2 */
+#define N_ENCODER_PROTOCOLLO 		2U
+
+/**
+ * @brief Periodo di aggiornamento della configurazione da ripristinare
+ *
+ * Con un'accelerazione in corso la velocità salvata è al più vecchia di un
+ * periodo.
+ */
+#define PERIODO_SALVA_RIPRISTINO 	0.1f
+
+/** @brief Budget del salvataggio, in microsecondi: va nel main loop */
+#define BUDGET_SALVA_RIPRISTINO 	20U
+
 
 /**
  * @brief Unione per la conversione tra float e array di byte
@@ -137,6 +385,84 @@ union uint16_bytes {
     uint8_t bytes[sizeof(uint16_t)];
 };
 
+/** @brief Contenuto della coda di ricezione secondo esamina_coda_rx() */
+typedef enum
+{
+	/** @brief Telegramma o trama non ancora completi */
+	CODA_INCOMPLETA = 0,
+
+	/** @brief Telegramma senza trama, in testa alla coda */
+	CODA_TELEGRAMMA,
+
+	/** @brief Trama valida, in testa alla coda */
+	CODA_TRAMA,
+
+	/** @brief Byte fuori trama da scartare */
+	CODA_RUMORE,
+
+	/** @brief Trama con CRC non valido o di tipo non atteso, da scartare */
+	CODA_TRAMA_ERRATA,
+
+	/** @brief INIZIO_TRAMA seguito da una lunghezza non valida */
+	CODA_LUNGHEZZA_ERRATA
+
+} esito_coda_rx;
+
+/** @brief Fasi della negoziazione del baud rate */
+typedef enum
+{
+	/** @brief Nessuna negoziazione in corso */
+	BAUD_STABILE = 0,
+
+	/** @brief Telegramma baud composto, da accodare dal side loop */
+	BAUD_DA_ANNUNCIARE,
+
+	/** @brief Side loop sospeso, cambio appena la trasmissione è finita */
+	BAUD_IN_CAMBIO,
+
+	/** @brief Nuovo baud rate attivo, in attesa del telegramma di prova */
+	BAUD_IN_VERIFICA
+
+} fase_negoziazione_baud;
+
+/**
+ * @brief Ultima configurazione nota, ripristinata dopo un reset del watchdog
+ *
+ * @details Il telegramma di connessione viene conservato così com'è e
+ * ripassato da leggi_telegramma_di_connessione(), con gli stessi controlli
+ * dei limiti.
+ */
+typedef struct
+{
+	/** @brief Lunghezza del telegramma di connessione, 0 se scollegati */
+	uint16_t lunghezza_connessione;
+
+	/** @brief true se l'applicazione usa il protocollo con trama */
+	bool con_trama;
+
+	/** @brief Ultimo telegramma di connessione accettato */
+	uint8_t telegramma_connessione[L_TELEGRAMMA_CONN_ESTESO];
+
+	/** @brief Velocità degli encoder, in m/s */
+	float_t velocita[N_ENCODER_PROTOCOLLO];
+
+	/** @brief Ultima accelerazione assegnata agli encoder, in m/s^2 */
+	float_t accelerazione[N_ENCODER_PROTOCOLLO];
+
+	/** @brief Frequenza della telemetria continua richiesta, in Hz */
+	float_t frequenza_telemetria;
+
+	/** @brief Campi della telemetria continua, 0 se non richiesta */
+	uint8_t maschera_telemetria;
+
+	/** @brief Formato della risposta, RISPOSTA_CLASSICA o RISPOSTA_ESTESA */
+	uint8_t formato_risposta;
+
+	/** @brief Baud rate negoziato, 0 per quello predefinito */
+	uint32_t baud_rate;
+
+} configurazione_ripristino;
+
 
 /******************************************************************************
  * STATIC VARIABLES
@@ -173,14 +499,192 @@ static bool stato_connessione_app = false;
  */
 static bool handshake_avvenuto = false;
 
+/**
+ * @brief Coda circolare dei byte da trasmettere
+ *
+ * Riempita dal side loop con il telegramma di risposta e svuotata
+ * dall'interrupt di FIFO TX vuota dell'UART. Ha un solo produttore e un solo
+ * consumatore, entrambi in contesto di interrupt.
+ */
+static uint8_t coda_tx[DIM_CODA_TX];
+
+/** @brief Indice del prossimo byte da scrivere, modificato dal produttore */
+static volatile uint16_t indice_scrittura_tx = 0;
+
+/** @brief Indice del prossimo byte da trasmettere, modificato dal consumatore */
+static volatile uint16_t indice_lettura_tx = 0;
+
+/**
+ * @brief Telegrammi di risposta scartati per coda di trasmissione piena
+ *
+ * Cresce se il collegamento seriale non riesce a smaltire i telegrammi alla
+ * frequenza con cui il side loop li produce.
+ */
+static uint32_t telegrammi_tx_scartati = 0;
+
+/**
+ * @brief Coda circolare dei byte ricevuti
+ *
+ * Riempita dall'interrupt UART e svuotata dal main loop, che ne estrae solo
+ * telegrammi completi. Ha un solo produttore e un solo consumatore, quindi
+ * non servono lock né sezioni critiche.
+ */
+static uint8_t coda_rx[DIM_CODA_RX];
+
+/** @brief Indice del prossimo byte da scrivere, modificato dall'interrupt */
+static volatile uint16_t indice_scrittura_rx = 0;
+
+/** @brief Indice del prossimo byte da leggere, modificato dal main loop */
+static volatile uint16_t indice_lettura_rx = 0;
+
+/**
+ * @brief Byte ricevuti e persi
+ *
+ * Somma dei byte scartati per coda di ricezione piena e degli overrun della
+ * FIFO hardware.
+ */
+static volatile uint32_t byte_rx_persi = 0;
+
+/**
+ * @brief true se l'applicazione collegata usa le trame
+ *
+ * Deciso dal telegramma di connessione: se arriva in una trama valida anche
+ * i telegrammi successivi e le risposte viaggiano in trama, altrimenti resta
+ * il protocollo a lunghezza fissa dell'applicazione esistente.
+ */
+static volatile bool protocollo_con_trama = false;
+
+/**
+ * @brief Trame scartate per CRC o lunghezza non validi
+ *
+ * Dopo una trama scartata il parser cerca il prossimo INIZIO_TRAMA a partire
+ * dal byte successivo, quindi si risincronizza entro una trama.
+ */
+static uint32_t trame_errate = 0;
+
+/**
+ * @brief Campi della telemetria continua, 0 se non richiesta
+ *
+ * Scritta dal main loop alla sottoscrizione, letta dal task di telemetria
+ * nel side loop.
+ */
+static volatile uint8_t maschera_telemetria = 0;
+
+/**
+ * @brief Formato del telegramma di risposta, RISPOSTA_CLASSICA o
+ * RISPOSTA_ESTESA
+ *
+ * Scritto dal main loop, letto dal side loop. Ogni nuova connessione riparte
+ * dal formato classico.
+ */
+static volatile uint8_t formato_risposta = RISPOSTA_CLASSICA;
+
+/**
+ * @brief Numero di sequenza dell'ultima risposta estesa
+ *
+ * Cresce di uno per ogni risposta estesa composta, anche se poi viene
+ * scartata per coda piena: un salto nella sequenza ricevuta è una risposta
+ * persa.
+ */
+static uint32_t sequenza_risposta = 0;
+
+/**
+ * @brief Fase della negoziazione del baud rate
+ *
+ * Scritta dal main loop, tranne il passaggio da BAUD_DA_ANNUNCIARE, fatto
+ * dal side loop quando accoda il telegramma baud.
+ */
+static volatile fase_negoziazione_baud fase_baud = BAUD_STABILE;
+
+/**
+ * @brief true se il side loop non deve accodare telegrammi
+ *
+ * Alta dall'annuncio del cambio fino alla conferma o al ripristino: in quel
+ * tratto il main loop è l'unico produttore della coda di trasmissione e
+ * l'applicazione vede solo telegrammi baud.
+ */
+static volatile bool trasmissione_sospesa = false;
+
+/** @brief Telegramma baud composto dal main loop e accodato dal side loop */
+static uint8_t telegramma_baud[L_TELEGRAMMA_BAUD];
+
+/** @brief Baud rate da impostare in BAUD_IN_CAMBIO */
+static uint32_t baud_obiettivo;
+
+/** @brief Baud rate a cui tornare se la verifica fallisce */
+static uint32_t baud_precedente;
+
+/** @brief true se dopo il cambio serve il telegramma di prova */
+static bool verifica_baud;
+
+/** @brief Tick del side loop al cambio del baud rate */
+static uint32_t tick_cambio_baud;
+
+/** @brief Byte persi e trame scartate al cambio del baud rate */
+static uint32_t errori_al_cambio_baud;
+
+#if (MISURA_LATENZA_ISR == 1U)
+/**
+ * @brief Istogramma richiesto dall'applicazione, da mandare con la prossima
+ * risposta
+ *
+ * Scritto dal main loop, letto e azzerato dal side loop, che è l'unico
+ * produttore della coda di trasmissione.
+ */
+static volatile uint8_t istogramma_richiesto = NESSUN_ISTOGRAMMA;
+
+/** @brief true se gli istogrammi vanno azzerati dopo l'invio */
+static volatile bool reset_dopo_istogramma = false;
+#endif
+
+/**
+ * @brief Configurazione da salvare per il ripristino
+ *
+ * Modificata solo dal main loop, dai telegrammi e da
+ * salva_configurazione_ripristino().
+ */
+static configurazione_ripristino configurazione_corrente;
+
 
 /******************************************************************************
  * STATIC FUNCTION PROTOTYPES
  *****************************************************************************/
-static void  leggi_telegramma_di_connessione(void);
-static void leggi_telegramma_funzionamento(void);
+static void leggi_telegramma_di_connessione(const uint8_t *byte_ricevuti,
+											uint16_t lunghezza);
+static void leggi_telegramma_funzionamento(const uint8_t *byte_ricevuti);
+static bool ritorna_comando_programmabile(uint8_t identificatore);
 static void azione_funzionamento_valore(uint8_t identificatore,
 										const uint8_t *array_stringa);
+static bool accoda_tx(const uint8_t *dati, uint16_t lunghezza);
+static bool accoda_telegramma(const uint8_t *telegramma, uint16_t lunghezza);
+static uint16_t ritorna_lunghezza_telemetria(uint8_t maschera);
+static void assegna_telemetria(float_t frequenza, uint8_t maschera);
+static void manda_telemetria_continua(void);
+static uint16_t componi_risposta_classica(uint8_t *buffer);
+static uint16_t componi_risposta_estesa(uint8_t *buffer);
+static uint32_t ritorna_clock_baud(void);
+static bool calcola_divisori_baud(uint32_t baud, uint32_t *generatore,
+								  uint32_t *divisore);
+static bool imposta_baud_uart(uint32_t baud);
+static uint32_t ritorna_baud_effettivo(void);
+static bool ritorna_trasmissione_finita(void);
+static void componi_telegramma_baud(uint32_t richiesto, uint8_t esito,
+									uint32_t gettone);
+static void manda_telegramma_baud_main(void);
+static void richiedi_baud(uint32_t baud);
+static void conferma_baud(const uint8_t array_stringa[]);
+static void ripristina_baud_predefinito(void);
+static void servi_negoziazione_baud(void);
+static void svuota_coda_tx(void);
+static void gestore_interrupt_uart(void *riferimento);
+static void riempi_coda_rx(void);
+static uint16_t ritorna_byte_disponibili_rx(void);
+static void estrai_coda_rx(uint8_t *destinazione, uint16_t lunghezza);
+static uint8_t leggi_byte_coda_rx(uint16_t posizione);
+static void scarta_coda_rx(uint16_t lunghezza);
+static esito_coda_rx esamina_trama(uint16_t disponibili, uint16_t *lunghezza);
+static esito_coda_rx esamina_coda_rx(uint16_t *lunghezza);
+static void salva_configurazione_ripristino(void);
 
 
 /******************************************************************************
@@ -190,36 +694,23 @@ static void azione_funzionamento_valore(uint8_t identificatore,
 /**
  * @brief Legge il telegramma di connessione dall'applicazione
  *
- * Questa funzione riceve e processa il telegramma di connessione inviato dall'
+ * @param byte_ricevuti Telegramma completo
+ * @param lunghezza L_TELEGRAMMA_CONN o L_TELEGRAMMA_CONN_ESTESO
+ *
+ * Questa funzione processa il telegramma di connessione inviato dall'
  * applicazione. Il telegramma contiene informazioni sul diametro della ruota
- * e sui ppr degli encoder. La funzione verifica che questi valori rientrino
- * nei limiti accettabili  e, se validi, li assegna agli encoder e aggiorna
- * lo stato della connessione.
+ * e sui ppr degli encoder, e nella versione estesa il periodo del tick. La
+ * funzione verifica che questi valori rientrino nei limiti accettabili  e,
+ * se validi, li assegna agli encoder e aggiorna lo stato della connessione.
+ * Il telegramma classico riporta il tick al periodo predefinito.
  */
-static void leggi_telegramma_di_connessione()
+static void leggi_telegramma_di_connessione(const uint8_t byte_ricevuti[],
+											uint16_t lunghezza)
 {
-	uint16_t n_byte_ricevuti = 0;
-	uint8_t byte_ricevuti[L_TELEGRAMMA_CONN];
 	union float_bytes diametro;
 	union uint16_bytes ppr1;
 	union uint16_bytes ppr2;
-
-	do {
-		/* Attendo che un byte arrivi */
-		while (!(XUartPs_IsReceiveData(Uart_Ps.Config.BaseAddress)))
-		{
-			/* Wait */
-		}
-
-		/* Leggi byte ricevuto*/
-		uint8_t byte = XUartPs_ReadReg(Uart_Ps.Config.BaseAddress,
-										XUARTPS_FIFO_OFFSET) & 0xFF;
-
-		/* Salva byte ricevuto nel buffer */
-		byte_ricevuti[n_byte_ricevuti] = byte;
-		n_byte_ricevuti++;
-
-	}while(n_byte_ricevuti != L_TELEGRAMMA_CONN);
+	uint32_t periodo_ns = 0;
 
 
 	/* Estraggo diametro della ruota (little endian)*/
@@ -231,6 +722,19 @@ static void leggi_telegramma_di_connessione()
 	/* Estraggo ppr encoder 2 (little endian)*/
 	(void) memcpy(ppr2.bytes, &byte_ricevuti[6], sizeof(uint16_t));
 
+	/* Estraggo il periodo del tick, solo nel telegramma esteso */
+	if (lunghezza >= L_TELEGRAMMA_CONN_ESTESO)
+	{
+		periodo_ns = ((uint32_t) byte_ricevuti[8]) |
+					 (((uint32_t) byte_ricevuti[9]) << 8U) |
+					 (((uint32_t) byte_ricevuti[10]) << 16U) |
+					 (((uint32_t) byte_ricevuti[11]) << 24U);
+	}
+	else
+	{
+		/* Telegramma classico, periodo predefinito */
+	}
+
 	/* Controllo se i parametri rientrano nei valori corretti */
 	if(	(diametro.value > MAX_DIAMETRO_RUOTA) ||
 		(diametro.value < MIN_DIAMETRO_RUOTA) )
@@ -250,16 +754,30 @@ static void leggi_telegramma_di_connessione()
 		/* ppr 2 fuori dai limiti accettabili */
 		stato_connessione_app = false;
 	}
+	else if (assegna_periodo_side_loop(((float_t) periodo_ns) * 1e-9f) == false)
+	{
+		/* Periodo fuori dai limiti o troppo corto per il costo del tick */
+		stato_connessione_app = false;
+	}
 	else
 	{
 		/* I controlli sono passati, assegno i parametri agli encoder */
-		assegna_ppr_encoder1(ppr1.value);
-		assegna_ppr_encoder2(ppr2.value);
+		apri_comandi_encoder();
+		assegna_ppr_encoder(ENCODER_1, ppr1.value);
+		assegna_ppr_encoder(ENCODER_2, ppr2.value);
 		assegna_diametro_ruota(diametro.value);
-		aggiorna_passo_encoder1();
-		aggiorna_passo_encoder2();
+		aggiorna_passo_encoder(ENCODER_1);
+		aggiorna_passo_encoder(ENCODER_2);
+		chiudi_comandi_encoder();
 		/* Imposta lo stato di connessione a true */
 		stato_connessione_app = true;
+
+		/* Gli encoder ripartono fermi: è questa la configurazione nota */
+		(void) memset(&configurazione_corrente, 0,
+					  sizeof(configurazione_corrente));
+		(void) memcpy(configurazione_corrente.telegramma_connessione,
+					  byte_ricevuti, lunghezza);
+		configurazione_corrente.lunghezza_connessione = lunghezza;
 	}
 
 }
@@ -267,52 +785,75 @@ static void leggi_telegramma_di_connessione()
 /**
  * @brief Legge il telegramma di funzionamento dall'UART
  *
- * @details Questa funzione legge un telegramma di funzionamento dall'UART,
- * estrae i dati e gli identificatori per il valore e l'addon, ed esegue
- * l'azione corrispondente al valore ricevuto.
+ * @param byte_ricevuti Telegramma completo di L_TELEGRAMMA_FUNZ byte
+ *
+ * @details Questa funzione processa un telegramma di funzionamento ricevuto
+ * dall'UART, estrae i dati e gli identificatori per il valore e l'addon, ed
+ * esegue l'azione corrispondente al valore ricevuto. Con l'addon
+ * ADDON_TICK_PROGRAMMATO i comandi di cinematica vengono accodati e
+ * applicati dal side loop al tick indicato.
  */
-static void leggi_telegramma_funzionamento()
+static void leggi_telegramma_funzionamento(const uint8_t byte_ricevuti[])
 {
-	uint16_t n_byte_ricevuti = 0;
-	uint8_t byte_ricevuti[L_TELEGRAMMA_FUNZ];
 	uint8_t identificatore_valore;
 	uint8_t stringa_valore[L_FUNZ_VALORE];
-
-	/* TODO Aggiungere le funzioni per l'addon */
 	uint8_t stringa_addon[L_FUNZ_ADDON];
 	uint8_t identificatore_addon;
 
-
-	do {
-		/* Attendo che un byte arrivi */
-		while (!(XUartPs_IsReceiveData(Uart_Ps.Config.BaseAddress)))
-		{
-			/* Wait */
-		}
-
-		/* Leggi byte ricevuto*/
-		uint8_t byte = XUartPs_ReadReg(Uart_Ps.Config.BaseAddress,
-										XUARTPS_FIFO_OFFSET) & 0xFF;
-
-		/* Salva byte ricevuto*/
-		byte_ricevuti[n_byte_ricevuti] = byte;
-		n_byte_ricevuti++;
-
-	}while(n_byte_ricevuti != L_TELEGRAMMA_FUNZ);
-
 	/* Estraggo identificatore telegramma valore */
 	identificatore_valore = byte_ricevuti[L_FUNZ_VALORE - 1U];
 	(void) memcpy(&stringa_valore, &byte_ricevuti[0],
 			sizeof(uint8_t) * L_FUNZ_VALORE);
-	azione_funzionamento_valore(identificatore_valore, stringa_valore);
-
 
-	/* Estraggo identificatore telegramma addon */
-	identificatore_addon = byte_ricevuti[L_FUNZ_ADDON - 1U];
-	(void) memcpy(&stringa_valore, &byte_ricevuti[L_FUNZ_VALORE - 1U],
+	/* Estraggo identificatore telegramma addon, in coda al valore */
+	identificatore_addon = byte_ricevuti[L_TELEGRAMMA_FUNZ - 1U];
+	(void) memcpy(&stringa_addon, &byte_ricevuti[L_FUNZ_VALORE],
 			sizeof(uint8_t) * L_FUNZ_ADDON);
 
+	if ((identificatore_addon == ADDON_TICK_PROGRAMMATO) &&
+		(ritorna_comando_programmabile(identificatore_valore) == true))
+	{
+		uint32_t tick = (uint32_t) stringa_addon[0] |
+						((uint32_t) stringa_addon[1] << 8U) |
+						((uint32_t) stringa_addon[2] << 16U) |
+						((uint32_t) stringa_addon[3] << 24U);
+
+		/* Il side loop applica i comandi proprio al tick richiesto */
+		if (apri_comandi_programmati(tick) == true)
+		{
+			azione_funzionamento_valore(identificatore_valore, stringa_valore);
+			chiudi_comandi_programmati();
+		}
+		else
+		{
+			/* Coda piena: comando scartato e contato dagli encoder */
+		}
+	}
+	else
+	{
+		/* Tutti i comandi del telegramma hanno effetto sullo stesso tick */
+		apri_comandi_encoder();
+		azione_funzionamento_valore(identificatore_valore, stringa_valore);
+		chiudi_comandi_encoder();
+	}
+
+	/* Il prossimo reset del watchdog riparte da questo telegramma */
+	salva_configurazione_ripristino();
+}
 
+/**
+ * @brief Indica se un comando può essere programmato a un tick
+ *
+ * @param identificatore Identificatore del valore del telegramma
+ * @return bool true per i comandi di cinematica, da 0x01 a 0x06 e 0x08
+ *
+ * @details Gli altri comandi non passano dalla casella degli encoder e
+ * vengono eseguiti subito anche con l'addon del tick programmato.
+ */
+static bool ritorna_comando_programmabile(uint8_t identificatore)
+{
+	return (((identificatore >= 0x01U) && (identificatore <= 0x06U)) ||
+			(identificatore == 0x08U));
 }
 
 /**
@@ -343,14 +884,16 @@ static void azione_funzionamento_valore(uint8_t identificatore,
 	    case 0x01U:
 	        (void) memcpy(dato_valore1.bytes, &array_stringa[0],
 	        		sizeof(float_t));
-	        assegna_velocita_encoder1(dato_valore1.value);
+	        assegna_velocita_encoder(ENCODER_1, dato_valore1.value);
+	        configurazione_corrente.velocita[ENCODER_1] = dato_valore1.value;
 	        break;
 
 		/* Telegramma assegnazione velocità su encoder 2 */
 	    case 0x02U:
 	        (void) memcpy(dato_valore2.bytes, &array_stringa[4],
 	        		sizeof(float_t));
-	        assegna_velocita_encoder2(dato_valore2.value);
+	        assegna_velocita_encoder(ENCODER_2, dato_valore2.value);
+	        configurazione_corrente.velocita[ENCODER_2] = dato_valore2.value;
 	        break;
 
 		/* Telegramma assegnazione velocità su entrambi gli encoder */
@@ -359,22 +902,26 @@ static void azione_funzionamento_valore(uint8_t identificatore,
 	        		sizeof(float_t));
 	        (void) memcpy(dato_valore2.bytes, &array_stringa[4],
 	        		sizeof(float_t));
-	        assegna_velocita_encoder1(dato_valore1.value);
-	        assegna_velocita_encoder2(dato_valore2.value);
+	        assegna_velocita_encoder(ENCODER_1, dato_valore1.value);
+	        assegna_velocita_encoder(ENCODER_2, dato_valore2.value);
+	        configurazione_corrente.velocita[ENCODER_1] = dato_valore1.value;
+	        configurazione_corrente.velocita[ENCODER_2] = dato_valore2.value;
 	        break;
 
 		/* Telegramma assegnazione accelerazione su encoder 1 */
 	    case 0x04U:
 	        (void) memcpy(dato_valore1.bytes, &array_stringa[0],
 	        		sizeof(float_t));
-	        assegna_accelerazione_encoder1(dato_valore1.value);
+	        assegna_accelerazione_encoder(ENCODER_1, dato_valore1.value);
+	        configurazione_corrente.accelerazione[ENCODER_1] = dato_valore1.value;
 	        break;
 
 	    /* Telegramma assegnazione accelerazione su encoder 2 */
 	    case 0x05U:
 	        (void) memcpy(dato_valore2.bytes, &array_stringa[4],
 	        		sizeof(float_t));
-	        assegna_accelerazione_encoder2(dato_valore2.value);
+	        assegna_accelerazione_encoder(ENCODER_2, dato_valore2.value);
+	        configurazione_corrente.accelerazione[ENCODER_2] = dato_valore2.value;
 	        break;
 
 	    /* Telegramma assegnazione accelerazione su entrambi gli encoder */
@@ -383,8 +930,10 @@ static void azione_funzionamento_valore(uint8_t identificatore,
 	        		sizeof(float_t));
 	        (void) memcpy(dato_valore2.bytes, &array_stringa[4],
 	        		sizeof(float_t));
-	        assegna_accelerazione_encoder1(dato_valore1.value);
-	        assegna_accelerazione_encoder2(dato_valore2.value);
+	        assegna_accelerazione_encoder(ENCODER_1, dato_valore1.value);
+	        assegna_accelerazione_encoder(ENCODER_2, dato_valore2.value);
+	        configurazione_corrente.accelerazione[ENCODER_1] = dato_valore1.value;
+	        configurazione_corrente.accelerazione[ENCODER_2] = dato_valore2.value;
 	        break;
 
 		/* Telegramma per disconnettersi dall'applicazione */
@@ -392,14 +941,75 @@ static void azione_funzionamento_valore(uint8_t identificatore,
 	        inizializza_variabili_encoder();
 	        stato_connessione_app = false;
 	        handshake_avvenuto = false;
+	        configurazione_corrente.lunghezza_connessione = 0;
+	        assegna_telemetria(0.0f, 0U);
+	        formato_risposta = RISPOSTA_CLASSICA;
+	        configurazione_corrente.formato_risposta = RISPOSTA_CLASSICA;
+	        ripristina_baud_predefinito();
 	        break;
 
 	    /* Telegramma per resettare la cinematica degli encoder */
 	    case 0x08U:
-	        assegna_accelerazione_encoder1(0);
-	        assegna_accelerazione_encoder2(0);
-	        assegna_velocita_encoder1(0);
-	        assegna_velocita_encoder2(0);
+	        for(uint8_t indice = 0; indice < N_ENCODER; indice++)
+	        {
+	        	assegna_accelerazione_encoder(indice, 0);
+	        	assegna_velocita_encoder(indice, 0);
+	        }
+	        (void) memset(configurazione_corrente.velocita, 0,
+	        			  sizeof(configurazione_corrente.velocita));
+	        (void) memset(configurazione_corrente.accelerazione, 0,
+	        			  sizeof(configurazione_corrente.accelerazione));
+	        break;
+
+#if (MISURA_LATENZA_ISR == 1U)
+	    /* Telegramma richiesta istogramma del side loop */
+	    case 0x09U:
+	        if (array_stringa[0] < N_ISTOGRAMMI)
+	        {
+	        	reset_dopo_istogramma = (array_stringa[1] != 0U);
+	        	istogramma_richiesto = array_stringa[0];
+	        }
+	        else
+	        {
+	        	/* Istogramma inesistente, MISRA-2023-15.7 */
+	        }
+	        break;
+#endif
+
+	    /*
+	     * Telegramma sottoscrizione della telemetria continua: frequenza in
+	     * Hz nel primo valore, maschera dei campi nel byte successivo
+	     */
+	    case 0x0AU:
+	        (void) memcpy(dato_valore1.bytes, &array_stringa[0],
+	        		sizeof(float_t));
+	        assegna_telemetria(dato_valore1.value, array_stringa[4]);
+	        break;
+
+	    /* Telegramma scelta del formato di risposta, nel primo byte */
+	    case 0x0BU:
+	        if (array_stringa[0] <= RISPOSTA_ESTESA)
+	        {
+	        	formato_risposta = array_stringa[0];
+	        	configurazione_corrente.formato_risposta = array_stringa[0];
+	        }
+	        else
+	        {
+	        	/* Formato inesistente, MISRA-2023-15.7 */
+	        }
+	        break;
+
+	    /* Telegramma richiesta di un baud rate, intero nel primo valore */
+	    case 0x0CU:
+	        richiedi_baud((uint32_t) array_stringa[0] |
+	        			  ((uint32_t) array_stringa[1] << 8U) |
+	        			  ((uint32_t) array_stringa[2] << 16U) |
+	        			  ((uint32_t) array_stringa[3] << 24U));
+	        break;
+
+	    /* Telegramma di prova del nuovo baud rate */
+	    case 0x0DU:
+	        conferma_baud(array_stringa);
 	        break;
 
 	    default:
@@ -410,21 +1020,1233 @@ static void azione_funzionamento_valore(uint8_t identificatore,
 
 
 
-/************************************
- * GLOBAL FUNCTIONS
- ************************************/
-
-void leggi_telegramma()
+/**
+ * @brief Copia un telegramma nella coda di trasmissione
+ *
+ * @param dati Byte da trasmettere
+ * @param lunghezza Numero di byte da trasmettere
+ * @return bool true se il telegramma è stato accodato, false se la coda non
+ * ha spazio sufficiente
+ *
+ * @details Il telegramma viene accodato solo se c'è spazio per intero, così
+ * il ricevitore non vede mai telegrammi troncati. L'indice di scrittura viene
+ * pubblicato dopo la copia dei dati.
+ */
+static bool accoda_tx(const uint8_t *dati, uint16_t lunghezza)
 {
-	if(stato_connessione_app == false)
+	bool accodato = false;
+	uint16_t scrittura = indice_scrittura_tx;
+	uint16_t occupati = (scrittura - indice_lettura_tx) & MASCHERA_CODA_TX;
+
+	/* Lascio sempre un byte libero per distinguere coda piena e vuota */
+	if ((occupati + lunghezza) < DIM_CODA_TX)
 	{
-		leggi_telegramma_di_connessione();
-	}
+		for(uint16_t indice = 0; indice < lunghezza; indice++)
+		{
+			coda_tx[scrittura] = dati[indice];
+			scrittura = (scrittura + 1U) & MASCHERA_CODA_TX;
+		}
+		indice_scrittura_tx = scrittura;
+		accodato = true;
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+
+	return accodato;
+}
+
+/**
+ * @brief Accoda un telegramma per l'applicazione, in trama se richiesto
+ *
+ * @param telegramma Telegramma da trasmettere
+ * @param lunghezza Byte del telegramma, al più L_TELEGRAMMA_TX_MAX
+ * @return bool true se il telegramma è stato accodato
+ *
+ * @details Con il protocollo con trama aggiunge intestazione e CRC; la
+ * trama viene accodata per intero o per niente, come un telegramma.
+ */
+static bool accoda_telegramma(const uint8_t *telegramma, uint16_t lunghezza)
+{
+	bool accodato = false;
+
+	if (protocollo_con_trama == false)
+	{
+		accodato = accoda_tx(telegramma, lunghezza);
+	}
+	else if (lunghezza <= L_TELEGRAMMA_TX_MAX)
+	{
+		uint8_t trama[L_TELEGRAMMA_TX_MAX + L_CORNICE_TRAMA];
+		uint16_t crc;
+
+		trama[0] = INIZIO_TRAMA;
+		trama[1] = (uint8_t) lunghezza;
+		(void) memcpy(&trama[L_INTESTAZIONE_TRAMA], telegramma, lunghezza);
+		crc = calcola_crc16(CRC16_INIZIALE, &trama[1], lunghezza + 1U);
+		trama[lunghezza + L_INTESTAZIONE_TRAMA] = (uint8_t) (crc & 0xFFU);
+		trama[lunghezza + L_INTESTAZIONE_TRAMA + 1U] = (uint8_t) (crc >> 8U);
+
+		accodato = accoda_tx(trama, lunghezza + L_CORNICE_TRAMA);
+	}
+	else
+	{
+		/* Telegramma troppo lungo per una trama, MISRA-2023-15.7 */
+	}
+
+	return accodato;
+}
+
+/**
+ * @brief Calcola la lunghezza di un telegramma di telemetria
+ *
+ * @param maschera Campi richiesti, già limitati a TELEMETRIA_TUTTI
+ * @return uint16_t Byte del telegramma, senza trama
+ */
+static uint16_t ritorna_lunghezza_telemetria(uint8_t maschera)
+{
+	uint16_t lunghezza = L_TELEMETRIA_BASE;
+
+	if ((maschera & TELEMETRIA_VELOCITA) != 0U)
+	{
+		lunghezza += (uint16_t) (N_ENCODER_PROTOCOLLO * sizeof(float_t));
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+
+	if ((maschera & TELEMETRIA_CONTEGGI) != 0U)
+	{
+		lunghezza += (uint16_t) (N_ENCODER_PROTOCOLLO * sizeof(int64_t));
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+
+	if ((maschera & TELEMETRIA_DIAGNOSTICA) != 0U)
+	{
+		lunghezza += (uint16_t) (2U * sizeof(uint32_t));
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+
+	return lunghezza;
+}
+
+/**
+ * @brief Avvia, cambia o ferma la telemetria continua
+ *
+ * @param frequenza Telegrammi al secondo; 0 ferma la telemetria
+ * @param maschera Campi richiesti, combinazione dei bit TELEMETRIA_*; 0
+ * ferma la telemetria
+ *
+ * @details Va chiamata dal main loop. Una frequenza sotto
+ * FREQUENZA_TELEMETRIA_MIN viene alzata a quel valore. Il periodo viene
+ * allungato, se serve, fino al tempo di trasmissione del telegramma al baud
+ * rate corrente: più veloce la coda di trasmissione si riempirebbe e i
+ * telegrammi verrebbero scartati. Il task viene poi arrotondato ai tick del
+ * side loop.
+ */
+static void assegna_telemetria(float_t frequenza, uint8_t maschera)
+{
+	uint8_t campi = maschera & TELEMETRIA_TUTTI;
+
+	if ((frequenza > 0.0f) && (campi != 0U))
+	{
+		uint16_t lunghezza = ritorna_lunghezza_telemetria(campi);
+		float_t periodo;
+		float_t periodo_minimo;
+
+		if (frequenza < FREQUENZA_TELEMETRIA_MIN)
+		{
+			frequenza = FREQUENZA_TELEMETRIA_MIN;
+		}
+		else
+		{
+			/* Non succede niente, MISRA-2023-15.7 */
+		}
+		periodo = 1.0f / frequenza;
+
+		if (protocollo_con_trama == true)
+		{
+			lunghezza += L_CORNICE_TRAMA;
+		}
+		else
+		{
+			/* Non succede niente, MISRA-2023-15.7 */
+		}
+
+		periodo_minimo = ((float_t) lunghezza * (float_t) BIT_PER_CARATTERE) /
+						 (float_t) Uart_Ps.BaudRate;
+		if (periodo < periodo_minimo)
+		{
+			periodo = periodo_minimo;
+		}
+		else
+		{
+			/* Non succede niente, MISRA-2023-15.7 */
+		}
+
+		/* Prima il periodo, poi i campi: il primo invio è già a regime */
+		(void) assegna_periodo_task(manda_telemetria_continua, periodo);
+		maschera_telemetria = campi;
+
+		configurazione_corrente.frequenza_telemetria = frequenza;
+		configurazione_corrente.maschera_telemetria = campi;
+	}
+	else
+	{
+		maschera_telemetria = 0;
+		(void) assegna_periodo_task(manda_telemetria_continua,
+									PERIODO_TELEMETRIA_SPENTA);
+
+		configurazione_corrente.frequenza_telemetria = 0.0f;
+		configurazione_corrente.maschera_telemetria = 0;
+	}
+}
+
+/**
+ * @brief Manda un telegramma di telemetria continua
+ *
+ * @details Task periodico del side loop, che resta l'unico produttore della
+ * coda di trasmissione. Non dipende dall'handshake: dopo la sottoscrizione
+ * l'applicazione riceve la telemetria senza mandare altri telegrammi. Se la
+ * coda è piena il telegramma viene scartato e contato, senza attese. I
+ * conteggi sono cumulativi: un telegramma perso non perde distanza. Nella
+ * CPU0 della build AMP velocità e conteggi sono quelli dell'ultima
+ * telemetria di CPU1.
+ */
+static void manda_telemetria_continua(void)
+{
+	uint8_t maschera = maschera_telemetria;
+
+	if ((stato_connessione_app == true) && (maschera != 0U) &&
+		(trasmissione_sospesa == false))
+	{
+		uint8_t telegramma[L_TELEMETRIA_MAX];
+		uint32_t tick = ritorna_tick_corrente();
+		uint16_t posizione = 0;
+
+		/* Tick del side loop al momento del campionamento */
+		telegramma[posizione] = (uint8_t) (tick & 0xFFU);
+		telegramma[posizione + 1U] = (uint8_t) ((tick >> 8U) & 0xFFU);
+		telegramma[posizione + 2U] = (uint8_t) ((tick >> 16U) & 0xFFU);
+		telegramma[posizione + 3U] = (uint8_t) (tick >> 24U);
+		telegramma[posizione + 4U] = maschera;
+		posizione += 5U;
+
+		if ((maschera & TELEMETRIA_VELOCITA) != 0U)
+		{
+			union float_bytes temp_vel;
+
+			for (uint8_t indice = 0; indice < N_ENCODER_PROTOCOLLO; indice++)
+			{
+				temp_vel.value = (float_t) ritorna_velocita_encoder(indice);
+				(void) memcpy(&telegramma[posizione], temp_vel.bytes,
+							  sizeof(float_t));
+				posizione += (uint16_t) sizeof(float_t);
+			}
+		}
+		else
+		{
+			/* Non succede niente, MISRA-2023-15.7 */
+		}
+
+		if ((maschera & TELEMETRIA_CONTEGGI) != 0U)
+		{
+			/* Conteggi cumulativi, in complemento a 2 */
+			for (uint8_t indice = 0; indice < N_ENCODER_PROTOCOLLO; indice++)
+			{
+				uint64_t temp_totale =
+						(uint64_t) ritorna_conteggio_totale_encoder(indice);
+
+				for (uint16_t byte = 0; byte < 8U; byte++)
+				{
+					telegramma[posizione + byte] =
+							(uint8_t) ((temp_totale >> (8U * byte)) & 0xFFU);
+				}
+				posizione += 8U;
+			}
+		}
+		else
+		{
+			/* Non succede niente, MISRA-2023-15.7 */
+		}
+
+		if ((maschera & TELEMETRIA_DIAGNOSTICA) != 0U)
+		{
+			(void) memcpy(&telegramma[posizione], &telegrammi_tx_scartati,
+						  sizeof(uint32_t));
+			posizione += (uint16_t) sizeof(uint32_t);
+			(void) memcpy(&telegramma[posizione], (const void *) &byte_rx_persi,
+						  sizeof(uint32_t));
+			posizione += (uint16_t) sizeof(uint32_t);
+		}
+		else
+		{
+			/* Non succede niente, MISRA-2023-15.7 */
+		}
+
+		telegramma[posizione] = IDENTIFICATIVO_TELEMETRIA;
+		posizione++;
+
+		if (accoda_telegramma(telegramma, posizione) == true)
+		{
+			XUartPs_WriteReg(Uart_Ps.Config.BaseAddress, XUARTPS_IER_OFFSET,
+							 XUARTPS_IXR_TXEMPTY);
+		}
+		else
+		{
+			telegrammi_tx_scartati++;
+		}
+	}
+	else
+	{
+		/* Telemetria non richiesta, MISRA-2023-15.7 */
+	}
+}
+
+/**
+ * @brief Compone il telegramma di risposta classico
+ *
+ * @param buffer Destinazione di almeno L_TELEGRAMMA_RISP byte
+ * @return uint16_t Byte del telegramma
+ *
+ * @details Velocità in float e conteggi del periodo a 16 bit, azzerati dal
+ * side loop secondario.
+ */
+static uint16_t componi_risposta_classica(uint8_t *buffer)
+{
+	union float_bytes temp_vel;
+	uint16_t temp_cont;
+
+	/* Mando velocita' del GIT 1*/
+	temp_vel.value = ritorna_velocita_encoder(ENCODER_1);
+	(void) memcpy(buffer, temp_vel.bytes, sizeof(float_t));
+
+	/* Mando velocita' del GIT 2*/
+	temp_vel.value = ritorna_velocita_encoder(ENCODER_2);
+	(void) memcpy(&buffer[4], temp_vel.bytes, sizeof(float_t));
+
+	/* Mando conteggio del GIT 1 */
+	temp_cont = (uint16_t) ritorna_conteggio_encoder(ENCODER_1);
+	buffer[8] = temp_cont & 0xFFU;
+	buffer[9] = (temp_cont >> 8U) & 0xFFU;
+
+	/* Mando conteggio del GIT 2 */
+	temp_cont = (uint16_t) ritorna_conteggio_encoder(ENCODER_2);
+	buffer[10] = temp_cont & 0xFFU;
+	buffer[11] = (temp_cont >> 8U) & 0xFFU;
+
+	/* Mando identificativo del telegramma della risposta (fisso) */
+	buffer[12] = IDENTIFICATIVO_RISPOSTA;
+
+	return L_TELEGRAMMA_RISP;
+}
+
+/**
+ * @brief Compone il telegramma di risposta esteso
+ *
+ * @param buffer Destinazione di almeno L_TELEGRAMMA_RISP_ESTESA byte
+ * @return uint16_t Byte del telegramma
+ *
+ * @details Il numero di sequenza rivela le risposte perse, il tick dà
+ * l'istante del campionamento e i conteggi cumulativi non risentono
+ * dell'azzeramento periodico: l'applicazione ricostruisce la distanza
+ * esatta dalla differenza tra due risposte qualsiasi.
+ */
+static uint16_t componi_risposta_estesa(uint8_t *buffer)
+{
+	union float_bytes temp_vel;
+	uint32_t tick = ritorna_tick_corrente();
+	uint16_t posizione = 8U;
+
+	sequenza_risposta++;
+
+	/* Numero di sequenza e tick del campionamento */
+	for (uint16_t byte = 0; byte < 4U; byte++)
+	{
+		buffer[byte] = (uint8_t) ((sequenza_risposta >> (8U * byte)) & 0xFFU);
+		buffer[byte + 4U] = (uint8_t) ((tick >> (8U * byte)) & 0xFFU);
+	}
+
+	/* Velocità dei GIT */
+	for (uint8_t indice = 0; indice < N_ENCODER_PROTOCOLLO; indice++)
+	{
+		temp_vel.value = (float_t) ritorna_velocita_encoder(indice);
+		(void) memcpy(&buffer[posizione], temp_vel.bytes, sizeof(float_t));
+		posizione += (uint16_t) sizeof(float_t);
+	}
+
+	/* Conteggi cumulativi dei GIT, in complemento a 2 */
+	for (uint8_t indice = 0; indice < N_ENCODER_PROTOCOLLO; indice++)
+	{
+		uint64_t temp_totale =
+				(uint64_t) ritorna_conteggio_totale_encoder(indice);
+
+		for (uint16_t byte = 0; byte < 8U; byte++)
+		{
+			buffer[posizione + byte] =
+					(uint8_t) ((temp_totale >> (8U * byte)) & 0xFFU);
+		}
+		posizione += 8U;
+	}
+
+	buffer[posizione] = IDENTIFICATIVO_RISPOSTA_ESTESA;
+
+	return L_TELEGRAMMA_RISP_ESTESA;
+}
+
+/**
+ * @brief Trasferisce byte dalla coda di trasmissione alla FIFO TX dell'UART
+ *
+ * @details Scrive finché la FIFO hardware non è piena o la coda non è vuota,
+ * senza mai attendere. Se la coda si svuota disabilita l'interrupt di FIFO TX
+ * vuota, che viene riabilitato al prossimo telegramma accodato.
+ */
+static void svuota_coda_tx(void)
+{
+	uint16_t lettura = indice_lettura_tx;
+
+	while ((lettura != indice_scrittura_tx) &&
+		   (!XUartPs_IsTransmitFull(Uart_Ps.Config.BaseAddress)))
+	{
+		XUartPs_WriteReg(Uart_Ps.Config.BaseAddress, XUARTPS_FIFO_OFFSET,
+						 coda_tx[lettura]);
+		lettura = (lettura + 1U) & MASCHERA_CODA_TX;
+	}
+	indice_lettura_tx = lettura;
+
+	if (lettura == indice_scrittura_tx)
+	{
+		XUartPs_WriteReg(Uart_Ps.Config.BaseAddress, XUARTPS_IDR_OFFSET,
+						 XUARTPS_IXR_TXEMPTY);
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+}
+
+/**
+ * @brief Handler dell'interrupt UART
+ *
+ * @param riferimento Non utilizzato, richiesto dalla firma del GIC
+ *
+ * @details Legge e azzera gli interrupt pendenti abilitati. Alla FIFO TX
+ * vuota trasferisce nella FIFO i byte in attesa nella coda di trasmissione.
+ */
+static void gestore_interrupt_uart(void *riferimento)
+{
+	u32 base = Uart_Ps.Config.BaseAddress;
+	u32 pendenti = XUartPs_ReadReg(base, XUARTPS_ISR_OFFSET) &
+				   XUartPs_ReadReg(base, XUARTPS_IMR_OFFSET);
+
+	/* Azzero gli interrupt che sto per servire */
+	XUartPs_WriteReg(base, XUARTPS_ISR_OFFSET, pendenti);
+
+	if ((pendenti & (XUARTPS_IXR_RXOVR | XUARTPS_IXR_TOUT |
+					 XUARTPS_IXR_RXFULL)) != 0U)
+	{
+		riempi_coda_rx();
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+
+	if ((pendenti & XUARTPS_IXR_OVER) != 0U)
+	{
+		/* La FIFO hardware ha perso almeno un byte */
+		byte_rx_persi++;
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+
+	if ((pendenti & XUARTPS_IXR_TXEMPTY) != 0U)
+	{
+		svuota_coda_tx();
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+}
+
+/**
+ * @brief Trasferisce i byte della FIFO RX dell'UART nella coda di ricezione
+ *
+ * @details Chiamata dall'interrupt UART, svuota completamente la FIFO
+ * hardware. Se la coda è piena il byte viene scartato e contato, senza
+ * sovrascrivere dati non ancora letti dal main loop.
+ */
+static void riempi_coda_rx(void)
+{
+	u32 base = Uart_Ps.Config.BaseAddress;
+	uint16_t scrittura = indice_scrittura_rx;
+
+	while (XUartPs_IsReceiveData(base))
+	{
+		uint8_t byte = XUartPs_ReadReg(base, XUARTPS_FIFO_OFFSET) & 0xFFU;
+		uint16_t successivo = (scrittura + 1U) & MASCHERA_CODA_RX;
+
+		if (successivo != indice_lettura_rx)
+		{
+			coda_rx[scrittura] = byte;
+			scrittura = successivo;
+		}
+		else
+		{
+			byte_rx_persi++;
+		}
+	}
+
+	/* Pubblico i nuovi byte solo dopo averli scritti */
+	indice_scrittura_rx = scrittura;
+}
+
+/**
+ * @brief Restituisce il numero di byte in attesa nella coda di ricezione
+ *
+ * @return uint16_t Byte ricevuti e non ancora estratti dal main loop
+ */
+static uint16_t ritorna_byte_disponibili_rx(void)
+{
+	return (indice_scrittura_rx - indice_lettura_rx) & MASCHERA_CODA_RX;
+}
+
+/**
+ * @brief Estrae byte dalla coda di ricezione
+ *
+ * @param destinazione Buffer in cui copiare i byte
+ * @param lunghezza Numero di byte da estrarre, non superiore a quelli
+ * disponibili
+ */
+static void estrai_coda_rx(uint8_t *destinazione, uint16_t lunghezza)
+{
+	uint16_t lettura = indice_lettura_rx;
+
+	for(uint16_t indice = 0; indice < lunghezza; indice++)
+	{
+		destinazione[indice] = coda_rx[lettura];
+		lettura = (lettura + 1U) & MASCHERA_CODA_RX;
+	}
+
+	/* Libero lo spazio solo dopo aver copiato i byte */
+	indice_lettura_rx = lettura;
+}
+
+
+/**
+ * @brief Legge un byte della coda di ricezione senza estrarlo
+ *
+ * @param posizione Distanza dal primo byte non letto, minore dei byte
+ * disponibili
+ * @return uint8_t Byte in quella posizione
+ */
+static uint8_t leggi_byte_coda_rx(uint16_t posizione)
+{
+	return coda_rx[(indice_lettura_rx + posizione) & MASCHERA_CODA_RX];
+}
+
+/**
+ * @brief Scarta byte dalla testa della coda di ricezione
+ *
+ * @param lunghezza Numero di byte da scartare, non superiore a quelli
+ * disponibili
+ */
+static void scarta_coda_rx(uint16_t lunghezza)
+{
+	indice_lettura_rx = (indice_lettura_rx + lunghezza) & MASCHERA_CODA_RX;
+}
+
+/**
+ * @brief Esamina la trama in testa alla coda di ricezione
+ *
+ * @param disponibili Byte in coda
+ * @param lunghezza Lunghezza del telegramma per CODA_TRAMA, byte da
+ * scartare negli altri casi
+ * @return esito_coda_rx Uno tra CODA_INCOMPLETA, CODA_TRAMA, CODA_RUMORE,
+ * CODA_TRAMA_ERRATA e CODA_LUNGHEZZA_ERRATA
+ *
+ * @details Di una trama non valida viene scartato solo il byte di inizio:
+ * il prossimo INIZIO_TRAMA può trovarsi all'interno della trama rovinata.
+ */
+static esito_coda_rx esamina_trama(uint16_t disponibili, uint16_t *lunghezza)
+{
+	esito_coda_rx esito = CODA_INCOMPLETA;
+	uint16_t l_telegramma;
+
+	*lunghezza = 1U;
+
+	if (leggi_byte_coda_rx(0) != INIZIO_TRAMA)
+	{
+		esito = CODA_RUMORE;
+	}
+	else if (disponibili < L_INTESTAZIONE_TRAMA)
+	{
+		/* Manca ancora la lunghezza */
+	}
+	else
+	{
+		l_telegramma = leggi_byte_coda_rx(1);
+
+		if ((l_telegramma == 0U) || (l_telegramma > L_TELEGRAMMA_FUNZ))
+		{
+			esito = CODA_LUNGHEZZA_ERRATA;
+		}
+		else if (disponibili < (l_telegramma + L_CORNICE_TRAMA))
+		{
+			/* Trama non ancora completa */
+		}
+		else
+		{
+			uint16_t crc = CRC16_INIZIALE;
+			uint16_t crc_ricevuto = (uint16_t)
+				(leggi_byte_coda_rx(l_telegramma + L_INTESTAZIONE_TRAMA) |
+				 (leggi_byte_coda_rx(l_telegramma + L_INTESTAZIONE_TRAMA + 1U)
+				  << 8U));
+
+			for (uint16_t posizione = 1U;
+				 posizione < (l_telegramma + L_INTESTAZIONE_TRAMA); posizione++)
+			{
+				crc = aggiorna_crc16(crc, leggi_byte_coda_rx(posizione));
+			}
+
+			if (crc == crc_ricevuto)
+			{
+				esito = CODA_TRAMA;
+				*lunghezza = l_telegramma;
+			}
+			else
+			{
+				esito = CODA_TRAMA_ERRATA;
+			}
+		}
+	}
+
+	return esito;
+}
+
+/**
+ * @brief Esamina la testa della coda di ricezione
+ *
+ * @param lunghezza Lunghezza del telegramma per CODA_TELEGRAMMA e
+ * CODA_TRAMA, byte da scartare negli altri casi
+ * @return esito_coda_rx Cosa c'è in testa alla coda
+ *
+ * @details Da scollegati, INIZIO_TRAMA seguito da una lunghezza valida è
+ * una trama: si attende che sia completa e, se il CRC non torna, si scarta
+ * solo il primo byte. Il telegramma di connessione classico, di lunghezza
+ * fissa come nell'applicazione esistente, si legge solo se il primo byte
+ * non è INIZIO_TRAMA o la lunghezza non è valida. Da collegati si segue il
+ * protocollo scelto alla connessione.
+ *
+ * @note Un telegramma classico il cui diametro comincia con INIZIO_TRAMA e
+ * una lunghezza valida viene preso per una trama.
+ */
+static esito_coda_rx esamina_coda_rx(uint16_t *lunghezza)
+{
+	uint16_t disponibili = ritorna_byte_disponibili_rx();
+	esito_coda_rx esito = CODA_INCOMPLETA;
+
+	*lunghezza = 0;
+
+	if (disponibili == 0U)
+	{
+		/* Coda vuota */
+	}
+	else if ((stato_connessione_app == true) && (protocollo_con_trama == true))
+	{
+		esito = esamina_trama(disponibili, lunghezza);
+
+		if ((esito == CODA_TRAMA) && (*lunghezza != L_TELEGRAMMA_FUNZ))
+		{
+			/* Trama integra ma non di funzionamento: la scarto intera */
+			esito = CODA_TRAMA_ERRATA;
+			*lunghezza = *lunghezza + L_CORNICE_TRAMA;
+		}
+		else
+		{
+			/* Non succede niente, MISRA-2023-15.7 */
+		}
+	}
+	else if (stato_connessione_app == true)
+	{
+		if (disponibili >= L_TELEGRAMMA_FUNZ)
+		{
+			esito = CODA_TELEGRAMMA;
+			*lunghezza = L_TELEGRAMMA_FUNZ;
+		}
+		else
+		{
+			/* Telegramma non ancora completo */
+		}
+	}
+	else
+	{
+		esito = esamina_trama(disponibili, lunghezza);
+
+		if ((esito == CODA_TRAMA) && (*lunghezza != L_TELEGRAMMA_CONN) &&
+			(*lunghezza != L_TELEGRAMMA_CONN_ESTESO))
+		{
+			/* Trama integra ma non di connessione: la scarto intera */
+			esito = CODA_TRAMA_ERRATA;
+			*lunghezza = *lunghezza + L_CORNICE_TRAMA;
+		}
+		else if ((esito == CODA_TRAMA) || (esito == CODA_TRAMA_ERRATA) ||
+				 (esito == CODA_INCOMPLETA))
+		{
+			/* Trama di connessione, trama da scartare o trama in arrivo */
+		}
+		else if (disponibili >= L_TELEGRAMMA_CONN)
+		{
+			/* Senza trama c'è solo il telegramma classico */
+			esito = CODA_TELEGRAMMA;
+			*lunghezza = L_TELEGRAMMA_CONN;
+		}
+		else
+		{
+			/* Telegramma non ancora completo */
+			esito = CODA_INCOMPLETA;
+		}
+	}
+
+	return esito;
+}
+
+/**
+ * @brief Restituisce il clock da cui l'UART ricava il baud rate
+ *
+ * @return uint32_t Clock di riferimento, diviso 8 se selezionato nel
+ * registro di modo
+ */
+static uint32_t ritorna_clock_baud(void)
+{
+	uint32_t clock = Uart_Ps.Config.InputClockHz;
+
+	if ((XUartPs_ReadReg(Uart_Ps.Config.BaseAddress, XUARTPS_MR_OFFSET) &
+		 XUARTPS_MR_CLKSEL) != 0U)
+	{
+		clock = clock / 8U;
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+
+	return clock;
+}
+
+/**
+ * @brief Cerca i divisori che approssimano meglio un baud rate
+ *
+ * @param baud Baud rate richiesto
+ * @param generatore Valore del generatore (CD) trovato
+ * @param divisore Valore del divisore (BDIV) trovato
+ * @return bool true se l'errore resta entro ERRORE_MAX_BAUD_PERCENTO
+ *
+ * @details Stessa ricerca di XUartPs_SetBaudRate(), con il generatore
+ * arrotondato al più vicino e senza il limite di XUARTPS_MAX_RATE del
+ * driver. Il baud rate effettivo è clock / (CD * (BDIV + 1)).
+ */
+static bool calcola_divisori_baud(uint32_t baud, uint32_t *generatore,
+								  uint32_t *divisore)
+{
+	uint32_t clock = ritorna_clock_baud();
+	uint32_t errore_migliore = 0xFFFFFFFFU;
+	bool trovato = false;
+
+	if ((baud >= XUARTPS_MIN_RATE) && (baud <= BAUD_MASSIMO))
+	{
+		for (uint32_t bdiv = 4U; bdiv < 255U; bdiv++)
+		{
+			uint32_t passo = baud * (bdiv + 1U);
+			uint32_t cd = (clock + (passo / 2U)) / passo;
+
+			if ((cd >= 1U) && (cd <= XUARTPS_BAUDGEN_MASK))
+			{
+				uint32_t effettivo = clock / (cd * (bdiv + 1U));
+				uint32_t errore = (effettivo > baud) ? (effettivo - baud) :
+													   (baud - effettivo);
+
+				if (errore < errore_migliore)
+				{
+					errore_migliore = errore;
+					*generatore = cd;
+					*divisore = bdiv;
+				}
+				else
+				{
+					/* Non succede niente, MISRA-2023-15.7 */
+				}
+			}
+			else
+			{
+				/* Generatore fuori dal registro */
+			}
+		}
+
+		trovato = (((uint64_t) errore_migliore * 100U) <=
+				   ((uint64_t) baud * ERRORE_MAX_BAUD_PERCENTO));
+	}
+	else
+	{
+		/* Fuori dai limiti, MISRA-2023-15.7 */
+	}
+
+	return trovato;
+}
+
+/**
+ * @brief Imposta il baud rate dell'UART
+ *
+ * @param baud Nuovo baud rate
+ * @return bool true se il baud rate è stato impostato
+ *
+ * @details Fino a XUARTPS_MAX_RATE usa XUartPs_SetBaudRate(); oltre, il
+ * driver fallisce un'asserzione e i divisori vengono scritti qui con la
+ * stessa sequenza. Le FIFO vengono resettate: va chiamata a trasmissione
+ * finita e con gli interrupt mascherati.
+ */
+static bool imposta_baud_uart(uint32_t baud)
+{
+	uint32_t generatore = 0;
+	uint32_t divisore = 0;
+	bool impostato = false;
+
+	if (calcola_divisori_baud(baud, &generatore, &divisore) == false)
+	{
+		/* Baud rate non realizzabile, MISRA-2023-15.7 */
+	}
+	else if (baud <= XUARTPS_MAX_RATE)
+	{
+		impostato = (XUartPs_SetBaudRate(&Uart_Ps, baud) == XST_SUCCESS);
+	}
+	else
+	{
+		u32 base = Uart_Ps.Config.BaseAddress;
+
+		XUartPs_DisableUart(&Uart_Ps);
+		XUartPs_WriteReg(base, XUARTPS_BAUDGEN_OFFSET, generatore);
+		XUartPs_WriteReg(base, XUARTPS_BAUDDIV_OFFSET, divisore);
+		XUartPs_WriteReg(base, XUARTPS_CR_OFFSET,
+						 XUARTPS_CR_TXRST | XUARTPS_CR_RXRST);
+		XUartPs_EnableUart(&Uart_Ps);
+
+		Uart_Ps.BaudRate = baud;
+		impostato = true;
+	}
+
+	return impostato;
+}
+
+/**
+ * @brief Restituisce il baud rate effettivo dell'UART
+ *
+ * @return uint32_t Baud rate dato dai divisori programmati
+ */
+static uint32_t ritorna_baud_effettivo(void)
+{
+	u32 base = Uart_Ps.Config.BaseAddress;
+	uint32_t cd = XUartPs_ReadReg(base, XUARTPS_BAUDGEN_OFFSET) &
+				  XUARTPS_BAUDGEN_MASK;
+	uint32_t bdiv = XUartPs_ReadReg(base, XUARTPS_BAUDDIV_OFFSET) &
+					XUARTPS_BAUDDIV_MASK;
+	uint32_t effettivo = 0;
+
+	if (cd != 0U)
+	{
+		effettivo = ritorna_clock_baud() / (cd * (bdiv + 1U));
+	}
+	else
+	{
+		/* Generatore spento, MISRA-2023-15.7 */
+	}
+
+	return effettivo;
+}
+
+/**
+ * @brief Indica se l'ultimo byte accodato ha lasciato la linea
+ *
+ * @return bool true con coda di trasmissione e FIFO TX vuote e
+ * trasmettitore fermo
+ */
+static bool ritorna_trasmissione_finita(void)
+{
+	u32 stato = XUartPs_ReadReg(Uart_Ps.Config.BaseAddress, XUARTPS_SR_OFFSET);
+
+	return ((indice_lettura_tx == indice_scrittura_tx) &&
+			((stato & XUARTPS_SR_TXEMPTY) != 0U) &&
+			((stato & XUARTPS_SR_TACTIVE) == 0U));
+}
+
+/**
+ * @brief Compone il telegramma baud in telegramma_baud
+ *
+ * @param richiesto Baud rate richiesto dall'applicazione
+ * @param esito Uno tra BAUD_RIFIUTATO, BAUD_ACCETTATO, BAUD_CONFERMATO e
+ * BAUD_RIPRISTINATO
+ * @param gettone Gettone del telegramma di prova, 0 se non ricevuto
+ *
+ * @details Con BAUD_CONFERMATO l'applicazione ha, per il nuovo baud rate,
+ * il baud rate effettivo (quindi il throughput, un carattere ogni
+ * BIT_PER_CARATTERE bit), il tick di ricezione della prova e gli errori di
+ * ricezione dal cambio; il tempo di andata e ritorno è quello tra la prova
+ * e questo telegramma, mandato subito dal main loop.
+ */
+static void componi_telegramma_baud(uint32_t richiesto, uint8_t esito,
+									uint32_t gettone)
+{
+	uint32_t effettivo = ritorna_baud_effettivo();
+	uint32_t tick = ritorna_tick_corrente();
+	uint32_t errori = (byte_rx_persi + trame_errate) - errori_al_cambio_baud;
+
+	if (esito != BAUD_CONFERMATO)
+	{
+		errori = 0;
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+
+	for (uint16_t byte = 0; byte < 4U; byte++)
+	{
+		telegramma_baud[byte] = (uint8_t) ((richiesto >> (8U * byte)) & 0xFFU);
+		telegramma_baud[byte + 4U] =
+				(uint8_t) ((effettivo >> (8U * byte)) & 0xFFU);
+		telegramma_baud[byte + 9U] =
+				(uint8_t) ((gettone >> (8U * byte)) & 0xFFU);
+		telegramma_baud[byte + 13U] = (uint8_t) ((tick >> (8U * byte)) & 0xFFU);
+		telegramma_baud[byte + 17U] =
+				(uint8_t) ((errori >> (8U * byte)) & 0xFFU);
+	}
+	telegramma_baud[8] = esito;
+	telegramma_baud[L_TELEGRAMMA_BAUD - 1U] = IDENTIFICATIVO_BAUD;
+}
+
+/**
+ * @brief Accoda il telegramma baud dal main loop
+ *
+ * @details Solo con il side loop sospeso: in quel tratto il main loop è
+ * l'unico produttore della coda di trasmissione.
+ */
+static void manda_telegramma_baud_main(void)
+{
+	if (accoda_telegramma(telegramma_baud, L_TELEGRAMMA_BAUD) == true)
+	{
+		XUartPs_WriteReg(Uart_Ps.Config.BaseAddress, XUARTPS_IER_OFFSET,
+						 XUARTPS_IXR_TXEMPTY);
+	}
+	else
+	{
+		telegrammi_tx_scartati++;
+	}
+}
+
+/**
+ * @brief Avvia la negoziazione di un nuovo baud rate
+ *
+ * @param baud Baud rate richiesto dall'applicazione
+ *
+ * @details Va chiamata dal main loop. Il telegramma baud parte con la
+ * prossima risposta, ancora al baud rate corrente. Se il baud rate è
+ * realizzabile, dopo l'ultimo byte del telegramma l'UART passa al nuovo
+ * baud rate e attende il telegramma 0x0D per TIMEOUT_VERIFICA_BAUD. Una
+ * richiesta durante un'altra negoziazione viene ignorata.
+ */
+static void richiedi_baud(uint32_t baud)
+{
+	uint32_t generatore;
+	uint32_t divisore;
+
+	if (fase_baud == BAUD_STABILE)
+	{
+		if (calcola_divisori_baud(baud, &generatore, &divisore) == true)
+		{
+			baud_obiettivo = baud;
+			verifica_baud = true;
+			componi_telegramma_baud(baud, BAUD_ACCETTATO, 0U);
+		}
+		else
+		{
+			componi_telegramma_baud(baud, BAUD_RIFIUTATO, 0U);
+		}
+
+		fase_baud = BAUD_DA_ANNUNCIARE;
+	}
+	else
+	{
+		/* Negoziazione già in corso, MISRA-2023-15.7 */
+	}
+}
+
+/**
+ * @brief Conclude la negoziazione alla ricezione del telegramma di prova
+ *
+ * @param array_stringa Valori del telegramma 0x0D: gettone scelto
+ * dall'applicazione e SCHEMA_PROVA_BAUD, little endian
+ *
+ * @details Il telegramma di prova arriva integro solo se entrambi i lati
+ * sono al nuovo baud rate; la conferma riporta il gettone e riapre il side
+ * loop. Fuori dalla verifica il telegramma non ha effetto.
+ */
+static void conferma_baud(const uint8_t array_stringa[])
+{
+	uint32_t gettone = (uint32_t) array_stringa[0] |
+					   ((uint32_t) array_stringa[1] << 8U) |
+					   ((uint32_t) array_stringa[2] << 16U) |
+					   ((uint32_t) array_stringa[3] << 24U);
+	uint32_t schema = (uint32_t) array_stringa[4] |
+					  ((uint32_t) array_stringa[5] << 8U) |
+					  ((uint32_t) array_stringa[6] << 16U) |
+					  ((uint32_t) array_stringa[7] << 24U);
+
+	if ((fase_baud == BAUD_IN_VERIFICA) && (schema == SCHEMA_PROVA_BAUD))
+	{
+		componi_telegramma_baud(baud_obiettivo, BAUD_CONFERMATO, gettone);
+		manda_telegramma_baud_main();
+
+		configurazione_corrente.baud_rate = baud_obiettivo;
+		fase_baud = BAUD_STABILE;
+		trasmissione_sospesa = false;
+
+		/* Il limite della telemetria dipende dal baud rate */
+		assegna_telemetria(configurazione_corrente.frequenza_telemetria,
+						   configurazione_corrente.maschera_telemetria);
+	}
+	else
+	{
+		/* Nessuna verifica in corso, MISRA-2023-15.7 */
+	}
+}
+
+/**
+ * @brief Riporta l'UART al baud rate predefinito alla disconnessione
+ *
+ * @details La prossima applicazione si collega sempre a
+ * XUARTPS_DFT_BAUDRATE. Il cambio avviene a trasmissione finita, senza
+ * telegramma di prova; una negoziazione in corso viene abbandonata.
+ */
+static void ripristina_baud_predefinito(void)
+{
+	configurazione_corrente.baud_rate = 0;
+
+	if ((Uart_Ps.BaudRate != XUARTPS_DFT_BAUDRATE) ||
+		(fase_baud != BAUD_STABILE))
+	{
+		baud_obiettivo = XUARTPS_DFT_BAUDRATE;
+		verifica_baud = false;
+		trasmissione_sospesa = true;
+		fase_baud = BAUD_IN_CAMBIO;
+	}
+	else
+	{
+		/* Già al baud rate predefinito, MISRA-2023-15.7 */
+	}
+}
+
+/**
+ * @brief Porta avanti la negoziazione del baud rate
+ *
+ * @details Va chiamata a ogni giro del main loop. In BAUD_IN_CAMBIO
+ * controlla che l'ultimo byte sia uscito e cambia baud rate con gli
+ * interrupt mascherati, scartando i byte ricevuti a cavallo del cambio. In
+ * BAUD_IN_VERIFICA, scaduto TIMEOUT_VERIFICA_BAUD, torna al baud rate
+ * precedente e lo comunica all'applicazione.
+ */
+static void servi_negoziazione_baud(void)
+{
+	if (fase_baud == BAUD_IN_CAMBIO)
+	{
+		u32 cpsr = mfcpsr();
+
+		mtcpsr(cpsr | XIL_EXCEPTION_IRQ);
+
+		if (ritorna_trasmissione_finita() == true)
+		{
+			baud_precedente = Uart_Ps.BaudRate;
+
+			if (imposta_baud_uart(baud_obiettivo) == false)
+			{
+				/* Già verificato alla richiesta: non dovrebbe succedere */
+				verifica_baud = false;
+			}
+			else
+			{
+				/* Non succede niente, MISRA-2023-15.7 */
+			}
+
+			/* I byte a cavallo del cambio sono illeggibili */
+			indice_lettura_rx = indice_scrittura_rx;
+			tick_cambio_baud = ritorna_tick_corrente();
+			errori_al_cambio_baud = byte_rx_persi + trame_errate;
+
+			if (verifica_baud == true)
+			{
+				fase_baud = BAUD_IN_VERIFICA;
+			}
+			else
+			{
+				fase_baud = BAUD_STABILE;
+				trasmissione_sospesa = false;
+			}
+		}
+		else
+		{
+			/* Ultimo telegramma ancora in linea */
+		}
+
+		mtcpsr(cpsr);
+	}
+	else if (fase_baud == BAUD_IN_VERIFICA)
+	{
+		/* Creo la variabile temporanea per MISRA-2023 */
+		float_t tick_timeout = TIMEOUT_VERIFICA_BAUD /
+							   ritorna_tempo_del_polling();
+
+		if ((float_t) (ritorna_tick_corrente() - tick_cambio_baud) >=
+			tick_timeout)
+		{
+			u32 cpsr = mfcpsr();
+
+			mtcpsr(cpsr | XIL_EXCEPTION_IRQ);
+			(void) imposta_baud_uart(baud_precedente);
+			indice_lettura_rx = indice_scrittura_rx;
+			mtcpsr(cpsr);
+
+			componi_telegramma_baud(baud_obiettivo, BAUD_RIPRISTINATO, 0U);
+			manda_telegramma_baud_main();
+
+			fase_baud = BAUD_STABILE;
+			trasmissione_sospesa = false;
+		}
+		else
+		{
+			/* Prova non ancora arrivata */
+		}
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+}
+
+/**
+ * @brief Salva la configurazione corrente per il ripristino
+ *
+ * @details Gira nel main loop, dopo ogni telegramma e come task periodico
+ * differito. Con un'accelerazione in corso salva la velocità raggiunta
+ * invece di quella assegnata, così dopo un reset la rampa riprende da dove
+ * era arrivata.
+ */
+static void salva_configurazione_ripristino(void)
+{
+	if (stato_connessione_app == true)
+	{
+		for (uint8_t indice = 0; indice < N_ENCODER_PROTOCOLLO; indice++)
+		{
+			if (configurazione_corrente.accelerazione[indice] != 0.0f)
+			{
+				configurazione_corrente.velocita[indice] =
+						(float_t) ritorna_velocita_encoder(indice);
+			}
+			else
+			{
+				/* Velocità costante, resta quella assegnata */
+			}
+		}
+	}
+	else
+	{
+		configurazione_corrente.lunghezza_connessione = 0;
+	}
+
+	salva_dati_ripristino(&configurazione_corrente,
+						  sizeof(configurazione_corrente));
+}
+
+
+/************************************
+ * GLOBAL FUNCTIONS
+ ************************************/
+
+void leggi_telegramma()
+{
+	uint8_t byte_ricevuti[L_TELEGRAMMA_FUNZ + L_CORNICE_TRAMA];
+	uint16_t lunghezza;
+	esito_coda_rx esito;
+
+	/* Il cambio di baud rate va fatto prima di leggere nuovi byte */
+	servi_negoziazione_baud();
+
+	esito = esamina_coda_rx(&lunghezza);
+
+	/* Risincronizzazione: scarto fino a un telegramma o a una trama valida */
+	while ((esito == CODA_RUMORE) || (esito == CODA_TRAMA_ERRATA) ||
+		   (esito == CODA_LUNGHEZZA_ERRATA))
+	{
+		if (esito != CODA_RUMORE)
+		{
+			trame_errate++;
+		}
+		else
+		{
+			/* Byte fuori trama, MISRA-2023-15.7 */
+		}
+
+		scarta_coda_rx(lunghezza);
+		esito = esamina_coda_rx(&lunghezza);
+	}
+
+	if (esito != CODA_INCOMPLETA)
+	{
+		const uint8_t *telegramma = byte_ricevuti;
+		bool con_trama = (esito == CODA_TRAMA);
+
+		if (con_trama == true)
+		{
+			estrai_coda_rx(byte_ricevuti, lunghezza + L_CORNICE_TRAMA);
+			telegramma = &byte_ricevuti[L_INTESTAZIONE_TRAMA];
+		}
+		else
+		{
+			estrai_coda_rx(byte_ricevuti, lunghezza);
+		}
+
+		if (stato_connessione_app == false)
+		{
+			leggi_telegramma_di_connessione(telegramma, lunghezza);
+
+			/* Le risposte seguono il protocollo della connessione */
+			protocollo_con_trama = con_trama;
+			configurazione_corrente.con_trama = con_trama;
+		}
+		else
+		{
+			leggi_telegramma_funzionamento(telegramma);
+		}
+		handshake_avvenuto = true;
+	}
 	else
 	{
-		leggi_telegramma_funzionamento();
+		/* Telegramma non ancora completo */
 	}
-	handshake_avvenuto = true;
+}
+
+bool ritorna_telegramma_in_attesa()
+{
+	uint16_t lunghezza;
+
+	return (esamina_coda_rx(&lunghezza) != CODA_INCOMPLETA);
 }
 
 void inizializza_uart()
@@ -434,42 +2256,198 @@ void inizializza_uart()
 	Config = XUartPs_LookupConfig(UART_BASEADDR);
 
 	XUartPs_CfgInitialize(&Uart_Ps, Config, Config->BaseAddress);
+
+	/* Parto con tutti gli interrupt dell'UART disabilitati */
+	XUartPs_SetInterruptMask(&Uart_Ps, 0U);
+
+	/*
+	 * La ricezione è gestita dall'interrupt a soglia della FIFO e dal
+	 * timeout, la trasmissione dall'interrupt di FIFO TX vuota
+	 */
+	connetti_interrupt_periferica(UART_INTR_ID,
+			(Xil_InterruptHandler) gestore_interrupt_uart, &Uart_Ps);
+
+	XUartPs_SetFifoThreshold(&Uart_Ps, SOGLIA_FIFO_RX);
+	XUartPs_SetRecvTimeout(&Uart_Ps, TIMEOUT_RX);
+	XUartPs_SetInterruptMask(&Uart_Ps, INTERRUPT_RX);
+
+	/* Spento fino alla sottoscrizione, poi al periodo richiesto */
+	(void) registra_task(PERIODO_TELEMETRIA_SPENTA, 0.0f,
+						 manda_telemetria_continua, BUDGET_TELEMETRIA);
+
+#if (WATCHDOG_TICK == 1U)
+	(void) registra_task(PERIODO_SALVA_RIPRISTINO, 0.0f,
+						 salva_configurazione_ripristino,
+						 BUDGET_SALVA_RIPRISTINO);
+#endif
 }
 
-void manda_telegramma_di_risposta()
+void ripristina_connessione_app()
 {
+	configurazione_ripristino salvata;
+	uint16_t letti = leggi_dati_ripristino(&salvata, sizeof(salvata));
+
+	if ((letti == sizeof(salvata)) &&
+		(salvata.lunghezza_connessione >= L_TELEGRAMMA_CONN) &&
+		(salvata.lunghezza_connessione <= L_TELEGRAMMA_CONN_ESTESO))
+	{
+		/* Stessi controlli di un telegramma appena ricevuto */
+		leggi_telegramma_di_connessione(salvata.telegramma_connessione,
+										salvata.lunghezza_connessione);
 
-	if((stato_connessione_app == true) && (handshake_avvenuto == true))
+		if (stato_connessione_app == true)
+		{
+			apri_comandi_encoder();
+			for (uint8_t indice = 0; indice < N_ENCODER_PROTOCOLLO; indice++)
+			{
+				assegna_velocita_encoder(indice, salvata.velocita[indice]);
+				assegna_accelerazione_encoder(indice,
+											  salvata.accelerazione[indice]);
+			}
+			chiudi_comandi_encoder();
+
+			configurazione_corrente = salvata;
+			protocollo_con_trama = salvata.con_trama;
+			formato_risposta = salvata.formato_risposta;
+
+			/* L'applicazione è rimasta al baud rate negoziato */
+			if (salvata.baud_rate != 0U)
+			{
+				/* Niente è ancora partito: la trasmissione è finita */
+				u32 cpsr = mfcpsr();
+
+				mtcpsr(cpsr | XIL_EXCEPTION_IRQ);
+				if (imposta_baud_uart(salvata.baud_rate) == false)
+				{
+					configurazione_corrente.baud_rate = 0;
+				}
+				else
+				{
+					/* Non succede niente, MISRA-2023-15.7 */
+				}
+
+				/* I byte ricevuti al baud rate predefinito sono illeggibili */
+				indice_lettura_rx = indice_scrittura_rx;
+				mtcpsr(cpsr);
+			}
+			else
+			{
+				/* Non succede niente, MISRA-2023-15.7 */
+			}
+
+			assegna_telemetria(salvata.frequenza_telemetria,
+							   salvata.maschera_telemetria);
+
+			/* Riprendo a rispondere senza attendere un nuovo telegramma */
+			handshake_avvenuto = true;
+		}
+		else
+		{
+			/* Configurazione non più accettata, attendo la connessione */
+		}
+	}
+	else
 	{
-		uint8_t buffer[L_TELEGRAMMA_RISP];  /* 96 bits = 12 bytes */
-		union float_bytes temp_vel;
-		uint16_t temp_cont;
+		/* Nessuna configurazione da ripristinare, MISRA-2023-15.7 */
+	}
+}
 
-		/* Mando velocita' del GIT 1*/
-		temp_vel.value = ritorna_velocita_encoder1();
-		(void) memcpy(buffer, temp_vel.bytes, sizeof(float_t));
+void manda_telegramma_di_risposta()
+{
 
-    	/* Mando velocita' del GIT 2*/
-		temp_vel.value = ritorna_velocita_encoder2();
-    	(void) memcpy(&buffer[4], temp_vel.bytes, sizeof(float_t));
+	if((stato_connessione_app == true) && (handshake_avvenuto == true) &&
+	   (trasmissione_sospesa == false))
+	{
+		uint8_t buffer[L_TELEGRAMMA_RISP_ESTESA];
+		uint16_t lunghezza;
 
-    	/* Mando conteggio del GIT 1 */
-    	temp_cont = ritorna_conteggio_encoder1();
-    	buffer[8] = temp_cont & 0xFFU;
-    	buffer[9] = (temp_cont >> 8U) & 0xFFU;
+		if (formato_risposta == RISPOSTA_ESTESA)
+		{
+			lunghezza = componi_risposta_estesa(buffer);
+		}
+		else
+		{
+			lunghezza = componi_risposta_classica(buffer);
+		}
 
-    	/* Mando conteggio del GIT 2 */
-    	temp_cont = ritorna_conteggio_encoder2();
-    	buffer[10] = temp_cont & 0xFFU;
-    	buffer[11] = (temp_cont >> 8U) & 0xFFU;
+    	/*
+    	 * Accodo il telegramma, la trasmissione vera e propria avviene
+    	 * nell'interrupt di FIFO TX vuota, fuori dal side loop
+    	 */
+    	if (accoda_telegramma(buffer, lunghezza) == true)
+    	{
+    		XUartPs_WriteReg(Uart_Ps.Config.BaseAddress, XUARTPS_IER_OFFSET,
+    						 XUARTPS_IXR_TXEMPTY);
+    	}
+    	else
+    	{
+    		telegrammi_tx_scartati++;
+    	}
 
-    	/* Mando identificativo del telegramma della risposta (fisso) */
-    	buffer[12] = IDENTIFICATIVO_RISPOSTA;
+#if (MISURA_LATENZA_ISR == 1U)
+    	/* Se richiesto, accodo un istogramma subito dopo la risposta */
+    	if (istogramma_richiesto != NESSUN_ISTOGRAMMA)
+    	{
+    		uint8_t istogramma[L_TELEGRAMMA_ISTOGRAMMA];
+
+    		serializza_istogramma_isr(istogramma_richiesto, istogramma);
+    		istogramma[L_TELEGRAMMA_ISTOGRAMMA - 1U] = IDENTIFICATIVO_ISTOGRAMMA;
+
+    		if (accoda_telegramma(istogramma, L_TELEGRAMMA_ISTOGRAMMA) == true)
+    		{
+    			XUartPs_WriteReg(Uart_Ps.Config.BaseAddress,
+    							 XUARTPS_IER_OFFSET, XUARTPS_IXR_TXEMPTY);
+
+    			if (reset_dopo_istogramma == true)
+    			{
+    				reset_istogrammi_isr();
+    			}
+    			else
+    			{
+    				/* Non succede niente, MISRA-2023-15.7 */
+    			}
+    		}
+    		else
+    		{
+    			telegrammi_tx_scartati++;
+    		}
+
+    		istogramma_richiesto = NESSUN_ISTOGRAMMA;
+    	}
+    	else
+    	{
+    		/* Non succede niente, MISRA-2023-15.7 */
+    	}
+#endif
 
-    	// Send the buffer over UART
-    	for(uint16_t indice = 0; indice < L_TELEGRAMMA_RISP; indice++)
+    	/* Annuncio del cambio di baud rate, ancora alla velocità corrente */
+    	if (fase_baud == BAUD_DA_ANNUNCIARE)
     	{
-    		XUartPs_SendByte(UART_BASEADDR, buffer[indice]);
+    		if (accoda_telegramma(telegramma_baud, L_TELEGRAMMA_BAUD) == true)
+    		{
+    			XUartPs_WriteReg(Uart_Ps.Config.BaseAddress,
+    							 XUARTPS_IER_OFFSET, XUARTPS_IXR_TXEMPTY);
+
+    			if (telegramma_baud[8] == BAUD_ACCETTATO)
+    			{
+    				/* Da qui il side loop tace fino alla fine della verifica */
+    				trasmissione_sospesa = true;
+    				fase_baud = BAUD_IN_CAMBIO;
+    			}
+    			else
+    			{
+    				fase_baud = BAUD_STABILE;
+    			}
+    		}
+    		else
+    		{
+    			/* Riprovo con la prossima risposta */
+    			telegrammi_tx_scartati++;
+    		}
+    	}
+    	else
+    	{
+    		/* Non succede niente, MISRA-2023-15.7 */
     	}
 
     	handshake_avvenuto = false;
@@ -484,3 +2462,20 @@ bool ritorna_stato_connessione_app()
 {
 	return stato_connessione_app;
 }
+
+uint32_t ritorna_telegrammi_tx_scartati()
+{
+	return telegrammi_tx_scartati;
+}
+
+uint32_t ritorna_byte_rx_persi()
+{
+	return byte_rx_persi;
+}
+
+uint32_t ritorna_trame_errate()
+{
+	return trame_errate;
+}
+
+#endif
@@ -0,0 +1,320 @@
+/**
+ ******************************************************************************
+ * @file    gestione_watchdog.c
+ * @author  Saimon Collaku
+ ******************************************************************************
+ */
+
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "gestione_watchdog.h"
+#include "gestione_task.h"
+#include "canale_amp.h"
+#include "xscuwdt.h"
+#include "xparameters.h"
+#include "xil_io.h"
+#include "xil_cache.h"
+#include "xil_misc_psreset_api.h"
+#include "ps7_init.h"
+#include <string.h>
+
+
+/******************************************************************************
+ * PRIVATE MACROS AND DEFINES
+ *****************************************************************************/
+
+/** @brief Identificativo del watchdog privato nella configurazione del BSP */
+#define WATCHDOG_DEVICE_ID			XPAR_PS7_SCUWDT_0_DEVICE_ID
+
+/**
+ * @brief Ricarica del watchdog per TIMEOUT_WATCHDOG_MS
+ *
+ * Il watchdog privato conta a APU_FREQ / 2, senza prescaler.
+ */
+#define CONTEGGI_TIMEOUT_WATCHDOG	((u32) (((APU_FREQ / 2U) / 1000U) * \
+											TIMEOUT_WATCHDOG_MS))
+
+/**
+ * @brief Registro REBOOT_STATUS dell'SLCR
+ *
+ * I bit 23:16 riportano il motivo dell'ultimo reset e sopravvivono a tutti
+ * i reset tranne il power-on.
+ */
+#define REGISTRO_REBOOT_STATUS		(XPS_SYS_CTRL_BASEADDR + 0x258U)
+
+/** @brief Bit AWDT0_RST e AWDT1_RST: reset dal watchdog di CPU0 o CPU1 */
+#define MASCHERA_RESET_AWDT			0x00060000U
+
+/** @brief Registro SLCR_LOCK dell'SLCR */
+#define REGISTRO_SLCR_LOCK			(XSLCR_BASEADDR + 0x4U)
+
+/** @brief Codice che blocca di nuovo le scritture nell'SLCR */
+#define CODICE_SLCR_LOCK			0x0000767BU
+
+/** @brief Firma di un'area di ripristino scritta da salva_dati_ripristino() */
+#define FIRMA_RIPRISTINO			0x52495052U
+
+/** @brief Variabile collegata nella sezione .ripristino, non azzerata all'avvio */
+#define DATI_RIPRISTINO				__attribute__((section(".ripristino")))
+
+
+/******************************************************************************
+ * TYPEDEFS
+ *****************************************************************************/
+
+/** @brief Configurazione conservata in DDR attraverso un reset */
+typedef struct
+{
+	/** @brief FIRMA_RIPRISTINO se il resto dell'area è stato scritto */
+	u32 firma;
+
+	/** @brief Byte validi in dati */
+	u32 lunghezza;
+
+	/** @brief Controllo di Fletcher su lunghezza e dati */
+	u32 controllo;
+
+	/** @brief Dati del modulo che ha salvato la configurazione */
+	uint8_t dati[DIM_DATI_RIPRISTINO];
+
+} area_ripristino;
+
+
+/******************************************************************************
+ * STATIC VARIABLES
+ *****************************************************************************/
+
+#if (WATCHDOG_TICK == 1U)
+/** @brief Istanza del driver del watchdog privato di questo core */
+static XScuWdt istanza_watchdog;
+
+/** @brief true se il watchdog è stato avviato */
+static bool watchdog_attivo = false;
+
+/** @brief Tick del side loop all'ultimo rinfresco del watchdog */
+static uint32_t tick_ultimo_rinfresco;
+#endif
+
+/** @brief true se l'ultimo reset è stato causato da un watchdog privato */
+static bool riavvio_da_watchdog = false;
+
+#if ((WATCHDOG_TICK == 1U) && (RUOLO_CORE != RUOLO_CORE_ENCODER))
+/**
+ * @brief Ultima configurazione salvata
+ *
+ * Fuori da .bss: il codice di avvio non la azzera e, in un reset senza
+ * spegnimento, la DDR ne conserva il contenuto. Firma e controllo scartano
+ * un'area mai scritta o scritta a metà.
+ */
+static area_ripristino area DATI_RIPRISTINO;
+#endif
+
+
+/******************************************************************************
+ * STATIC FUNCTION PROTOTYPES
+ *****************************************************************************/
+#if ((WATCHDOG_TICK == 1U) && (RUOLO_CORE != RUOLO_CORE_ENCODER))
+static u32 calcola_controllo(const uint8_t *dati, u32 lunghezza);
+#endif
+
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+#if ((WATCHDOG_TICK == 1U) && (RUOLO_CORE != RUOLO_CORE_ENCODER))
+/**
+ * @brief Calcola il controllo di Fletcher a 32 bit di un'area
+ *
+ * @param dati Byte da controllare
+ * @param lunghezza Numero di byte
+ * @return u32 Controllo, che dipende anche dalla lunghezza
+ */
+static u32 calcola_controllo(const uint8_t *dati, u32 lunghezza)
+{
+	u32 somma_1 = lunghezza % 65535U;
+	u32 somma_2 = somma_1;
+
+	for (u32 indice = 0; indice < lunghezza; indice++)
+	{
+		somma_1 = (somma_1 + dati[indice]) % 65535U;
+		somma_2 = (somma_2 + somma_1) % 65535U;
+	}
+
+	return (somma_2 << 16U) | somma_1;
+}
+#endif
+
+
+/******************************************************************************
+ * GLOBAL FUNCTIONS
+ *****************************************************************************/
+
+/**
+ * @brief Legge il motivo dell'ultimo reset e avvia il watchdog del core
+ *
+ * @details Va chiamata subito dopo init_platform(), prima delle altre
+ * inizializzazioni: un'inizializzazione bloccata in attesa di una
+ * periferica viene così interrotta dal watchdog. Il watchdog è in modalità
+ * watchdog, quindi alla scadenza resetta il sistema senza passare da un
+ * interrupt.
+ */
+void inizializza_watchdog(void)
+{
+#if (RUOLO_CORE != RUOLO_CORE_ENCODER)
+	u32 reboot_status = Xil_In32(REGISTRO_REBOOT_STATUS);
+
+	riavvio_da_watchdog = ((reboot_status & MASCHERA_RESET_AWDT) != 0U);
+
+	/*
+	 * Il prossimo reset riporta solo il suo motivo. ps7_post_config() lascia
+	 * l'SLCR bloccato: senza sblocco la scrittura verrebbe ignorata
+	 */
+	Xil_Out32(XSLCR_UNLOCK_ADDR, XSLCR_UNLOCK_CODE);
+	Xil_Out32(REGISTRO_REBOOT_STATUS, reboot_status & ~MASCHERA_RESET_AWDT);
+	Xil_Out32(REGISTRO_SLCR_LOCK, CODICE_SLCR_LOCK);
+#endif
+
+#if (WATCHDOG_TICK == 1U)
+	XScuWdt_Config *config = XScuWdt_LookupConfig(WATCHDOG_DEVICE_ID);
+
+	if ((config != NULL) &&
+		(XScuWdt_CfgInitialize(&istanza_watchdog, config,
+							   config->BaseAddr) == XST_SUCCESS))
+	{
+		/* Il flag del reset resta alto fino al power-on se non lo azzero */
+		XScuWdt_WriteReg(config->BaseAddr, XSCUWDT_RST_STS_OFFSET,
+						 XSCUWDT_RST_STS_RESET_FLAG_MASK);
+
+		XScuWdt_SetControlReg(&istanza_watchdog, 0U);
+		XScuWdt_LoadWdt(&istanza_watchdog, CONTEGGI_TIMEOUT_WATCHDOG);
+		XScuWdt_SetWdMode(&istanza_watchdog);
+		XScuWdt_Start(&istanza_watchdog);
+
+		tick_ultimo_rinfresco = ritorna_tick_corrente();
+		watchdog_attivo = true;
+	}
+	else
+	{
+		/* Senza watchdog il firmware funziona lo stesso */
+	}
+#endif
+}
+
+/**
+ * @brief Controlla il motore del tick e rinfresca il watchdog
+ *
+ * @details Va chiamata a ogni giro del main loop, e solo da lì: se il main
+ * loop resta bloccato il watchdog non viene più rinfrescato. Il rinfresco
+ * avviene solo se il contatore dei tick è avanzato dal rinfresco
+ * precedente, quindi un side loop fermo (timer, GIC o interrupt bloccato)
+ * porta al reset anche con il main loop vivo.
+ */
+void controlla_salute_watchdog(void)
+{
+#if (WATCHDOG_TICK == 1U)
+	uint32_t tick = ritorna_tick_corrente();
+
+	if ((watchdog_attivo == true) && (tick != tick_ultimo_rinfresco))
+	{
+		XScuWdt_RestartWdt(&istanza_watchdog);
+		tick_ultimo_rinfresco = tick;
+	}
+	else
+	{
+		/* Nessun tick dall'ultimo rinfresco, MISRA-2023-15.7 */
+	}
+#endif
+}
+
+/**
+ * @brief Indica se l'ultimo reset è stato causato da un watchdog
+ *
+ * @return bool true se il sistema è ripartito per la scadenza del watchdog
+ * di CPU0 o di CPU1
+ */
+bool ritorna_riavvio_da_watchdog(void)
+{
+	return riavvio_da_watchdog;
+}
+
+#if (RUOLO_CORE != RUOLO_CORE_ENCODER)
+/**
+ * @brief Salva la configurazione da ripristinare dopo un reset del watchdog
+ *
+ * @param dati Configurazione, in un formato noto solo al chiamante
+ * @param lunghezza Byte da salvare, al più DIM_DATI_RIPRISTINO
+ *
+ * @details Va chiamata dal main loop. La firma viene invalidata prima della
+ * copia e riscritta dopo il controllo; la pulizia della cache porta l'area
+ * in DDR, dove sopravvive al reset.
+ */
+void salva_dati_ripristino(const void *dati, uint16_t lunghezza)
+{
+#if (WATCHDOG_TICK == 1U)
+	if (lunghezza <= DIM_DATI_RIPRISTINO)
+	{
+		area.firma = 0;
+		(void) memcpy(area.dati, dati, lunghezza);
+		area.lunghezza = lunghezza;
+		area.controllo = calcola_controllo(area.dati, lunghezza);
+		area.firma = FIRMA_RIPRISTINO;
+
+		Xil_DCacheFlushRange((INTPTR) &area, sizeof(area));
+	}
+	else
+	{
+		/* Configurazione troppo grande, MISRA-2023-15.7 */
+	}
+#else
+	(void) dati;
+	(void) lunghezza;
+#endif
+}
+
+/**
+ * @brief Legge la configurazione salvata prima di un reset del watchdog
+ *
+ * @param dati Destinazione della configurazione
+ * @param dimensione Byte disponibili in dati
+ * @return uint16_t Byte letti; 0 se il reset non è dovuto al watchdog o se
+ * l'area non è valida
+ *
+ * @details Dopo un power-on o un reset esterno la configurazione salvata
+ * non viene mai restituita, anche se la DDR l'avesse conservata. Una
+ * configurazione letta viene invalidata: si ripristina una volta sola.
+ */
+uint16_t leggi_dati_ripristino(void *dati, uint16_t dimensione)
+{
+	uint16_t letti = 0;
+
+#if (WATCHDOG_TICK == 1U)
+	if ((riavvio_da_watchdog == true) &&
+		(area.firma == FIRMA_RIPRISTINO) &&
+		(area.lunghezza <= DIM_DATI_RIPRISTINO) &&
+		(area.lunghezza <= dimensione) &&
+		(area.controllo == calcola_controllo(area.dati, area.lunghezza)))
+	{
+		(void) memcpy(dati, area.dati, area.lunghezza);
+		letti = (uint16_t) area.lunghezza;
+
+		area.firma = 0;
+		Xil_DCacheFlushRange((INTPTR) &area, sizeof(area));
+	}
+	else
+	{
+		/* Niente da ripristinare, MISRA-2023-15.7 */
+	}
+#else
+	(void) dati;
+	(void) dimensione;
+#endif
+
+	return letti;
+}
+#endif
+
+
+/****************** (C) COPYRIGHT GITSIM ***** END OF FILE *******************/
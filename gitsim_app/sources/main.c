@@ -13,24 +13,130 @@
 #include "gestione_polling.h"
 #include "emulazione_encoder.h"
 #include "side.h"
+#include "gestione_task.h"
+#include "sezioni_ocm.h"
+#include "canale_amp.h"
+#include "ponte_amp.h"
+#include "gestione_watchdog.h"
 #include "platform.h"
+#include "xil_exception.h"
+#include "xpseudo_asm.h"
+
+/************************************
+ * PRIVATE MACROS AND DEFINES
+ ************************************/
+
+/**
+ * @brief Addormenta il main loop in WFI quando non ha lavoro
+ *
+ * Con valore 1U il core si ferma tra un interrupt e l'altro invece di
+ * interrogare le code a vuoto, senza contendere al side loop il bus della
+ * memoria. Con valore 0U il main loop gira sempre, come in origine.
+ */
+#ifndef ATTESA_IN_WFI
+#define ATTESA_IN_WFI	1U
+#endif
+
+/************************************
+ * STATIC FUNCTION PROTOTYPES
+ ************************************/
+#if (ATTESA_IN_WFI == 1U)
+static void attendi_evento(void);
+#endif
+
+/************************************
+ * STATIC FUNCTIONS
+ ************************************/
+
+#if (ATTESA_IN_WFI == 1U)
+/**
+ * @brief Ferma il core finché un interrupt non porta nuovo lavoro
+ *
+ * @details Il controllo delle code avviene con l'IRQ mascherato: un
+ * interrupt che arriva dopo il controllo resta pendente e fa uscire subito
+ * da WFI, che si risveglia anche con l'IRQ mascherato. L'handler viene
+ * eseguito appena la maschera viene tolta.
+ *
+ * Svegliano il core il tick del side loop, l'UART (telegrammi e fine
+ * trasmissione) e, su CPU0 in AMP, il tick di supervisione, che bastano
+ * anche a raccogliere la telemetria di CPU1 entro un tick.
+ */
+static void attendi_evento(void)
+{
+	u32 cpsr = mfcpsr();
+	bool lavoro;
+
+	mtcpsr(cpsr | XIL_EXCEPTION_IRQ);
+
+	lavoro = ritorna_task_differiti_in_attesa();
+#if (RUOLO_CORE != RUOLO_CORE_ENCODER)
+	lavoro = lavoro || ritorna_telegramma_in_attesa();
+#endif
+
+	if (lavoro == false)
+	{
+		dsb();
+		__asm__ __volatile__ ("wfi" : : : "memory");
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+
+	mtcpsr(cpsr);
+}
+#endif
 
 /************************************
  * MAIN
  ************************************/
 int main_loop()
 {
+	/* Porto in OCM il percorso del tick, prima di ogni interrupt */
+	copia_sezioni_ocm();
+
 	/* Inizializzazione*/
 	init_platform();
+
+	/* Da qui un'inizializzazione bloccata viene interrotta dal watchdog */
+	inizializza_watchdog();
+#if (RUOLO_CORE == RUOLO_CORE_SINGOLO)
+	inizializza_polling_timer();
+	inizializza_side_loop();
+	inizializza_uart();
+	inizializza_variabili_encoder();
+	ripristina_connessione_app();
+#elif (RUOLO_CORE == RUOLO_CORE_PROTOCOLLO)
+	/* Preparo gli anelli e sveglio CPU1, che emula gli encoder */
+	inizializza_canale_amp();
+	avvia_cpu1();
 	inizializza_polling_timer();
 	inizializza_side_loop();
 	inizializza_uart();
 	inizializza_variabili_encoder();
+	ripristina_connessione_app();
+#else
+	/* Attendo gli anelli di CPU0; niente UART su questo core */
+	inizializza_canale_amp();
+	inizializza_variabili_encoder();
+	inizializza_polling_timer();
+	inizializza_side_loop();
+#endif
 
 	/* Main loop */
 	while(1)
 	{
+#if (RUOLO_CORE != RUOLO_CORE_ENCODER)
 		leggi_telegramma();
+#endif
+#if (RUOLO_CORE == RUOLO_CORE_PROTOCOLLO)
+		servi_connessione_amp();
+#endif
+		esegui_task_differiti();
+		controlla_salute_watchdog();
+#if (ATTESA_IN_WFI == 1U)
+		attendi_evento();
+#endif
 	};
 
 	cleanup_platform();
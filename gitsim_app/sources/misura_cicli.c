@@ -0,0 +1,89 @@
+/**
+ ******************************************************************************
+ * @file    misura_cicli.c
+ * @author  Saimon Collaku
+ ******************************************************************************
+ */
+
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "misura_cicli.h"
+#include "xpseudo_asm.h"
+#include "xreg_cortexa9.h"
+#include "sezioni_ocm.h"
+
+
+/******************************************************************************
+ * PRIVATE MACROS AND DEFINES
+ *****************************************************************************/
+
+/** @brief Bit E del registro PMCR: abilita tutti i contatori della PMU */
+#define PMCR_ABILITA			0x01U
+
+/** @brief Bit C del registro PMCR: azzera il contatore di cicli */
+#define PMCR_RESET_CICLI		0x04U
+
+/** @brief Bit 31 di PMCNTENSET: abilita il contatore di cicli */
+#define PMCNTEN_CICLI			0x80000000U
+
+
+/******************************************************************************
+ * GLOBAL FUNCTIONS
+ *****************************************************************************/
+
+void inizializza_contatore_cicli(void)
+{
+	u32 pmcr = mfcp(XREG_CP15_PERF_MONITOR_CTRL);
+
+	/* Abilito la PMU e azzero il contatore dei cicli */
+	pmcr |= (PMCR_ABILITA | PMCR_RESET_CICLI);
+	mtcp(XREG_CP15_PERF_MONITOR_CTRL, pmcr);
+
+	/* Abilito il solo contatore dei cicli */
+	mtcp(XREG_CP15_COUNT_ENABLE_SET, PMCNTEN_CICLI);
+}
+
+FUNZIONE_OCM u32 leggi_contatore_cicli(void)
+{
+	return (u32) mfcp(XREG_CP15_PERF_CYCLE_COUNTER);
+}
+
+void reset_statistica_cicli(statistica_cicli *statistica)
+{
+	statistica->ultimo = 0;
+	statistica->minimo = UINT32_MAX;
+	statistica->massimo = 0;
+	statistica->somma = 0;
+	statistica->n_campioni = 0;
+}
+
+FUNZIONE_OCM void aggiorna_statistica_cicli(statistica_cicli *statistica, u32 cicli)
+{
+	statistica->ultimo = cicli;
+
+	if (cicli < statistica->minimo)
+	{
+		statistica->minimo = cicli;
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+
+	if (cicli > statistica->massimo)
+	{
+		statistica->massimo = cicli;
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+
+	statistica->somma = statistica->somma + cicli;
+	statistica->n_campioni++;
+}
+
+
+/****************** (C) COPYRIGHT GITSIM ***** END OF FILE *******************/
@@ -0,0 +1,236 @@
+/**
+ ******************************************************************************
+ * @file    misura_isr.c
+ * @author  Saimon Collaku
+ ******************************************************************************
+ */
+
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "misura_isr.h"
+#include "misura_cicli.h"
+#include "gestione_polling.h"
+#include "xscutimer_hw.h"
+#include "xtime_l.h"
+#include "sezioni_ocm.h"
+#include <string.h>
+
+
+/******************************************************************************
+ * PRIVATE MACROS AND DEFINES
+ *****************************************************************************/
+
+/** @brief Indirizzo base del timer SCU privato */
+#define SCUTIMER_BASEADDR			XPAR_PS7_SCUTIMER_0_BASEADDR
+
+/** @brief Larghezza di classe della latenza: 32 conteggi, circa 98 ns */
+#define CLASSE_LATENZA				32U
+
+/** @brief Larghezza di classe della durata: 128 cicli CPU, circa 197 ns */
+#define CLASSE_DURATA				128U
+
+/** @brief Larghezza di classe del periodo: 16 conteggi, circa 49 ns */
+#define CLASSE_PERIODO				16U
+
+/** @brief Distanza dell'origine del periodo dal periodo del tick */
+#define ANTICIPO_ORIGINE_PERIODO	((N_CLASSI_ISTOGRAMMA / 2U) * CLASSE_PERIODO)
+
+
+/******************************************************************************
+ * STATIC VARIABLES
+ *****************************************************************************/
+
+/** @brief Istogrammi di latenza, durata e periodo */
+static istogramma_isr istogrammi[N_ISTOGRAMMI] DATI_OCM;
+
+/** @brief Larghezza di classe di ogni istogramma */
+static const u32 larghezza_classe[N_ISTOGRAMMI] COSTANTI_OCM =
+{
+	CLASSE_LATENZA, CLASSE_DURATA, CLASSE_PERIODO
+};
+
+/**
+ * @brief Origine della prima classe di ogni istogramma
+ *
+ * Le classi del periodo sono centrate sul periodo del tick al momento del
+ * reset (timer SCU e timer globale contano entrambi a APU_FREQ / 2): metà
+ * sotto e metà sopra.
+ */
+static u32 origine_classe[N_ISTOGRAMMI] DATI_OCM;
+
+/** @brief Tempo del timer globale all'ingresso corrente */
+static XTime tempo_ingresso DATI_OCM;
+
+/** @brief Tempo del timer globale all'ingresso precedente, 0 se assente */
+static XTime tempo_ingresso_precedente DATI_OCM;
+
+/** @brief Contatore di cicli all'ingresso corrente */
+static u32 cicli_ingresso DATI_OCM;
+
+/** @brief Latenza misurata all'ingresso corrente, in conteggi */
+static u32 latenza_ingresso DATI_OCM;
+
+
+/******************************************************************************
+ * STATIC FUNCTION PROTOTYPES
+ *****************************************************************************/
+static void aggiorna_istogramma(uint8_t tipo, u32 valore);
+static void scrivi_u32(uint8_t *buffer, u32 valore);
+
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+/**
+ * @brief Accumula una misura in un istogramma
+ *
+ * @param tipo Indice dell'istogramma
+ * @param valore Misura nelle unità dell'istogramma
+ *
+ * @details I valori sotto l'origine finiscono nella prima classe, quelli
+ * oltre l'ultima classe nell'ultima.
+ */
+FUNZIONE_OCM static void aggiorna_istogramma(uint8_t tipo, u32 valore)
+{
+	istogramma_isr *istogramma = &istogrammi[tipo];
+	u32 classe = 0;
+
+	if (valore >= origine_classe[tipo])
+	{
+		classe = (valore - origine_classe[tipo]) / larghezza_classe[tipo];
+	}
+	else
+	{
+		/* Sotto l'origine, MISRA-2023-15.7 */
+	}
+
+	if (classe >= N_CLASSI_ISTOGRAMMA)
+	{
+		classe = N_CLASSI_ISTOGRAMMA - 1U;
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+
+	istogramma->classi[classe]++;
+
+	if (valore < istogramma->minimo)
+	{
+		istogramma->minimo = valore;
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+
+	if (valore > istogramma->massimo)
+	{
+		istogramma->massimo = valore;
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+
+	istogramma->n_campioni++;
+}
+
+/**
+ * @brief Scrive un u32 in little endian
+ *
+ * @param buffer Destinazione di 4 byte
+ * @param valore Valore da scrivere
+ */
+static void scrivi_u32(uint8_t *buffer, u32 valore)
+{
+	buffer[0] = (uint8_t) (valore & 0xFFU);
+	buffer[1] = (uint8_t) ((valore >> 8U) & 0xFFU);
+	buffer[2] = (uint8_t) ((valore >> 16U) & 0xFFU);
+	buffer[3] = (uint8_t) ((valore >> 24U) & 0xFFU);
+}
+
+
+/******************************************************************************
+ * GLOBAL FUNCTIONS
+ *****************************************************************************/
+
+void inizializza_misura_isr(void)
+{
+	inizializza_contatore_cicli();
+	reset_istogrammi_isr();
+}
+
+FUNZIONE_OCM void ingresso_misura_isr(void)
+{
+	/*
+	 * Il contatore SCU scende dalla ricarica - 1 dopo la scadenza; la
+	 * ricarica è più lunga di TIMER_LV se il tick è degradato
+	 */
+	u32 contatore = Xil_In32(SCUTIMER_BASEADDR + XSCUTIMER_COUNTER_OFFSET);
+
+	cicli_ingresso = leggi_contatore_cicli();
+	XTime_GetTime(&tempo_ingresso);
+	latenza_ingresso = ((ritorna_ricarica_timer() - 1U) - contatore) * TIMER_PSC;
+}
+
+FUNZIONE_OCM void uscita_misura_isr(void)
+{
+	u32 durata = leggi_contatore_cicli() - cicli_ingresso;
+
+	aggiorna_istogramma(ISTOGRAMMA_LATENZA, latenza_ingresso);
+	aggiorna_istogramma(ISTOGRAMMA_DURATA, durata);
+
+	if (tempo_ingresso_precedente != 0U)
+	{
+		aggiorna_istogramma(ISTOGRAMMA_PERIODO,
+				(u32) (tempo_ingresso - tempo_ingresso_precedente));
+	}
+	else
+	{
+		/* Primo ingresso, nessun periodo da misurare */
+	}
+
+	tempo_ingresso_precedente = tempo_ingresso;
+}
+
+void serializza_istogramma_isr(uint8_t tipo, uint8_t *buffer)
+{
+	const istogramma_isr *istogramma = &istogrammi[tipo];
+
+	buffer[0] = tipo;
+	scrivi_u32(&buffer[1], larghezza_classe[tipo]);
+	scrivi_u32(&buffer[5], origine_classe[tipo]);
+	scrivi_u32(&buffer[9], istogramma->minimo);
+	scrivi_u32(&buffer[13], istogramma->massimo);
+	scrivi_u32(&buffer[17], istogramma->n_campioni);
+
+	for (uint8_t classe = 0; classe < N_CLASSI_ISTOGRAMMA; classe++)
+	{
+		scrivi_u32(&buffer[21U + (4U * classe)], istogramma->classi[classe]);
+	}
+}
+
+void reset_istogrammi_isr(void)
+{
+	for (uint8_t tipo = 0; tipo < N_ISTOGRAMMI; tipo++)
+	{
+		(void) memset(istogrammi[tipo].classi, 0,
+					  sizeof(istogrammi[tipo].classi));
+		istogrammi[tipo].minimo = UINT32_MAX;
+		istogrammi[tipo].massimo = 0;
+		istogrammi[tipo].n_campioni = 0;
+	}
+
+	origine_classe[ISTOGRAMMA_PERIODO] =
+			(TIMER_PSC * ritorna_ricarica_timer()) - ANTICIPO_ORIGINE_PERIODO;
+
+	/* Il prossimo periodo parte da un ingresso nuovo */
+	tempo_ingresso_precedente = 0;
+}
+
+
+/****************** (C) COPYRIGHT GITSIM ***** END OF FILE *******************/
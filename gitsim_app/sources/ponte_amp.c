@@ -0,0 +1,539 @@
+/**
+ ******************************************************************************
+ * @file    ponte_amp.c
+ * @author  Saimon Collaku
+ ******************************************************************************
+ */
+
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "ponte_amp.h"
+#include "emulazione_encoder.h"
+#include "gestione_uart.h"
+#include "gestione_polling.h"
+#include "side.h"
+#include "sezioni_ocm.h"
+#include "gestione_task.h"
+
+
+/******************************************************************************
+ * PRIVATE MACROS AND DEFINES
+ *****************************************************************************/
+
+/**
+ * @brief Tick mancanti massimi di un gruppo programmato su CPU1
+ *
+ * Metà dell'intervallo in cui il confronto con segno tra tick è valido.
+ */
+#define MAX_TICK_PROGRAMMATI_AMP	1073741824
+
+/**
+ * @brief Messaggi di un gruppo programmato nel caso peggiore
+ *
+ * Apertura, velocità e accelerazione di ogni encoder (comando 0x08) e
+ * chiusura.
+ */
+#define MESSAGGI_GRUPPO_PROGRAMMATO	(2U + (2U * N_ENCODER))
+
+/**
+ * @brief Messaggi di un gruppo immediato nel caso peggiore
+ *
+ * Apertura, PPR e passo di ogni encoder, diametro (telegramma di
+ * connessione) e chiusura.
+ */
+#define MESSAGGI_GRUPPO_IMMEDIATO	(3U + (2U * N_ENCODER))
+
+
+/******************************************************************************
+ * STATIC VARIABLES
+ *****************************************************************************/
+
+#if (RUOLO_CORE == RUOLO_CORE_PROTOCOLLO)
+/** @brief Ultima velocità ricevuta da CPU1 per ogni encoder, in m/s */
+static double_t velocita_ricevuta[N_ENCODER];
+
+/** @brief Ultimo conteggio ricevuto da CPU1 per ogni encoder */
+static int16_t conteggio_ricevuto[N_ENCODER];
+
+/**
+ * @brief Ultimo conteggio cumulativo ricevuto da CPU1 per ogni encoder
+ *
+ * Arriva già sommato da CPU1: un messaggio perso nell'anello ritarda il
+ * valore ma non perde impulsi.
+ */
+static int64_t conteggio_totale_ricevuto[N_ENCODER];
+
+/** @brief Ultimo stato della connessione mandato a CPU1 */
+static bool connessione_inviata;
+
+/** @brief true se l'apertura dell'ultimo gruppo immediato è partita */
+static bool gruppo_immediato_aperto;
+
+/** @brief Gruppi programmati non partiti per anello pieno */
+static uint32_t programmati_non_inviati;
+#elif (RUOLO_CORE == RUOLO_CORE_ENCODER)
+/** @brief Stato della connessione ricevuto da CPU0 */
+static volatile bool connessione_ricevuta DATI_OCM;
+
+/**
+ * @brief true se il gruppo programmato in arrivo è stato rifiutato
+ *
+ * I suoi comandi vanno scartati fino alla chiusura: applicati subito
+ * avrebbero effetto al tick sbagliato.
+ */
+static bool gruppo_rifiutato DATI_OCM;
+
+/**
+ * @brief Massimo scarto tra l'istante richiesto da CPU0 per un gruppo
+ * programmato e quello del tick di CPU1 che lo applica, in conteggi del
+ * timer globale
+ *
+ * Da leggere con il debugger: arrotondando al tick più vicino resta entro
+ * mezzo tick di CPU1.
+ */
+static XTime scarto_massimo_programmati DATI_OCM;
+
+/**
+ * @brief Gruppi programmati applicati a più di mezzo tick dall'istante
+ * richiesto, arrivati in ritardo o troppo lontani
+ */
+static uint32_t programmati_fuori_tempo DATI_OCM;
+
+
+/******************************************************************************
+ * STATIC FUNCTION PROTOTYPES
+ *****************************************************************************/
+static bool apri_programmati_al_tempo(XTime tempo);
+static void controlla_tempo_programmati(uint32_t tick, XTime tempo);
+
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+/**
+ * @brief Apre il gruppo programmato per un istante del timer globale
+ *
+ * @param tempo Istante mandato da CPU0, in conteggi del timer globale
+ * @return bool true se il gruppo è stato aperto
+ *
+ * @details I tick di CPU0 e CPU1 hanno periodi diversi: l'istante viene
+ * riportato sul tick di CPU1 più vicino. Un istante già passato apre il
+ * gruppo sul tick in corso, che lo applica subito.
+ */
+FUNZIONE_OCM static bool apri_programmati_al_tempo(XTime tempo)
+{
+	int64_t mancanti = ritorna_tick_del_tempo(tempo);
+	bool aperto = false;
+
+	if (mancanti < -1)
+	{
+		/* Qui tick_corrente - 1 è il tick in corso */
+		mancanti = -1;
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+
+	if (mancanti <= MAX_TICK_PROGRAMMATI_AMP)
+	{
+		uint32_t tick = ritorna_tick_corrente() + (uint32_t) mancanti;
+
+		aperto = apri_comandi_programmati(tick);
+		if (aperto == true)
+		{
+			controlla_tempo_programmati(tick, tempo);
+		}
+		else
+		{
+			/* Coda piena, contato da emulazione_encoder */
+		}
+	}
+	else
+	{
+		programmati_fuori_tempo++;
+	}
+
+	return aperto;
+}
+
+/**
+ * @brief Controlla che un gruppo programmato cada all'istante richiesto
+ *
+ * @param tick Tick di CPU1 scelto per il gruppo
+ * @param tempo Istante richiesto da CPU0, in conteggi del timer globale
+ *
+ * @details Il gruppo viene applicato dall'interrupt del timer SCU che serve
+ * il tick, cioè all'istante ritorna_tempo_del_tick(tick).
+ */
+FUNZIONE_OCM static void controlla_tempo_programmati(uint32_t tick,
+													 XTime tempo)
+{
+	XTime previsto = ritorna_tempo_del_tick(tick);
+	XTime scarto;
+
+	if (previsto >= tempo)
+	{
+		scarto = previsto - tempo;
+	}
+	else
+	{
+		scarto = tempo - previsto;
+	}
+
+	if (scarto > scarto_massimo_programmati)
+	{
+		scarto_massimo_programmati = scarto;
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+
+	if (scarto > (XTime) (ritorna_conteggi_tick() / 2U))
+	{
+		programmati_fuori_tempo++;
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+}
+#endif
+
+
+/******************************************************************************
+ * GLOBAL FUNCTIONS
+ *****************************************************************************/
+
+#if (RUOLO_CORE == RUOLO_CORE_PROTOCOLLO)
+/*
+ * Su CPU0 l'API di emulazione_encoder.h è un proxy: i comandi diventano
+ * messaggi per CPU1, le letture restituiscono l'ultima telemetria. Tutte le
+ * funzioni che mandano comandi vanno chiamate dal main loop, unico
+ * produttore dell'anello dei comandi.
+ */
+
+void inizializza_variabili_encoder(void)
+{
+	for (uint8_t indice = 0; indice < N_ENCODER; indice++)
+	{
+		velocita_ricevuta[indice] = 0;
+		conteggio_ricevuto[indice] = 0;
+		conteggio_totale_ricevuto[indice] = 0;
+	}
+
+	(void) invia_comando_amp((uint8_t) MESSAGGIO_INIZIALIZZA, 0, 0, 0.0f);
+
+	/* Anche il tick di CPU0 riparte dal nominale */
+	richiedi_tick_nominale();
+}
+
+double_t ritorna_velocita_encoder(uint8_t indice)
+{
+	return velocita_ricevuta[indice];
+}
+
+int16_t ritorna_conteggio_encoder(uint8_t indice)
+{
+	return conteggio_ricevuto[indice];
+}
+
+int64_t ritorna_conteggio_totale_encoder(uint8_t indice)
+{
+	return conteggio_totale_ricevuto[indice];
+}
+
+void assegna_ppr_encoder(uint8_t indice, uint16_t ppr)
+{
+	(void) invia_comando_amp((uint8_t) MESSAGGIO_PPR, indice,
+							 (int16_t) ppr, 0.0f);
+}
+
+void assegna_diametro_ruota(float_t diametro)
+{
+	(void) invia_comando_amp((uint8_t) MESSAGGIO_DIAMETRO, 0, 0, diametro);
+}
+
+void assegna_velocita_encoder(uint8_t indice, float_t vel)
+{
+	(void) invia_comando_amp((uint8_t) MESSAGGIO_VELOCITA, indice, 0, vel);
+}
+
+void assegna_accelerazione_encoder(uint8_t indice, float_t acc)
+{
+	(void) invia_comando_amp((uint8_t) MESSAGGIO_ACCELERAZIONE, indice, 0,
+							 acc);
+}
+
+void apri_comandi_encoder(void)
+{
+	/*
+	 * Apro solo se c'è posto per tutto il gruppo: senza la chiusura CPU1
+	 * ignorerebbe tutti i comandi successivi. Altrimenti i comandi partono
+	 * sciolti e possono avere effetto su tick diversi
+	 */
+	gruppo_immediato_aperto =
+		((ritorna_spazio_comandi_amp() >= MESSAGGI_GRUPPO_IMMEDIATO) &&
+		 (invia_comando_amp((uint8_t) MESSAGGIO_APRI_COMANDI, 0, 0,
+							0.0f) == true));
+}
+
+void chiudi_comandi_encoder(void)
+{
+	if (gruppo_immediato_aperto == true)
+	{
+		/* Il posto è stato riservato dall'apertura */
+		(void) invia_comando_amp((uint8_t) MESSAGGIO_CHIUDI_COMANDI, 0, 0,
+								 0.0f);
+		gruppo_immediato_aperto = false;
+	}
+	else
+	{
+		/* Gruppo non aperto, MISRA-2023-15.7 */
+	}
+}
+
+void aggiorna_passo_encoder(uint8_t indice)
+{
+	(void) invia_comando_amp((uint8_t) MESSAGGIO_PASSO, indice, 0, 0.0f);
+}
+
+bool apri_comandi_programmati(uint32_t tick)
+{
+	/* CPU1 ha un altro tick: il gruppo viaggia come istante comune */
+	XTime tempo = ritorna_tempo_del_tick(tick);
+	bool aperto = false;
+
+	/*
+	 * Apro solo se c'è posto per tutto il gruppo: senza la chiusura CPU1
+	 * resterebbe con il gruppo aperto
+	 */
+	if ((ritorna_spazio_comandi_amp() >= MESSAGGI_GRUPPO_PROGRAMMATO) &&
+		(invia_comando_lungo_amp((uint8_t) MESSAGGIO_APRI_PROGRAMMATI,
+								 (int64_t) tempo) == true))
+	{
+		aperto = true;
+	}
+	else
+	{
+		programmati_non_inviati++;
+	}
+
+	return aperto;
+}
+
+void chiudi_comandi_programmati(void)
+{
+	if (invia_comando_amp((uint8_t) MESSAGGIO_CHIUDI_PROGRAMMATI, 0, 0,
+						  0.0f) == false)
+	{
+		/* Il posto era riservato: CPU1 si riallinea all'inizializzazione */
+		programmati_non_inviati++;
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+}
+
+uint32_t ritorna_comandi_programmati_scartati(void)
+{
+	return programmati_non_inviati;
+}
+
+/**
+ * @brief Raccoglie la telemetria di CPU1 e manda la risposta
+ *
+ * @details Da chiamare dal side loop di CPU0, unico produttore della coda
+ * di trasmissione UART. Quando arriva la telemetria dell'ultimo encoder il
+ * periodo è completo e parte il telegramma di risposta.
+ */
+void servi_telemetria_amp(void)
+{
+	messaggio_amp messaggio;
+
+	while (ricevi_telemetria_amp(&messaggio) == true)
+	{
+		if (messaggio.indice < N_ENCODER)
+		{
+			velocita_ricevuta[messaggio.indice] = messaggio.valore;
+			conteggio_ricevuto[messaggio.indice] = messaggio.intero;
+			conteggio_totale_ricevuto[messaggio.indice] =
+				messaggio.intero_lungo;
+
+			if (messaggio.indice == (N_ENCODER - 1U))
+			{
+				manda_telegramma_di_risposta();
+			}
+			else
+			{
+				/* Periodo non ancora completo */
+			}
+		}
+		else
+		{
+			/* Messaggio non valido, MISRA-2023-15.7 */
+		}
+	}
+}
+
+/**
+ * @brief Manda a CPU1 lo stato della connessione quando cambia
+ *
+ * @details Da chiamare dal main loop dopo leggi_telegramma(), così lo
+ * stato arriva a CPU1 dopo i parametri del telegramma di connessione.
+ */
+void servi_connessione_amp(void)
+{
+	bool connessione = ritorna_stato_connessione_app();
+
+	if (connessione != connessione_inviata)
+	{
+		if (invia_comando_amp((uint8_t) MESSAGGIO_CONNESSIONE, 0,
+							  (connessione == true) ? 1 : 0, 0.0f) == true)
+		{
+			connessione_inviata = connessione;
+		}
+		else
+		{
+			/* Anello pieno, riprovo al prossimo giro */
+		}
+	}
+	else
+	{
+		/* Non succede niente, MISRA-2023-15.7 */
+	}
+}
+
+#elif (RUOLO_CORE == RUOLO_CORE_ENCODER)
+
+bool ritorna_stato_connessione_app(void)
+{
+	return connessione_ricevuta;
+}
+
+/**
+ * @brief Esegue i comandi arrivati da CPU0
+ *
+ * @details Da chiamare nel side loop di CPU1 dopo esegui_task_tick() e
+ * prima di aggiorna_variabili_encoder(): i comandi vengono passati alla
+ * casella degli encoder e hanno effetto nello stesso tick. Un gruppo aperto da
+ * MESSAGGIO_APRI_COMANDI resta in attesa fino alla chiusura, anche se
+ * arriva a cavallo di due tick.
+ */
+FUNZIONE_OCM void servi_comandi_amp(void)
+{
+	messaggio_amp messaggio;
+
+	while (ricevi_comando_amp(&messaggio) == true)
+	{
+		switch (messaggio.tipo)
+		{
+			case MESSAGGIO_VELOCITA:
+				if (gruppo_rifiutato == false)
+				{
+					assegna_velocita_encoder(messaggio.indice,
+											 messaggio.valore);
+				}
+				else
+				{
+					/* Comando di un gruppo rifiutato, MISRA-2023-15.7 */
+				}
+				break;
+
+			case MESSAGGIO_ACCELERAZIONE:
+				if (gruppo_rifiutato == false)
+				{
+					assegna_accelerazione_encoder(messaggio.indice,
+												  messaggio.valore);
+				}
+				else
+				{
+					/* Comando di un gruppo rifiutato, MISRA-2023-15.7 */
+				}
+				break;
+
+			case MESSAGGIO_PPR:
+				assegna_ppr_encoder(messaggio.indice,
+									(uint16_t) messaggio.intero);
+				break;
+
+			case MESSAGGIO_DIAMETRO:
+				assegna_diametro_ruota(messaggio.valore);
+				break;
+
+			case MESSAGGIO_PASSO:
+				aggiorna_passo_encoder(messaggio.indice);
+				break;
+
+			case MESSAGGIO_APRI_COMANDI:
+				apri_comandi_encoder();
+				break;
+
+			case MESSAGGIO_CHIUDI_COMANDI:
+				chiudi_comandi_encoder();
+				break;
+
+			case MESSAGGIO_INIZIALIZZA:
+				/* Riparte anche da un gruppo rimasto aperto */
+				gruppo_rifiutato = false;
+				inizializza_variabili_encoder();
+				break;
+
+			case MESSAGGIO_CONNESSIONE:
+				connessione_ricevuta = (messaggio.intero != 0);
+				break;
+
+			case MESSAGGIO_PERIODO_TICK:
+				/* Se non è valido resta il periodo precedente */
+				(void) assegna_periodo_side_loop(messaggio.valore);
+				break;
+
+			case MESSAGGIO_APRI_PROGRAMMATI:
+				gruppo_rifiutato = (apri_programmati_al_tempo(
+						(XTime) messaggio.intero_lungo) == false);
+				break;
+
+			case MESSAGGIO_CHIUDI_PROGRAMMATI:
+				if (gruppo_rifiutato == false)
+				{
+					chiudi_comandi_programmati();
+				}
+				else
+				{
+					gruppo_rifiutato = false;
+				}
+				break;
+
+			default:
+				/* Non succede niente */
+				break;
+		}
+	}
+}
+
+/**
+ * @brief Manda a CPU0 velocità e conteggi del periodo e li azzera
+ *
+ * @details Task periodico di CPU1 al posto del side loop secondario.
+ */
+FUNZIONE_OCM void manda_telemetria_amp(void)
+{
+	for (uint8_t indice = 0; indice < N_ENCODER; indice++)
+	{
+		(void) invia_telemetria_amp(indice, ritorna_conteggio_encoder(indice),
+									ritorna_conteggio_totale_encoder(indice),
+									(float_t) ritorna_velocita_encoder(indice));
+	}
+
+	reset_conteggi_encoder();
+}
+
+#endif
+
+
+/****************** (C) COPYRIGHT GITSIM ***** END OF FILE *******************/
@@ -0,0 +1,64 @@
+/**
+ ******************************************************************************
+ * @file    sezioni_ocm.c
+ * @author  Saimon Collaku
+ ******************************************************************************
+ */
+
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "sezioni_ocm.h"
+#include "xil_types.h"
+#include "xil_cache.h"
+#include <string.h>
+
+
+/******************************************************************************
+ * LINKER SCRIPT SYMBOLS
+ *****************************************************************************/
+
+#if (CODICE_IN_OCM == 1U)
+/** @brief Simboli definiti in src/lscript.ld per le sezioni in OCM */
+extern u8 __ocm_text_start[];
+extern u8 __ocm_text_end[];
+extern u8 __ocm_text_load[];
+extern u8 __ocm_data_start[];
+extern u8 __ocm_data_end[];
+extern u8 __ocm_data_load[];
+#endif
+
+
+/******************************************************************************
+ * GLOBAL FUNCTIONS
+ *****************************************************************************/
+
+/**
+ * @brief Copia in OCM codice e dati del percorso del tick
+ *
+ * @details Copia le sezioni .ocm_text e .ocm_data dal loro indirizzo di
+ * caricamento in DDR all'indirizzo di esecuzione in ps7_ram_0. Poi scrive
+ * in memoria la cache dati e invalida la cache istruzioni, così il core non
+ * esegue il contenuto precedente dell'OCM.
+ *
+ * Va chiamata come prima istruzione del main, prima di abilitare qualunque
+ * interrupt e di toccare una funzione o un dato marcato per l'OCM.
+ */
+void copia_sezioni_ocm(void)
+{
+#if (CODICE_IN_OCM == 1U)
+	u32 l_text = (u32) (__ocm_text_end - __ocm_text_start);
+	u32 l_data = (u32) (__ocm_data_end - __ocm_data_start);
+
+	(void) memcpy(__ocm_text_start, __ocm_text_load, l_text);
+	(void) memcpy(__ocm_data_start, __ocm_data_load, l_data);
+
+	Xil_DCacheFlushRange((INTPTR) __ocm_text_start, l_text);
+	Xil_DCacheFlushRange((INTPTR) __ocm_data_start, l_data);
+	Xil_ICacheInvalidateRange((INTPTR) __ocm_text_start, l_text);
+#endif
+}
+
+
+/****************** (C) COPYRIGHT GITSIM ***** END OF FILE *******************/
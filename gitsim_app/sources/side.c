@@ -12,6 +12,12 @@
 #include "gestione_polling.h"
 #include "gestione_uart.h"
 #include "emulazione_encoder.h"
+#include "misura_cicli.h"
+#include "gestione_task.h"
+#include "misura_isr.h"
+#include "sezioni_ocm.h"
+#include "ponte_amp.h"
+#include "xpseudo_asm.h"
 
 
 /******************************************************************************
@@ -21,51 +27,158 @@
 /** @brief Tempo di campionamento del side loop secondario */
 #define T_SIDE_SECONDARIO 		0.05f
 
+/**
+ * @brief Budget del side loop secondario, in microsecondi
+ *
+ * Resta nell'interrupt: l'azzeramento dei conteggi deve avvenire tra due
+ * tick degli encoder.
+ */
+#define BUDGET_SIDE_SECONDARIO	1U
+
 
 /******************************************************************************
  * STATIC VARIABLES
  *****************************************************************************/
 
+#if (MISURA_CICLI_ENCODER == 1U)
 /**
- * @brief Contatore di side loop fatti, usato per entrare nel side loop
- * secondario
+ * @brief Cicli CPU spesi per aggiornare ed emulare gli encoder in un tick
+ *
+ * Da leggere con il debugger, confrontando i firmware compilati con i due
+ * valori di MOTORE_ENCODER. Il costo per canale si ottiene dividendo per
+ * N_ENCODER e ricompilando con valori crescenti di N_ENCODER.
+ *
+ * Non ancora misurato sul target. Stima per due canali sul Cortex-A9: da
+ * 250 a 350 cicli per tick con il motore double, da 150 a 220 con quello a
+ * punto fisso, che evita i confronti in virgola mobile con VMRS. Ogni
+ * canale in più costa circa 120-150 e 70-100 cicli: con N_ENCODER = 8 il
+ * motore double occupa quasi metà di un tick da 4 us.
  */
-static uint32_t counter_side_secondario;
+static statistica_cicli cicli_encoder;
+#endif
+
+
+#if (RUOLO_CORE == RUOLO_CORE_SINGOLO)
+/******************************************************************************
+ * STATIC FUNCTION PROTOTYPES
+ *****************************************************************************/
+static void side_loop_secondario(void);
+
 
-/** @brief Istanza del timer che dà il callback al side loop */
-static XScuTimer istanza_timer_da_resettare;
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
 
 /**
- * @brief Numero di ingressi in side loop che bisogna fare per entrare nel
- * side secondario (lento)
+ * @brief Azioni del side loop secondario (lento)
  */
-static uint32_t n_loop_side_secondario = UINT32_MAX;
+static void side_loop_secondario(void)
+{
+	manda_telegramma_di_risposta();
+	reset_conteggi_encoder();
+}
+#endif
 
 
 /******************************************************************************
  * SIDE LOOP
  *****************************************************************************/
-void side_loop(void *CallBack_Timer)
+FUNZIONE_OCM void side_loop(void *CallBack_Timer)
 {
+	uint32_t n_tick;
+
+#if (MISURA_LATENZA_ISR == 1U)
+	ingresso_misura_isr();
+#endif
+
+	/* Tick nominali trascorsi, più di uno dopo un overrun */
+	n_tick = misura_tick_trascorsi();
+
 	/* Resetto il flag di interrupt dal timer */
-	XScuTimer_ClearInterruptStatus(&istanza_timer_da_resettare);
+	pulisci_interrupt_timer();
 
-	/* Controllo se ho fatto abbastanza loop per entrane nel secondario */
-	if (counter_side_secondario == (n_loop_side_secondario - 1U))
+	/* Task periodici: i leggeri qui, i pesanti segnalati al main loop */
+	esegui_task_tick(n_tick);
+
+#if (RUOLO_CORE == RUOLO_CORE_ENCODER)
+	/* Comandi da CPU0, con effetto da questo tick */
+	servi_comandi_amp();
+#endif
+
+#if (RUOLO_CORE == RUOLO_CORE_PROTOCOLLO)
+	/* Gli encoder girano su CPU1: qui arriva solo la telemetria */
+	servi_telemetria_amp();
+#else
+	/* Azioni del side loop principale */
+#if (MISURA_CICLI_ENCODER == 1U)
+	u32 cicli_inizio = leggi_contatore_cicli();
+	aggiorna_variabili_encoder(n_tick);
+	emula_sensori_encoder();
+	aggiorna_statistica_cicli(&cicli_encoder,
+							  leggi_contatore_cicli() - cicli_inizio);
+#else
+	aggiorna_variabili_encoder(n_tick);
+	emula_sensori_encoder();
+#endif
+#endif
+
+	/* Il flag del timer è già di nuovo alto se il tick è durato troppo */
+	controlla_overrun_tick();
+
+#if (MISURA_LATENZA_ISR == 1U)
+	uscita_misura_isr();
+#endif
+}
+
+
+/******************************************************************************
+ * PERIODO DEL SIDE LOOP
+ *****************************************************************************/
+
+/**
+ * @brief Cambia il periodo del side loop a runtime
+ *
+ * @param periodo Nuovo periodo del tick, in secondi; 0 per il periodo
+ * predefinito
+ * @return bool true se il periodo è stato accettato
+ *
+ * @details Timer SCU, tick dei task periodici e grandezze per tick degli
+ * encoder cambiano insieme, con l'interrupt mascherato: il side loop non
+ * vede mai un periodo a metà. Si può chiamare dal main loop o dal side loop,
+ * lo stato dell'interrupt viene ripristinato. Nella CPU0 della build AMP il
+ * periodo viene mandato a CPU1, che lo valida con il proprio costo
+ * misurato; il valore di ritorno dice solo se il messaggio è partito.
+ *
+ * @see imposta_periodo_tick, ricalcola_task, aggiorna_tempo_encoder
+ */
+bool assegna_periodo_side_loop(float_t periodo)
+{
+#if (RUOLO_CORE == RUOLO_CORE_PROTOCOLLO)
+	return invia_comando_amp((uint8_t) MESSAGGIO_PERIODO_TICK, 0, 0, periodo);
+#else
+	u32 cpsr = mfcpsr();
+	bool accettato;
+
+	mtcpsr(cpsr | XIL_EXCEPTION_IRQ);
+
+	accettato = imposta_periodo_tick(periodo);
+	if (accettato == true)
 	{
-		/* Azioni del side loop secondario */
-		manda_telegramma_di_risposta();
-		reset_conteggi_encoder();
-		counter_side_secondario = 0;
+		ricalcola_task();
+		aggiorna_tempo_encoder();
+#if (MISURA_LATENZA_ISR == 1U)
+		reset_istogrammi_isr();
+#endif
 	}
 	else
 	{
-		counter_side_secondario++;
+		/* Resta il periodo precedente */
 	}
 
-	/* Azioni del side loop principale */
-	aggiorna_variabili_encoder();
-	emula_sensori_encoder();
+	mtcpsr(cpsr);
+
+	return accettato;
+#endif
 }
 
 
@@ -74,13 +187,30 @@ void side_loop(void *CallBack_Timer)
  *****************************************************************************/
 void inizializza_side_loop()
 {
-	counter_side_secondario = 0;
-	istanza_timer_da_resettare = ritorna_istanza_timer();
-	float_t t_polling_side = ritorna_tempo_del_polling();
-
-	/* Creo la variabile temporanea per MISRA-2023 */
-	float_t n_temp = T_SIDE_SECONDARIO / t_polling_side;
-	n_loop_side_secondario = (uint32_t) n_temp;
+	/* Registro i task periodici sui tick del side loop */
+	inizializza_task();
+#if (RUOLO_CORE == RUOLO_CORE_SINGOLO)
+	(void) registra_task(T_SIDE_SECONDARIO, 0.0f, side_loop_secondario,
+						 BUDGET_SIDE_SECONDARIO);
+#elif (RUOLO_CORE == RUOLO_CORE_ENCODER)
+	(void) registra_task(T_SIDE_SECONDARIO, 0.0f, manda_telemetria_amp,
+						 BUDGET_SIDE_SECONDARIO);
+#endif
+
+#if (MISURA_CICLI_ENCODER == 1U)
+	inizializza_contatore_cicli();
+	reset_statistica_cicli(&cicli_encoder);
+#endif
+
+#if (MISURA_LATENZA_ISR == 1U)
+	inizializza_misura_isr();
+#endif
+
+#if ((SCHEDULAZIONE_ENCODER == SCHEDULAZIONE_EVENTI) && \
+	 (RUOLO_CORE != RUOLO_CORE_PROTOCOLLO))
+	/* I fronti vengono emessi dal comparatore, il tick fa da supervisore */
+	inizializza_comparatore_globale(gestore_eventi_encoder);
+#endif
 }
 
 